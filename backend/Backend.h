@@ -11,6 +11,7 @@ class ASTBase;
 // Interface implemented by garter backends
 class Backend {
 public:
+	virtual ~Backend() { }
 
 	// Given the AST representing a program, compile it to a native object
 	// file.  Returns true if successful, otherwise false.
@@ -21,6 +22,12 @@ public:
 	// program, execute it using either an interpreter or a just-in-time
 	// compiler.  Returns true if successful, otherwise false.
 	virtual bool executeTopLevelItem(std::shared_ptr<ASTBase> top_level_item) = 0;
+
+	// Given the AST representing an entire program, execute it.  As when
+	// compiling the program, functions and constants are visible to all
+	// top-level statements regardless of where they are defined.  Returns
+	// true if successful, otherwise false.
+	virtual bool executeProgram(const ProgramAST & program) = 0;
 };
 
 } // End garter namespace
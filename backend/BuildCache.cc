@@ -0,0 +1,82 @@
+#include <backend/BuildCache.h>
+#include <backend/JITObjectCache.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA1.h>
+#include <iostream>
+#include <utime.h>
+
+using namespace garter;
+using namespace llvm;
+
+// Extension of the cached files
+static const char CachedFileExtension[] = ".out";
+
+BuildCache::BuildCache(const std::string & dir, uint64_t size_limit)
+	: Dir(dir), SizeLimit(size_limit),
+	  Hits(0), Misses(0), Stores(0), Evictions(0)
+{
+	std::error_code ec = sys::fs::create_directories(Dir);
+	if (ec)
+		std::cerr << "ERROR: can't create " << Dir << ": "
+			  << ec.message() << std::endl;
+}
+
+std::string BuildCache::getPath(const std::string & key) const
+{
+	SmallString<128> path(Dir);
+	sys::path::append(path, key + CachedFileExtension);
+	return path.str().str();
+}
+
+std::string BuildCache::getKey(StringRef source, const std::string & parameters)
+{
+	SHA1 hasher;
+	hasher.update(LLVM_VERSION_STRING);
+	hasher.update(StringRef("\0", 1));
+	hasher.update(parameters);
+	hasher.update(StringRef("\0", 1));
+	hasher.update(source);
+	return toHex(hasher.final(), true);
+}
+
+bool BuildCache::fetch(const std::string & key, const std::string & out_filename)
+{
+	const std::string path = getPath(key);
+
+	if (sys::fs::copy_file(path, out_filename)) {
+		Misses++;
+		return false;
+	}
+
+	// The modification time records when the file was last used.
+	utime(path.c_str(), nullptr);
+	Hits++;
+	return true;
+}
+
+void BuildCache::store(const std::string & key, const std::string & filename)
+{
+	// Copy to a temporary file, then rename it, so that other processes
+	// never see a partially written file.
+	SmallString<128> model(Dir);
+	sys::path::append(model, key + "-%%%%%%%%.tmp");
+	SmallString<128> tmp_path;
+	int fd;
+	if (sys::fs::createUniqueFile(model, fd, tmp_path))
+		return;
+	sys::fs::closeFile(fd);
+
+	if (sys::fs::copy_file(filename, tmp_path) ||
+	    sys::fs::rename(tmp_path, getPath(key)))
+	{
+		sys::fs::remove(tmp_path);
+		return;
+	}
+	Stores++;
+	Evictions += evictLeastRecentlyUsed(Dir, CachedFileExtension, SizeLimit);
+}
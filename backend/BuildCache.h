@@ -0,0 +1,53 @@
+#ifndef _GARTER_BUILD_CACHE_H_
+#define _GARTER_BUILD_CACHE_H_
+
+#include <atomic>
+#include <string>
+#include <llvm/ADT/StringRef.h>
+
+namespace garter {
+
+// Persistent cache of the files garterc creates from source files (object
+// files or LLVM IR), stored as one file per compilation in a directory.
+//
+// Compilations are identified by a key computed from the bytes of the source
+// file and a description of everything else that affects the output, such as
+// the compiler, the optimization level and the target CPU.  On a cache hit the
+// source file doesn't even need to be parsed.
+//
+// Like JITObjectCache, the least recently used files are deleted when the
+// total size of the cache exceeds its size limit, and several processes (or
+// threads) may use the same cache directory at the same time.
+class BuildCache {
+private:
+	std::string Dir;
+	uint64_t SizeLimit;
+
+	std::string getPath(const std::string & key) const;
+
+public:
+	// Statistics
+	std::atomic<unsigned> Hits;
+	std::atomic<unsigned> Misses;
+	std::atomic<unsigned> Stores;
+	std::atomic<unsigned> Evictions;
+
+	BuildCache(const std::string & dir, uint64_t size_limit);
+
+	// Compute the key of compiling a source file containing @source.
+	// @parameters must describe everything besides the source that
+	// affects the output.
+	static std::string getKey(llvm::StringRef source,
+				  const std::string & parameters);
+
+	// If the output for @key is cached, copy it to @out_filename and
+	// return true
+	bool fetch(const std::string & key, const std::string & out_filename);
+
+	// Store a copy of the file @filename as the output for @key
+	void store(const std::string & key, const std::string & filename);
+};
+
+} // End garter namespace
+
+#endif /* _GARTER_BUILD_CACHE_H_ */
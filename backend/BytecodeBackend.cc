@@ -0,0 +1,995 @@
+#include <backend/BytecodeBackend.h>
+#include <frontend/Parser.h>
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+
+using namespace garter;
+
+// Operations of the VM.  X(name) is expanded once per operation, in the order
+// of the opcodes.  Unless noted otherwise, A is the register receiving the
+// result and B and C are the registers holding the operands.  Jump offsets are
+// relative to the jump instruction.
+#define BYTECODE_OPCODES(X)						\
+	/* Operations of BinaryExpressionAST, in the order of BinaryOp */	\
+	X(Or) X(And) X(LessThan) X(GreaterThan) X(LessThanOrEqualTo)	\
+	X(GreaterThanOrEqualTo) X(EqualTo) X(NotEqualTo) X(BitwiseOr)	\
+	X(BitwiseXor) X(BitwiseAnd) X(LeftShift) X(RightShift) X(Add)	\
+	X(Subtract) X(Multiply) X(Divide) X(Modulo) X(Exponentiate)	\
+	/* Unary operations and builtin functions of register B */	\
+	X(Not) X(Minus) X(BitwiseNot) X(Popcount) X(Clz) X(Ctz) X(Bswap)\
+	X(LoadConstant)		/* A = B */				\
+	X(Move)			/* A = register B */			\
+	X(AddConstant)		/* A = register B + C */		\
+	X(LoadGlobal)		/* A = top-level variable B */		\
+	X(StoreGlobal)		/* top-level variable A = register B */	\
+	X(AddGlobal)		/* top-level variable A += register B */\
+	X(Jump)			/* jump by A */				\
+	X(JumpIfZero)		/* if register A == 0, jump by B */	\
+	X(JumpIfNonZero)	/* if register A != 0, jump by B */	\
+	/* If register A compares with register B, jump by C */	\
+	X(JumpIfLessThan) X(JumpIfGreaterThan)				\
+	X(JumpIfLessThanOrEqualTo) X(JumpIfGreaterThanOrEqualTo)	\
+	X(JumpIfEqualTo) X(JumpIfNotEqualTo)				\
+	/* If register A compares with the number B, jump by C */	\
+	X(JumpIfLessThanConstant) X(JumpIfGreaterThanConstant)		\
+	X(JumpIfLessThanOrEqualToConstant)				\
+	X(JumpIfGreaterThanOrEqualToConstant)				\
+	X(JumpIfEqualToConstant) X(JumpIfNotEqualToConstant)		\
+	/* A = function B called with the arguments in the registers	\
+	 * starting at C */						\
+	X(Call)								\
+	X(Return)		/* return register A */			\
+	X(Print)		/* print registers A through A + B - 1 */
+
+namespace garter {
+
+enum BytecodeOpcode : int32_t {
+#define OPCODE_ENUMERATOR(name) Op##name,
+	BYTECODE_OPCODES(OPCODE_ENUMERATOR)
+#undef OPCODE_ENUMERATOR
+	NumOpcodes
+};
+
+struct BytecodeInstruction {
+	BytecodeOpcode Op;
+	int32_t A, B, C;
+};
+
+// A function defined by the program, or the code of top-level statements
+struct BytecodeFunction : public InterpreterFunction {
+	// Index of the function in BytecodeBackend::AllFunctions
+	int32_t Index;
+
+	// Number of registers in the function's frame.  The parameters come
+	// first, followed by the other local variables, then the temporaries.
+	int32_t NumParameters;
+	int32_t NumLocals;
+	int32_t NumRegisters;
+
+	std::vector<BytecodeInstruction> Code;
+
+	BytecodeFunction(std::shared_ptr<FunctionDefinitionAST> definition,
+			 int32_t index)
+		: InterpreterFunction(definition), Index(index),
+		  NumParameters(definition ? definition->Parameters.size() : 0),
+		  NumLocals(NumParameters), NumRegisters(NumParameters)
+	{
+	}
+};
+
+} // End garter namespace
+
+// Registers of temporaries are numbered from FirstTemporary while compiling,
+// since the number of local variables isn't known until the whole function has
+// been compiled.  They are then renumbered to follow the local variables.
+static const int32_t FirstTemporary = 1 << 28;
+
+// Bits telling which operands of an instruction are registers
+enum { RegisterA = 1, RegisterB = 2, RegisterC = 4 };
+
+static unsigned getRegisterOperands(BytecodeOpcode op)
+{
+	if (op <= OpExponentiate)
+		return RegisterA | RegisterB | RegisterC;
+	if (op <= OpBswap)
+		return RegisterA | RegisterB;
+
+	switch (op) {
+	case OpLoadConstant:
+	case OpLoadGlobal:
+	case OpReturn:
+	case OpPrint:
+	case OpJumpIfZero:
+	case OpJumpIfNonZero:
+		return RegisterA;
+	case OpMove:
+	case OpAddConstant:
+		return RegisterA | RegisterB;
+	case OpStoreGlobal:
+	case OpAddGlobal:
+		return RegisterB;
+	case OpCall:
+		return RegisterA | RegisterC;
+	case OpJump:
+		return 0;
+	default:
+		if (op <= OpJumpIfNotEqualTo)
+			return RegisterA | RegisterB;
+		return RegisterA;
+	}
+}
+
+// Return whether the expression @expr refers to the variable @name
+static bool referencesVariable(const ExpressionAST & expr, const std::string & name)
+{
+	if (auto var = dynamic_cast<const VariableExpressionAST*>(&expr))
+		return var->Name == name;
+	if (auto binary = dynamic_cast<const BinaryExpressionAST*>(&expr))
+		return referencesVariable(*binary->LHS, name) ||
+		       referencesVariable(*binary->RHS, name);
+	if (auto unary = dynamic_cast<const UnaryExpressionAST*>(&expr))
+		return referencesVariable(*unary->Expression, name);
+	if (auto call = dynamic_cast<const CallExpressionAST*>(&expr)) {
+		for (auto arg : call->Arguments)
+			if (referencesVariable(*arg, name))
+				return true;
+	}
+	return false;
+}
+
+namespace garter {
+
+// StatementAST and ExpressionAST visitor that compiles the AST of a function
+// body or of top-level statements into bytecode.  On failure, an error message
+// is printed.
+class BytecodeCompiler : public StatementASTVisitor,
+			 public ExpressionASTVisitor {
+private:
+	BytecodeBackend & Backend;
+
+	// Function being compiled
+	BytecodeFunction & Function;
+
+	// Registers of the local variables of Function seen so far
+	std::map<std::string, int32_t> Locals;
+
+	// Number of temporaries in use, and the most in use at any point
+	int32_t NumTemporaries;
+	int32_t MaxTemporaries;
+
+	// Jumps out of each enclosing loop, to be patched once the loop has
+	// been compiled: 'break' jumps past the loop and 'continue' to its
+	// condition
+	struct LoopJumps {
+		std::vector<size_t> Breaks;
+		std::vector<size_t> Continues;
+	};
+	std::vector<LoopJumps> Loops;
+
+	// Register in which the expression being compiled should leave its
+	// value, or -1 if any register will do
+	int32_t Target;
+
+	// Used to return the register holding the value of an expression (-1
+	// on failure)
+	int32_t Result;
+
+	// Used to return whether a statement was successfully compiled
+	bool StatementSuccessful;
+
+	bool isTopLevel() const
+	{
+		return Function.Definition == nullptr;
+	}
+
+	size_t emit(BytecodeOpcode op, int32_t a = 0, int32_t b = 0, int32_t c = 0)
+	{
+		Function.Code.push_back({op, a, b, c});
+		return Function.Code.size() - 1;
+	}
+
+	int32_t allocateTemporary()
+	{
+		int32_t reg = FirstTemporary + NumTemporaries++;
+		MaxTemporaries = std::max(MaxTemporaries, NumTemporaries);
+		return reg;
+	}
+
+	// Return @target if it's a register, otherwise a new temporary
+	int32_t getResultRegister(int32_t target)
+	{
+		return (target >= 0) ? target : allocateTemporary();
+	}
+
+	void patchJump(size_t jump, size_t target);
+	void patchJump(size_t jump)
+	{
+		patchJump(jump, Function.Code.size());
+	}
+
+	bool getConstant(ExpressionAST & expr, int32_t & value) const;
+	bool compileJump(ExpressionAST & cond, bool jump_if, size_t & jump);
+	void compileBuiltinCall(CallExpressionAST & expr, int32_t target);
+public:
+	BytecodeCompiler(BytecodeBackend & backend, BytecodeFunction & function)
+		: Backend(backend), Function(function), NumTemporaries(0),
+		  MaxTemporaries(0), Target(-1), Result(-1),
+		  StatementSuccessful(false)
+	{
+	}
+
+	void addParameter(const std::string & name, int32_t reg)
+	{
+		Locals[name] = reg;
+	}
+
+	// Compile @expr, leaving its value in the register @target if it's not
+	// -1.  Returns the register holding the value, or -1 on failure.
+	int32_t compile(ExpressionAST & expr, int32_t target = -1)
+	{
+		Target = target;
+		Result = -1;
+		expr.acceptVisitor(*this);
+		return Result;
+	}
+
+	bool compile(const std::vector<std::shared_ptr<StatementAST>> & stmts);
+	void finish();
+
+	void visit(AssignmentStatementAST &);
+	void visit(BreakStatementAST &);
+	void visit(ContinueStatementAST &);
+	void visit(ExpressionStatementAST &);
+	void visit(IfStatementAST &);
+	void visit(PassStatementAST &);
+	void visit(PrintStatementAST &);
+	void visit(ReturnStatementAST &);
+	void visit(WhileStatementAST &);
+
+	void visit(BinaryExpressionAST &);
+	void visit(CallExpressionAST &);
+	void visit(NumberExpressionAST &);
+	void visit(UnaryExpressionAST &);
+	void visit(VariableExpressionAST &);
+};
+
+} // End garter namespace
+
+// Make the jump instruction at index @jump jump to the instruction at index
+// @target
+void BytecodeCompiler::patchJump(size_t jump, size_t target)
+{
+	BytecodeInstruction & insn = Function.Code[jump];
+	int32_t offset = (int32_t)target - (int32_t)jump;
+
+	if (insn.Op == OpJump)
+		insn.A = offset;
+	else if (insn.Op == OpJumpIfZero || insn.Op == OpJumpIfNonZero)
+		insn.B = offset;
+	else
+		insn.C = offset;
+}
+
+// If @expr is a number or a constant, store its value in @value and return true
+bool BytecodeCompiler::getConstant(ExpressionAST & expr, int32_t & value) const
+{
+	if (auto number = dynamic_cast<NumberExpressionAST*>(&expr)) {
+		value = number->Number;
+		return true;
+	}
+	if (auto var = dynamic_cast<VariableExpressionAST*>(&expr)) {
+		auto it = Backend.Constants.find(var->Name);
+		if (it != Backend.Constants.end()) {
+			value = it->second;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Emit code evaluating @cond followed by a jump, taken if the condition is true
+// (if @jump_if) or false (otherwise), whose target is left to patch.  The index
+// of the jump is stored in @jump.  Comparisons jump directly on their operands.
+bool BytecodeCompiler::compileJump(ExpressionAST & cond, bool jump_if, size_t & jump)
+{
+	static const BinaryExpressionAST::BinaryOp Negations[] = {
+		BinaryExpressionAST::GreaterThanOrEqualTo,
+		BinaryExpressionAST::LessThanOrEqualTo,
+		BinaryExpressionAST::GreaterThan,
+		BinaryExpressionAST::LessThan,
+		BinaryExpressionAST::NotEqualTo,
+		BinaryExpressionAST::EqualTo,
+	};
+	const int32_t saved_temporaries = NumTemporaries;
+	auto binary = dynamic_cast<BinaryExpressionAST*>(&cond);
+	auto unary = dynamic_cast<UnaryExpressionAST*>(&cond);
+
+	if (binary && binary->Op >= BinaryExpressionAST::LessThan &&
+	    binary->Op <= BinaryExpressionAST::NotEqualTo)
+	{
+		int comparison = binary->Op - BinaryExpressionAST::LessThan;
+		int32_t lhs, rhs, constant;
+
+		if (!jump_if)
+			comparison = Negations[comparison] - BinaryExpressionAST::LessThan;
+		lhs = compile(*binary->LHS);
+		if (lhs < 0)
+			return false;
+		if (getConstant(*binary->RHS, constant)) {
+			jump = emit(BytecodeOpcode(OpJumpIfLessThanConstant + comparison),
+				    lhs, constant);
+		} else {
+			rhs = compile(*binary->RHS);
+			if (rhs < 0)
+				return false;
+			jump = emit(BytecodeOpcode(OpJumpIfLessThan + comparison),
+				    lhs, rhs);
+		}
+	} else if (unary && unary->Op == UnaryExpressionAST::Not) {
+		return compileJump(*unary->Expression, !jump_if, jump);
+	} else {
+		int32_t value = compile(cond);
+		if (value < 0)
+			return false;
+		jump = emit(jump_if ? OpJumpIfNonZero : OpJumpIfZero, value);
+	}
+	NumTemporaries = saved_temporaries;
+	return true;
+}
+
+// Compile the statements @stmts, appending their code to the function
+bool BytecodeCompiler::compile(const std::vector<std::shared_ptr<StatementAST>> & stmts)
+{
+	for (auto stmtptr : stmts) {
+		stmtptr->acceptVisitor(*this);
+		if (!StatementSuccessful)
+			return false;
+	}
+	return true;
+}
+
+// Finish the function: return 0 if the end of the code is reached, and place
+// the temporaries after the local variables
+void BytecodeCompiler::finish()
+{
+	int32_t zero = allocateTemporary();
+
+	emit(OpLoadConstant, zero, 0);
+	emit(OpReturn, zero);
+
+	Function.NumRegisters = Function.NumLocals + MaxTemporaries;
+
+	const int32_t delta = Function.NumLocals - FirstTemporary;
+	for (BytecodeInstruction & insn : Function.Code) {
+		unsigned regs = getRegisterOperands(insn.Op);
+		if ((regs & RegisterA) && insn.A >= FirstTemporary)
+			insn.A += delta;
+		if ((regs & RegisterB) && insn.B >= FirstTemporary)
+			insn.B += delta;
+		if ((regs & RegisterC) && insn.C >= FirstTemporary)
+			insn.C += delta;
+	}
+}
+
+void BytecodeCompiler::visit(AssignmentStatementAST & stmt)
+{
+	const std::string & name = stmt.Variable->Name;
+	const int32_t saved_temporaries = NumTemporaries;
+
+	StatementSuccessful = false;
+	if (Backend.Constants.count(name)) {
+		std::cerr << "ERROR: Cannot assign to constant " << name << std::endl;
+		return;
+	}
+
+	if (isTopLevel()) {
+		int32_t variable = Backend.getGlobalVariable(name);
+		auto sum = dynamic_cast<BinaryExpressionAST*>(stmt.Expression.get());
+		auto lhs = sum ? dynamic_cast<VariableExpressionAST*>(sum->LHS.get()) : nullptr;
+		auto rhs = sum ? dynamic_cast<VariableExpressionAST*>(sum->RHS.get()) : nullptr;
+
+		if (sum && sum->Op == BinaryExpressionAST::Add &&
+		    ((lhs && lhs->Name == name) || (rhs && rhs->Name == name)))
+		{
+			// x = x + y or x = y + x
+			ExpressionAST & addend = (lhs && lhs->Name == name) ?
+						 *sum->RHS : *sum->LHS;
+			int32_t value = compile(addend);
+			if (value < 0)
+				return;
+			emit(OpAddGlobal, variable, value);
+		} else {
+			int32_t value = compile(*stmt.Expression);
+			if (value < 0)
+				return;
+			emit(OpStoreGlobal, variable, value);
+		}
+		NumTemporaries = saved_temporaries;
+		StatementSuccessful = true;
+		return;
+	}
+
+	auto it = Locals.find(name);
+	int32_t reg;
+	if (it == Locals.end()) {
+		reg = Function.NumLocals++;
+		Locals[name] = reg;
+		// The assigned value may refer to the variable being declared.
+		if (referencesVariable(*stmt.Expression, name))
+			emit(OpLoadConstant, reg, 0);
+	} else {
+		reg = it->second;
+	}
+	if (compile(*stmt.Expression, reg) < 0)
+		return;
+	NumTemporaries = saved_temporaries;
+	StatementSuccessful = true;
+}
+
+void BytecodeCompiler::visit(BreakStatementAST & stmt __attribute__((unused)))
+{
+	if (Loops.empty()) {
+		std::cerr << "ERROR: break statement not in loop" << std::endl;
+		StatementSuccessful = false;
+	} else {
+		Loops.back().Breaks.push_back(emit(OpJump));
+		StatementSuccessful = true;
+	}
+}
+
+void BytecodeCompiler::visit(ContinueStatementAST & stmt __attribute__((unused)))
+{
+	if (Loops.empty()) {
+		std::cerr << "ERROR: continue statement not in loop" << std::endl;
+		StatementSuccessful = false;
+	} else {
+		Loops.back().Continues.push_back(emit(OpJump));
+		StatementSuccessful = true;
+	}
+}
+
+void BytecodeCompiler::visit(ExpressionStatementAST & stmt)
+{
+	const int32_t saved_temporaries = NumTemporaries;
+
+	StatementSuccessful = false;
+	if (compile(*stmt.Expression) < 0)
+		return;
+	NumTemporaries = saved_temporaries;
+	StatementSuccessful = true;
+}
+
+void BytecodeCompiler::visit(IfStatementAST & stmt)
+{
+	std::vector<size_t> jumps_to_end;
+
+	StatementSuccessful = false;
+	for (size_t i = 0; i <= stmt.ElifClauses.size(); i++) {
+		ExpressionAST & cond = (i == 0) ? *stmt.Condition :
+					*stmt.ElifClauses[i - 1]->Condition;
+		const std::vector<std::shared_ptr<StatementAST>> & body =
+			(i == 0) ? stmt.Body : stmt.ElifClauses[i - 1]->Body;
+		size_t jump_to_next;
+
+		if (!compileJump(cond, false, jump_to_next))
+			return;
+		if (!compile(body))
+			return;
+		if (i < stmt.ElifClauses.size() || !stmt.ElseBody.empty())
+			jumps_to_end.push_back(emit(OpJump));
+		patchJump(jump_to_next);
+	}
+	if (!compile(stmt.ElseBody))
+		return;
+	for (size_t jump : jumps_to_end)
+		patchJump(jump);
+	StatementSuccessful = true;
+}
+
+void BytecodeCompiler::visit(PassStatementAST & stmt __attribute__((unused)))
+{
+	StatementSuccessful = true;
+}
+
+// The arguments are evaluated into consecutive registers and printed by a
+// single instruction.
+void BytecodeCompiler::visit(PrintStatementAST & stmt)
+{
+	const int32_t saved_temporaries = NumTemporaries;
+	const int32_t first = FirstTemporary + NumTemporaries;
+
+	StatementSuccessful = false;
+	for (auto exprptr : stmt.Arguments) {
+		if (compile(*exprptr, allocateTemporary()) < 0)
+			return;
+	}
+	emit(OpPrint, first, stmt.Arguments.size());
+	NumTemporaries = saved_temporaries;
+	StatementSuccessful = true;
+}
+
+void BytecodeCompiler::visit(ReturnStatementAST & stmt)
+{
+	const int32_t saved_temporaries = NumTemporaries;
+
+	StatementSuccessful = false;
+	int32_t value = compile(*stmt.Expression);
+	if (value < 0)
+		return;
+	emit(OpReturn, value);
+	NumTemporaries = saved_temporaries;
+	StatementSuccessful = true;
+}
+
+// The condition is tested before the first iteration and again after each
+// iteration, so that each iteration executes a single conditional jump.  If the
+// condition is the first reference to a local variable, which sets it to 0 each
+// time, each iteration instead jumps back to the test before the loop.
+void BytecodeCompiler::visit(WhileStatementAST & stmt)
+{
+	const size_t top = Function.Code.size();
+	const size_t num_locals = Locals.size();
+	size_t exit_jump;
+
+	StatementSuccessful = false;
+	if (!compileJump(*stmt.Condition, false, exit_jump))
+		return;
+
+	const bool declares = (Locals.size() != num_locals);
+	const size_t body = Function.Code.size();
+
+	Loops.emplace_back();
+	bool ok = compile(stmt.Body);
+	LoopJumps jumps = std::move(Loops.back());
+	Loops.pop_back();
+	if (!ok)
+		return;
+
+	for (size_t jump : jumps.Continues)
+		patchJump(jump);
+	if (declares) {
+		patchJump(emit(OpJump), top);
+	} else {
+		size_t loop_jump;
+		if (!compileJump(*stmt.Condition, true, loop_jump))
+			return;
+		patchJump(loop_jump, body);
+	}
+	patchJump(exit_jump);
+	for (size_t jump : jumps.Breaks)
+		patchJump(jump);
+	StatementSuccessful = true;
+}
+
+void BytecodeCompiler::visit(BinaryExpressionAST & expr)
+{
+	const int32_t target = Target;
+	const int32_t saved_temporaries = NumTemporaries;
+	int32_t constant;
+
+	// Adding or subtracting a number takes a single instruction.
+	if ((expr.Op == BinaryExpressionAST::Add ||
+	     expr.Op == BinaryExpressionAST::Subtract) &&
+	    getConstant(*expr.RHS, constant))
+	{
+		int32_t lhs = compile(*expr.LHS);
+		if (lhs < 0)
+			return;
+		if (expr.Op == BinaryExpressionAST::Subtract)
+			constant = -(uint32_t)constant;
+		NumTemporaries = saved_temporaries;
+		Result = getResultRegister(target);
+		emit(OpAddConstant, Result, lhs, constant);
+		return;
+	}
+	if (expr.Op == BinaryExpressionAST::Add && getConstant(*expr.LHS, constant)) {
+		int32_t rhs = compile(*expr.RHS);
+		if (rhs < 0)
+			return;
+		NumTemporaries = saved_temporaries;
+		Result = getResultRegister(target);
+		emit(OpAddConstant, Result, rhs, constant);
+		return;
+	}
+
+	int32_t lhs = compile(*expr.LHS);
+	if (lhs < 0)
+		return;
+	int32_t rhs = compile(*expr.RHS);
+	if (rhs < 0)
+		return;
+
+	if (expr.Op == BinaryExpressionAST::In ||
+	    expr.Op == BinaryExpressionAST::NotIn)
+	{
+		std::cerr << "ERROR: Operator " << expr.getOpStr()
+			  << " is not supported" << std::endl;
+		Result = -1;
+		return;
+	}
+	NumTemporaries = saved_temporaries;
+	Result = getResultRegister(target);
+	emit(BytecodeOpcode(OpOr + (expr.Op - BinaryExpressionAST::Or)),
+	     Result, lhs, rhs);
+}
+
+// Builtin functions, each taking one argument
+static const struct {
+	const char *Name;
+	BytecodeOpcode Op;
+} Builtins[] = {
+	{"popcount", OpPopcount},
+	{"clz",      OpClz},
+	{"ctz",      OpCtz},
+	{"bswap",    OpBswap},
+};
+
+// If the call expression @expr names a builtin function, compile the call into
+// @target.  Otherwise report an unknown function.
+void BytecodeCompiler::compileBuiltinCall(CallExpressionAST & expr, int32_t target)
+{
+	const int32_t saved_temporaries = NumTemporaries;
+
+	for (const auto & builtin : Builtins) {
+		if (expr.Callee != builtin.Name)
+			continue;
+
+		if (expr.Arguments.size() != 1) {
+			std::cerr << "ERROR: Wrong number of arguments to "
+				  << expr.Callee << std::endl;
+			Result = -1;
+			return;
+		}
+		int32_t arg = compile(*expr.Arguments[0]);
+		if (arg < 0)
+			return;
+		NumTemporaries = saved_temporaries;
+		Result = getResultRegister(target);
+		emit(builtin.Op, Result, arg);
+		return;
+	}
+
+	std::cerr << "ERROR: Unknown function " << expr.Callee << std::endl;
+	Result = -1;
+}
+
+// The arguments are evaluated into consecutive temporaries, which become the
+// first registers of the callee's frame.
+void BytecodeCompiler::visit(CallExpressionAST & expr)
+{
+	const int32_t target = Target;
+	const int32_t saved_temporaries = NumTemporaries;
+	const int32_t first = FirstTemporary + NumTemporaries;
+	BytecodeFunction *callee =
+		static_cast<BytecodeFunction*>(Backend.getFunction(expr.Callee));
+
+	// Functions not defined by the program may name a builtin
+	if (callee == nullptr) {
+		compileBuiltinCall(expr, target);
+		return;
+	}
+
+	if (callee->NumParameters != (int32_t)expr.Arguments.size()) {
+		std::cerr << "ERROR: Wrong number of arguments to "
+			  << expr.Callee << std::endl;
+		Result = -1;
+		return;
+	}
+
+	for (auto exprptr : expr.Arguments) {
+		if (compile(*exprptr, allocateTemporary()) < 0)
+			return;
+	}
+	NumTemporaries = saved_temporaries;
+	Result = getResultRegister(target);
+	emit(OpCall, Result, callee->Index, first);
+}
+
+void BytecodeCompiler::visit(NumberExpressionAST & expr)
+{
+	Result = getResultRegister(Target);
+	emit(OpLoadConstant, Result, expr.Number);
+}
+
+void BytecodeCompiler::visit(UnaryExpressionAST & expr)
+{
+	const int32_t target = Target;
+	const int32_t saved_temporaries = NumTemporaries;
+
+	if (expr.Op == UnaryExpressionAST::Plus) {
+		compile(*expr.Expression, target);
+		return;
+	}
+	int32_t operand = compile(*expr.Expression);
+	if (operand < 0)
+		return;
+	NumTemporaries = saved_temporaries;
+	Result = getResultRegister(target);
+	switch (expr.Op) {
+	case UnaryExpressionAST::Not:
+		emit(OpNot, Result, operand);
+		break;
+	case UnaryExpressionAST::Minus:
+		emit(OpMinus, Result, operand);
+		break;
+	default:
+		emit(OpBitwiseNot, Result, operand);
+		break;
+	}
+}
+
+// References to constants become numbers.  Other variables are top-level
+// variables at top level, and local variables in functions.  Reading a local
+// variable needs no instruction unless its value is wanted in another register.
+void BytecodeCompiler::visit(VariableExpressionAST & expr)
+{
+	auto const_it = Backend.Constants.find(expr.Name);
+	if (const_it != Backend.Constants.end()) {
+		Result = getResultRegister(Target);
+		emit(OpLoadConstant, Result, const_it->second);
+		return;
+	}
+
+	if (isTopLevel()) {
+		Result = getResultRegister(Target);
+		emit(OpLoadGlobal, Result, Backend.getGlobalVariable(expr.Name));
+		return;
+	}
+
+	int32_t reg;
+	auto it = Locals.find(expr.Name);
+	if (it != Locals.end()) {
+		reg = it->second;
+	} else {
+		// The variable is zeroed where it is first referenced.
+		reg = Function.NumLocals++;
+		Locals[expr.Name] = reg;
+		emit(OpLoadConstant, reg, 0);
+	}
+	if (Target >= 0 && Target != reg)
+		emit(OpMove, Target, reg);
+	Result = (Target >= 0) ? Target : reg;
+}
+
+BytecodeBackend::BytecodeBackend()
+	: RegisterStack(4096)
+{
+}
+
+BytecodeBackend::~BytecodeBackend()
+{
+}
+
+bool BytecodeBackend::compileProgramToObjectFile(const ProgramAST & program __attribute__((unused)),
+						 const char *out_filename __attribute__((unused)))
+{
+	std::cerr << "ERROR: The bytecode backend can't compile programs "
+		     "to object files" << std::endl;
+	return false;
+}
+
+InterpreterFunction *
+BytecodeBackend::createFunction(std::shared_ptr<FunctionDefinitionAST> definition)
+{
+	return new BytecodeFunction(definition, AllFunctions.size());
+}
+
+bool BytecodeBackend::isGlobalVariable(const std::string & name) const
+{
+	return GlobalVariables.count(name);
+}
+
+// Return the index of the top-level variable @name, creating it (initialized to
+// 0) if it doesn't exist yet.
+int32_t BytecodeBackend::getGlobalVariable(const std::string & name)
+{
+	auto it = GlobalVariables.find(name);
+	if (it != GlobalVariables.end())
+		return it->second;
+
+	GlobalStorage.push_back(0);
+	GlobalVariables[name] = GlobalStorage.size() - 1;
+	return GlobalStorage.size() - 1;
+}
+
+bool BytecodeBackend::compileFunction(InterpreterFunction & function)
+{
+	BytecodeFunction & func = static_cast<BytecodeFunction &>(function);
+	const FunctionDefinitionAST & def = *func.Definition;
+	BytecodeCompiler compiler(*this, func);
+
+	for (size_t i = 0; i < def.Parameters.size(); i++)
+		compiler.addParameter(def.Parameters[i], i);
+
+	if (!compiler.compile(def.Body))
+		return false;
+	compiler.finish();
+	return true;
+}
+
+// Compile top-level statements into @code.  On failure, the top-level variables
+// they introduced are forgotten.
+bool BytecodeBackend::compileTopLevelStatements(
+			const std::vector<std::shared_ptr<StatementAST>> & stmts,
+			BytecodeFunction & code)
+{
+	auto prev_variables = GlobalVariables;
+	BytecodeCompiler compiler(*this, code);
+
+	if (!compiler.compile(stmts)) {
+		GlobalVariables = prev_variables;
+		return false;
+	}
+	compiler.finish();
+	return true;
+}
+
+// Execute @code, the code of top-level statements, until it returns
+void BytecodeBackend::run(const BytecodeFunction & code)
+{
+	static const void *const Handlers[NumOpcodes] = {
+#define OPCODE_HANDLER(name) &&Do##name,
+		BYTECODE_OPCODES(OPCODE_HANDLER)
+#undef OPCODE_HANDLER
+	};
+
+	// Where to continue and the frame to restore when each active call
+	// returns.  The register receiving the return value is operand A of
+	// the call instruction.
+	struct CallFrame {
+		const BytecodeInstruction *ReturnAddress;
+		size_t Base;
+	};
+	std::vector<CallFrame> calls;
+
+	const std::unique_ptr<InterpreterFunction> *functions = AllFunctions.data();
+	int32_t *globals = GlobalStorage.data();
+	const BytecodeInstruction *pc = code.Code.data();
+	size_t base = 0;
+	int32_t *regs;
+
+	if (RegisterStack.size() < (size_t)code.NumRegisters)
+		RegisterStack.resize(code.NumRegisters);
+	regs = RegisterStack.data();
+
+#define DISPATCH()	goto *Handlers[pc->Op]
+#define NEXT()		do { pc++; DISPATCH(); } while (0)
+#define BINARY(name, expr)						\
+	Do##name: {							\
+		int32_t lhs = regs[pc->B];				\
+		int32_t rhs = regs[pc->C];				\
+		regs[pc->A] = (expr);					\
+		NEXT();							\
+	}
+#define UNARY(name, expr)						\
+	Do##name: {							\
+		uint32_t arg = regs[pc->B];				\
+		regs[pc->A] = (expr);					\
+		NEXT();							\
+	}
+#define COMPARE_AND_JUMP(name, op)					\
+	DoJumpIf##name:							\
+		pc += (regs[pc->A] op regs[pc->B]) ? pc->C : 1;		\
+		DISPATCH();						\
+	DoJumpIf##name##Constant:					\
+		pc += (regs[pc->A] op pc->B) ? pc->C : 1;		\
+		DISPATCH();
+
+	DISPATCH();
+
+	BINARY(Or, lhs != 0 || rhs != 0)
+	BINARY(And, lhs != 0 && rhs != 0)
+	BINARY(LessThan, lhs < rhs)
+	BINARY(GreaterThan, lhs > rhs)
+	BINARY(LessThanOrEqualTo, lhs <= rhs)
+	BINARY(GreaterThanOrEqualTo, lhs >= rhs)
+	BINARY(EqualTo, lhs == rhs)
+	BINARY(NotEqualTo, lhs != rhs)
+	BINARY(BitwiseOr, lhs | rhs)
+	BINARY(BitwiseXor, lhs ^ rhs)
+	BINARY(BitwiseAnd, lhs & rhs)
+	BINARY(LeftShift, (uint32_t)lhs << (rhs & 31))
+	BINARY(RightShift, lhs >> (rhs & 31))
+	BINARY(Add, (uint32_t)lhs + (uint32_t)rhs)
+	BINARY(Subtract, (uint32_t)lhs - (uint32_t)rhs)
+	BINARY(Multiply, (uint32_t)lhs * (uint32_t)rhs)
+	// Like native code, division by zero traps.
+	BINARY(Divide, lhs / rhs)
+	BINARY(Modulo, lhs % rhs)
+	BINARY(Exponentiate, exponentiate(lhs, rhs))
+
+	UNARY(Not, arg == 0)
+	UNARY(Minus, -arg)
+	UNARY(BitwiseNot, ~arg)
+	UNARY(Popcount, __builtin_popcount(arg))
+	UNARY(Clz, (arg == 0) ? 32 : __builtin_clz(arg))
+	UNARY(Ctz, (arg == 0) ? 32 : __builtin_ctz(arg))
+	UNARY(Bswap, __builtin_bswap32(arg))
+
+DoLoadConstant:
+	regs[pc->A] = pc->B;
+	NEXT();
+DoMove:
+	regs[pc->A] = regs[pc->B];
+	NEXT();
+DoAddConstant:
+	regs[pc->A] = (uint32_t)regs[pc->B] + (uint32_t)pc->C;
+	NEXT();
+DoLoadGlobal:
+	regs[pc->A] = globals[pc->B];
+	NEXT();
+DoStoreGlobal:
+	globals[pc->A] = regs[pc->B];
+	NEXT();
+DoAddGlobal:
+	globals[pc->A] = (uint32_t)globals[pc->A] + (uint32_t)regs[pc->B];
+	NEXT();
+DoJump:
+	pc += pc->A;
+	DISPATCH();
+DoJumpIfZero:
+	pc += (regs[pc->A] == 0) ? pc->B : 1;
+	DISPATCH();
+DoJumpIfNonZero:
+	pc += (regs[pc->A] != 0) ? pc->B : 1;
+	DISPATCH();
+
+	COMPARE_AND_JUMP(LessThan, <)
+	COMPARE_AND_JUMP(GreaterThan, >)
+	COMPARE_AND_JUMP(LessThanOrEqualTo, <=)
+	COMPARE_AND_JUMP(GreaterThanOrEqualTo, >=)
+	COMPARE_AND_JUMP(EqualTo, ==)
+	COMPARE_AND_JUMP(NotEqualTo, !=)
+
+DoCall: {
+		const BytecodeFunction & callee =
+			static_cast<const BytecodeFunction &>(*functions[pc->B]);
+		const size_t callee_base = base + pc->C;
+		const size_t frame_end = callee_base + callee.NumRegisters;
+
+		if (frame_end > RegisterStack.size())
+			RegisterStack.resize(std::max(frame_end,
+						      2 * RegisterStack.size()));
+		regs = RegisterStack.data() + callee_base;
+		std::fill(regs + callee.NumParameters, regs + callee.NumLocals, 0);
+		calls.push_back({pc + 1, base});
+		base = callee_base;
+		pc = callee.Code.data();
+		DISPATCH();
+	}
+DoReturn: {
+		const int32_t value = regs[pc->A];
+
+		if (calls.empty())
+			return;
+		pc = calls.back().ReturnAddress;
+		base = calls.back().Base;
+		calls.pop_back();
+		regs = RegisterStack.data() + base;
+		regs[pc[-1].A] = value;
+		DISPATCH();
+	}
+DoPrint:
+	// Print the same way as __garter_print() in the runtime library
+	for (int32_t i = 0; i < pc->B; i++)
+		printf(i == 0 ? "%d" : " %d", regs[pc->A + i]);
+	putchar('\n');
+	NEXT();
+
+#undef COMPARE_AND_JUMP
+#undef UNARY
+#undef BINARY
+#undef NEXT
+#undef DISPATCH
+}
+
+bool BytecodeBackend::executeStatements(
+			const std::vector<std::shared_ptr<StatementAST>> & stmts)
+{
+	BytecodeFunction code(nullptr, -1);
+	if (!compileTopLevelStatements(stmts, code))
+		return false;
+	run(code);
+	return true;
+}
@@ -0,0 +1,71 @@
+#ifndef _GARTER_BYTECODE_BACKEND_H_
+#define _GARTER_BYTECODE_BACKEND_H_
+
+#include <backend/InterpreterBackend.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace garter {
+
+struct BytecodeFunction;
+class BytecodeCompiler;
+
+// Implementation of a garter Backend that compiles programs to a compact
+// register-based bytecode and runs it in a virtual machine, without using LLVM.
+// Like TreeWalkingBackend, it starts up much faster than LLVMBackend; it also
+// runs loops and calls several times faster than TreeWalkingBackend.
+//
+// Each function has a frame of 32-bit registers: its parameters, then its other
+// local variables, then the temporaries holding intermediate values.
+// Instructions name their operands by register number, so 'x = y + z' is a
+// single instruction.  A call passes its arguments in consecutive registers of
+// the caller, which become the first registers of the callee's frame.  Frames
+// live on a stack of registers that grows as needed, so deep recursion doesn't
+// use the native stack.
+//
+// The VM dispatches with computed gotos: each instruction handler jumps
+// directly to the handler of the next instruction.  Common sequences are
+// combined into superinstructions: comparisons that control 'if' and 'while'
+// statements branch directly, adding a constant (such as 'i = i + 1') is a
+// single instruction, and 'x = x + y' on a top-level variable loads, adds and
+// stores in one instruction.
+//
+// Call instructions name functions by their index in AllFunctions.
+class BytecodeBackend : public InterpreterBackend {
+private:
+	// Top-level variables, by name, and their values.  Instructions name
+	// top-level variables by their index in GlobalStorage.
+	std::map<std::string, int32_t> GlobalVariables;
+	std::vector<int32_t> GlobalStorage;
+
+	// Registers of the frames of the functions being executed
+	std::vector<int32_t> RegisterStack;
+
+	int32_t getGlobalVariable(const std::string & name);
+	bool compileTopLevelStatements(
+			const std::vector<std::shared_ptr<StatementAST>> & stmts,
+			BytecodeFunction & code);
+	void run(const BytecodeFunction & code);
+
+	InterpreterFunction *
+	createFunction(std::shared_ptr<FunctionDefinitionAST> definition);
+	bool isGlobalVariable(const std::string & name) const;
+	bool compileFunction(InterpreterFunction & func);
+	bool executeStatements(const std::vector<std::shared_ptr<StatementAST>> & stmts);
+
+	friend class BytecodeCompiler;
+
+public:
+	BytecodeBackend();
+	~BytecodeBackend();
+
+	// Not supported: prints an error message and returns false
+	bool compileProgramToObjectFile(const ProgramAST & program,
+					const char *out_filename);
+};
+
+} // End garter namespace
+
+#endif /* _GARTER_BYTECODE_BACKEND_H_ */
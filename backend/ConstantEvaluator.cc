@@ -0,0 +1,201 @@
+#include <backend/ConstantEvaluator.h>
+#include <iostream>
+
+using namespace garter;
+
+bool ConstantEvaluator::evaluate(ExpressionAST & expr, int32_t & result)
+{
+	Successful = true;
+	expr.acceptVisitor(*this);
+	if (Successful)
+		result = Value;
+	return Successful;
+}
+
+bool garter::defineConstant(ConstantTable & constants,
+			    const ConstantDefinitionAST & constdef, bool is_variable)
+{
+	int32_t value;
+
+	if (constants.count(constdef.Name) || is_variable) {
+		std::cerr << "ERROR: Multiple definitions of "
+			  << constdef.Name << std::endl;
+		return false;
+	}
+
+	ConstantEvaluator evaluator(constants);
+	if (!evaluator.evaluate(*constdef.Expression, value))
+		return false;
+
+	constants[constdef.Name] = value;
+	return true;
+}
+
+int32_t garter::exponentiate(int32_t base, int32_t exponent)
+{
+	uint32_t result = 1;
+	uint32_t power = base;
+
+	if (exponent < 0)
+		return 0;
+
+	while (exponent != 0) {
+		if (exponent & 1)
+			result *= power;
+		power *= power;
+		exponent >>= 1;
+	}
+	return result;
+}
+
+void ConstantEvaluator::visit(BinaryExpressionAST & expr)
+{
+	expr.LHS->acceptVisitor(*this);
+	if (!Successful)
+		return;
+	int32_t lhs = Value;
+
+	expr.RHS->acceptVisitor(*this);
+	if (!Successful)
+		return;
+	int32_t rhs = Value;
+
+	switch (expr.Op) {
+	case BinaryExpressionAST::Or:
+		Value = (lhs != 0 || rhs != 0);
+		break;
+	case BinaryExpressionAST::And:
+		Value = (lhs != 0 && rhs != 0);
+		break;
+	case BinaryExpressionAST::LessThan:
+		Value = (lhs < rhs);
+		break;
+	case BinaryExpressionAST::GreaterThan:
+		Value = (lhs > rhs);
+		break;
+	case BinaryExpressionAST::LessThanOrEqualTo:
+		Value = (lhs <= rhs);
+		break;
+	case BinaryExpressionAST::GreaterThanOrEqualTo:
+		Value = (lhs >= rhs);
+		break;
+	case BinaryExpressionAST::EqualTo:
+		Value = (lhs == rhs);
+		break;
+	case BinaryExpressionAST::NotEqualTo:
+		Value = (lhs != rhs);
+		break;
+	case BinaryExpressionAST::BitwiseOr:
+		Value = lhs | rhs;
+		break;
+	case BinaryExpressionAST::BitwiseXor:
+		Value = lhs ^ rhs;
+		break;
+	case BinaryExpressionAST::BitwiseAnd:
+		Value = lhs & rhs;
+		break;
+	case BinaryExpressionAST::LeftShift:
+		Value = (uint32_t)lhs << (rhs & 31);
+		break;
+	case BinaryExpressionAST::RightShift:
+		Value = lhs >> (rhs & 31);
+		break;
+	case BinaryExpressionAST::Add:
+		Value = (uint32_t)lhs + (uint32_t)rhs;
+		break;
+	case BinaryExpressionAST::Subtract:
+		Value = (uint32_t)lhs - (uint32_t)rhs;
+		break;
+	case BinaryExpressionAST::Multiply:
+		Value = (uint32_t)lhs * (uint32_t)rhs;
+		break;
+	case BinaryExpressionAST::Divide:
+	case BinaryExpressionAST::Modulo:
+		if (rhs == 0 || (lhs == INT32_MIN && rhs == -1)) {
+			std::cerr << "ERROR: Division overflow in constant expression"
+				  << std::endl;
+			Successful = false;
+		} else if (expr.Op == BinaryExpressionAST::Divide) {
+			Value = lhs / rhs;
+		} else {
+			Value = lhs % rhs;
+		}
+		break;
+	case BinaryExpressionAST::Exponentiate:
+		Value = exponentiate(lhs, rhs);
+		break;
+	default:
+		std::cerr << "ERROR: Operator " << expr.getOpStr()
+			  << " not allowed in constant expression" << std::endl;
+		Successful = false;
+		break;
+	}
+}
+
+void ConstantEvaluator::visit(CallExpressionAST & expr)
+{
+	if (expr.Arguments.size() != 1) {
+		std::cerr << "ERROR: Function call " << expr.Callee
+			  << " not allowed in constant expression" << std::endl;
+		Successful = false;
+		return;
+	}
+
+	expr.Arguments[0]->acceptVisitor(*this);
+	if (!Successful)
+		return;
+	uint32_t arg = Value;
+
+	if (expr.Callee == "popcount") {
+		Value = __builtin_popcount(arg);
+	} else if (expr.Callee == "clz") {
+		Value = (arg == 0) ? 32 : __builtin_clz(arg);
+	} else if (expr.Callee == "ctz") {
+		Value = (arg == 0) ? 32 : __builtin_ctz(arg);
+	} else if (expr.Callee == "bswap") {
+		Value = __builtin_bswap32(arg);
+	} else {
+		std::cerr << "ERROR: Function call " << expr.Callee
+			  << " not allowed in constant expression" << std::endl;
+		Successful = false;
+	}
+}
+
+void ConstantEvaluator::visit(NumberExpressionAST & expr)
+{
+	Value = expr.Number;
+}
+
+void ConstantEvaluator::visit(UnaryExpressionAST & expr)
+{
+	expr.Expression->acceptVisitor(*this);
+	if (!Successful)
+		return;
+
+	switch (expr.Op) {
+	case UnaryExpressionAST::Not:
+		Value = (Value == 0);
+		break;
+	case UnaryExpressionAST::Minus:
+		Value = -(uint32_t)Value;
+		break;
+	case UnaryExpressionAST::Plus:
+		break;
+	case UnaryExpressionAST::BitwiseNot:
+		Value = ~Value;
+		break;
+	}
+}
+
+void ConstantEvaluator::visit(VariableExpressionAST & expr)
+{
+	auto it = Constants.find(expr.Name);
+
+	if (it == Constants.end()) {
+		std::cerr << "ERROR: " << expr.Name
+			  << " is not a constant" << std::endl;
+		Successful = false;
+		return;
+	}
+	Value = it->second;
+}
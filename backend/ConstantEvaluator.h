@@ -0,0 +1,60 @@
+#ifndef _GARTER_CONSTANT_EVALUATOR_H_
+#define _GARTER_CONSTANT_EVALUATOR_H_
+
+#include <frontend/Parser.h>
+#include <map>
+#include <string>
+
+namespace garter {
+
+// Table of the values of the constants defined by a program, indexed by name
+typedef std::map<std::string, int32_t> ConstantTable;
+
+// Compute base ** exponent the same way as __garter_exponentiate() in the
+// runtime library
+int32_t exponentiate(int32_t base, int32_t exponent);
+
+// Compute the value of the constant defined by @constdef and add it to
+// @constants.  @is_variable tells whether the name is already that of a
+// variable.  Returns false after printing an error message if the value can't
+// be computed or if the name is already in use.
+bool defineConstant(ConstantTable & constants,
+		    const ConstantDefinitionAST & constdef, bool is_variable);
+
+// ExpressionAST visitor that computes the value of a constant expression at
+// compile time.  A constant expression may contain numeric literals,
+// references to previously defined constants, calls to bit-manipulation
+// builtins, and any operators.  The arithmetic is the same as that of the code
+// generated for the expression at run time: 32-bit two's complement with
+// wrap-around on overflow.
+class ConstantEvaluator : public ExpressionASTVisitor {
+private:
+	const ConstantTable & Constants;
+
+	// Value of the most recently evaluated expression
+	int32_t Value;
+
+	// Set to false if the expression is not constant or cannot be
+	// evaluated
+	bool Successful;
+
+public:
+	ConstantEvaluator(const ConstantTable & constants)
+		: Constants(constants), Value(0), Successful(true)
+	{ }
+
+	// Evaluate @expr.  Returns true and sets @result to the value of the
+	// expression if it is a valid constant expression; otherwise prints an
+	// error message and returns false.
+	bool evaluate(ExpressionAST & expr, int32_t & result);
+
+	void visit(BinaryExpressionAST &);
+	void visit(CallExpressionAST &);
+	void visit(NumberExpressionAST &);
+	void visit(UnaryExpressionAST &);
+	void visit(VariableExpressionAST &);
+};
+
+} // End garter namespace
+
+#endif /* _GARTER_CONSTANT_EVALUATOR_H_ */
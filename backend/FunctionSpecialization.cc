@@ -0,0 +1,185 @@
+#include <backend/FunctionSpecialization.h>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+#include <map>
+#include <sstream>
+
+using namespace garter;
+using namespace llvm;
+
+unsigned FunctionSpecializationPass::countInstructions(const Function & f)
+{
+	unsigned count = 0;
+	for (const BasicBlock & bb : f)
+		count += bb.size();
+	return count;
+}
+
+// Return whether specializing on @arg lets a branch be folded
+bool FunctionSpecializationPass::decidesBranch(const Argument & arg)
+{
+	auto it = DecidesBranch.find(&arg);
+	if (it != DecidesBranch.end())
+		return it->second;
+
+	// Passing the parameter back to itself through recursive calls doesn't
+	// count
+	DecidesBranch[&arg] = false;
+
+	std::vector<const Value*> values = { &arg };
+	while (!values.empty()) {
+		const Value *value = values.back();
+		values.pop_back();
+		for (const Use & use : value->uses()) {
+			const User *user = use.getUser();
+			if (isa<CastInst>(user)) {
+				values.push_back(user);
+			} else if (const ICmpInst *cmp = dyn_cast<ICmpInst>(user)) {
+				if (isa<Constant>(cmp->getOperand(1 - use.getOperandNo())))
+					return DecidesBranch[&arg] = true;
+			} else if (isa<SwitchInst>(user) || isa<BranchInst>(user)) {
+				return DecidesBranch[&arg] = true;
+			} else if (const CallInst *call = dyn_cast<CallInst>(user)) {
+				const Function *callee = call->getCalledFunction();
+				if (callee != nullptr && !callee->isDeclaration() &&
+				    !callee->isVarArg() && call->isArgOperand(&use) &&
+				    decidesBranch(*callee->getArg(call->getArgOperandNo(&use))))
+					return DecidesBranch[&arg] = true;
+			}
+		}
+	}
+	return false;
+}
+
+// Clone @f with the parameters in @args replaced by the corresponding constants.
+// The parameters are removed from the clone's signature.
+Function *FunctionSpecializationPass::createSpecialization(Function & f,
+						       const ConstantArgs & args)
+{
+	ValueToValueMapTy vmap;
+	std::ostringstream desc;
+	size_t i = 0;
+
+	desc << " (";
+	for (Function::arg_iterator argptr = f.arg_begin();
+	     argptr != f.arg_end(); argptr++)
+	{
+		unsigned argno = argptr->getArgNo();
+		if (i == args.size() || args[i].first != argno)
+			continue;
+		vmap[&*argptr] = ConstantInt::get(argptr->getType(), args[i].second);
+		if (i != 0)
+			desc << ", ";
+		desc << argptr->getName().str() << " = " << args[i].second;
+		i++;
+	}
+	desc << ")";
+
+	Function *clone = CloneFunction(&f, vmap);
+	clone->setLinkage(GlobalValue::InternalLinkage);
+	clone->setName(f.getName() + ".spec");
+
+	if (Stats != nullptr) {
+		Stats->Specializations.push_back(clone->getName().str() + desc.str());
+		Stats->InstructionsAdded += countInstructions(*clone);
+	}
+	return clone;
+}
+
+// Replace @call with a call to @clone, which takes only the arguments of @call
+// that are not in @args.
+void FunctionSpecializationPass::redirectCall(CallInst *call, Function *clone,
+					  const ConstantArgs & args)
+{
+	std::vector<Value*> new_args;
+	size_t i = 0;
+
+	for (unsigned argno = 0; argno < call->arg_size(); argno++) {
+		if (i < args.size() && args[i].first == argno)
+			i++;
+		else
+			new_args.push_back(call->getArgOperand(argno));
+	}
+
+	CallInst *new_call = CallInst::Create(clone->getFunctionType(), clone, new_args, "", call);
+	new_call->setTailCall(call->isTailCall());
+	new_call->setDebugLoc(call->getDebugLoc());
+	call->replaceAllUsesWith(new_call);
+	new_call->takeName(call);
+	call->eraseFromParent();
+
+	if (Stats != nullptr)
+		Stats->CallsRedirected++;
+}
+
+PreservedAnalyses FunctionSpecializationPass::run(Module & mod,
+						 ModuleAnalysisManager & mam __attribute__((unused)))
+{
+	unsigned module_size = 0;
+	unsigned growth = 0;
+	bool changed = false;
+
+	DecidesBranch.clear();
+	for (const Function & f : mod)
+		module_size += countInstructions(f);
+
+	const unsigned max_growth = (uint64_t)module_size * MaxGrowth / 100;
+
+	// Only consider the functions originally in the module, not the clones
+	// added to it along the way.  Functions marked optnone must be left as
+	// they are.
+	std::vector<Function*> functions;
+	for (Function & f : mod)
+		if (!f.isDeclaration() && !f.isVarArg() && f.arg_size() != 0 &&
+		    !f.hasOptNone())
+			functions.push_back(&f);
+
+	// Calls made by the clones may themselves be specialized, so repeat
+	// until no more calls are redirected.
+	std::map<Function*, std::map<ConstantArgs, Function*>> clones;
+	bool redirected;
+	do {
+		redirected = false;
+		for (Function *f : functions) {
+			const unsigned size = countInstructions(*f);
+			if (size > SizeLimit)
+				continue;
+
+			// Find direct calls to the function that pass constant
+			// arguments for parameters that decide branches.
+			std::vector<std::pair<CallInst*, ConstantArgs>> calls;
+			for (User *user : f->users()) {
+				CallInst *call = dyn_cast<CallInst>(user);
+				if (call == nullptr || call->getCalledFunction() != f)
+					continue;
+
+				ConstantArgs args;
+				for (unsigned argno = 0; argno < call->arg_size(); argno++) {
+					ConstantInt *c = dyn_cast<ConstantInt>(call->getArgOperand(argno));
+					if (c != nullptr && decidesBranch(*f->getArg(argno)))
+						args.push_back(std::make_pair(argno, c->getSExtValue()));
+				}
+				if (!args.empty())
+					calls.push_back(std::make_pair(call, args));
+			}
+
+			for (auto & entry : calls) {
+				Function *& clone = clones[f][entry.second];
+				if (clone == nullptr) {
+					if (growth + size > max_growth)
+						continue;
+					growth += size;
+					clone = createSpecialization(*f, entry.second);
+				}
+				redirectCall(entry.first, clone, entry.second);
+				redirected = true;
+				changed = true;
+			}
+		}
+	} while (redirected);
+	return changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
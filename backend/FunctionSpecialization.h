@@ -0,0 +1,78 @@
+#ifndef _GARTER_FUNCTION_SPECIALIZATION_H_
+#define _GARTER_FUNCTION_SPECIALIZATION_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <llvm/IR/PassManager.h>
+
+namespace garter {
+
+// Statistics collected by the function specialization pass
+struct SpecializationStats {
+	// Description of each specialized function created, for example
+	// "pow.spec (exponent = 3)"
+	std::vector<std::string> Specializations;
+
+	// Number of calls redirected to a specialized function
+	unsigned CallsRedirected;
+
+	// Number of instructions added to the module by cloning
+	unsigned InstructionsAdded;
+
+	SpecializationStats()
+		: CallsRedirected(0), InstructionsAdded(0)
+	{
+	}
+};
+
+// Pass that specializes functions on constant arguments.  For each call that
+// passes constant integers for parameters that decide branches, the called
+// function is cloned with those parameters replaced by the constants, and the
+// call is redirected to the clone.  Later passes can then fold away the
+// branches.  A parameter decides a branch if it's compared with a constant,
+// switched on, or used as a branch condition, directly or by being passed to a
+// parameter of another function that does.  Other constant arguments are left
+// alone, so calls that pass the same constants for the deciding parameters
+// share one clone.  Calls made by the clones are specialized too.
+//
+// The pass expects parameters to have been promoted out of memory, so it's run
+// after the early simplification passes.
+//
+// Functions larger than @size_limit instructions are not specialized, and
+// cloning stops once the module has grown by @max_growth percent.  If @stats
+// is not nullptr, statistics are accumulated into it.
+class FunctionSpecializationPass
+		: public llvm::PassInfoMixin<FunctionSpecializationPass> {
+private:
+	unsigned SizeLimit;
+	unsigned MaxGrowth;
+	SpecializationStats *Stats;
+
+	// The constant arguments of a call: (argument number, value) pairs
+	typedef std::vector<std::pair<unsigned, int64_t>> ConstantArgs;
+
+	// Whether each parameter considered so far decides a branch
+	std::map<const llvm::Argument*, bool> DecidesBranch;
+
+	static unsigned countInstructions(const llvm::Function & f);
+	bool decidesBranch(const llvm::Argument & arg);
+	llvm::Function *createSpecialization(llvm::Function & f,
+					     const ConstantArgs & args);
+	void redirectCall(llvm::CallInst *call, llvm::Function *clone,
+			  const ConstantArgs & args);
+public:
+	FunctionSpecializationPass(unsigned size_limit, unsigned max_growth,
+				   SpecializationStats *stats)
+		: SizeLimit(size_limit), MaxGrowth(max_growth), Stats(stats)
+	{
+	}
+
+	llvm::PreservedAnalyses run(llvm::Module & mod,
+				    llvm::ModuleAnalysisManager & mam);
+};
+
+} // End garter namespace
+
+#endif /* _GARTER_FUNCTION_SPECIALIZATION_H_ */
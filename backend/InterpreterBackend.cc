@@ -0,0 +1,112 @@
+#include <backend/InterpreterBackend.h>
+#include <frontend/Parser.h>
+#include <iostream>
+
+using namespace garter;
+
+// Record a function definition.  Returns false if an identically-named
+// function was already defined.
+bool InterpreterBackend::defineFunction(std::shared_ptr<FunctionDefinitionAST> func)
+{
+	if (Functions.count(func->Name)) {
+		std::cerr << "ERROR: Multiple definitions of "
+			  << func->Name << std::endl;
+		return false;
+	}
+	AllFunctions.emplace_back(createFunction(func));
+	Functions[func->Name] = AllFunctions.back().get();
+	return true;
+}
+
+// Forget a function whose compilation failed.  Functions compiled while it was
+// being compiled may call it; they are forgotten too, so no code that calls a
+// function that failed to compile is ever run.
+void InterpreterBackend::failFunction(InterpreterFunction & func)
+{
+	func.State = InterpreterFunction::Failed;
+	Functions.erase(func.Definition->Name);
+
+	for (InterpreterFunction *caller : func.Callers) {
+		if (caller->State != InterpreterFunction::Compiled)
+			continue;
+		std::cerr << "ERROR: " << caller->Definition->Name << " calls "
+			  << func.Definition->Name
+			  << ", which failed to compile" << std::endl;
+		failFunction(*caller);
+	}
+}
+
+InterpreterFunction *InterpreterBackend::getFunction(const std::string & name)
+{
+	auto it = Functions.find(name);
+	if (it == Functions.end())
+		return nullptr;
+
+	InterpreterFunction & func = *it->second;
+	if (func.State == InterpreterFunction::Uncompiled) {
+		const FunctionDefinitionAST & def = *func.Definition;
+		func.State = InterpreterFunction::Compiling;
+		for (const std::string & param : def.Parameters) {
+			if (Constants.count(param)) {
+				std::cerr << "ERROR: Parameter " << param
+					  << " of " << def.Name
+					  << " has the same name as a constant"
+					  << std::endl;
+				failFunction(func);
+				return nullptr;
+			}
+		}
+
+		CompileStack.push_back(&func);
+		bool ok = compileFunction(func);
+		CompileStack.pop_back();
+		if (!ok) {
+			failFunction(func);
+			return nullptr;
+		}
+		func.State = InterpreterFunction::Compiled;
+	}
+
+	if (!CompileStack.empty() && (func.Callers.empty() ||
+				       func.Callers.back() != CompileStack.back()))
+		func.Callers.push_back(CompileStack.back());
+	return &func;
+}
+
+bool InterpreterBackend::executeTopLevelItem(std::shared_ptr<ASTBase> top_level_item)
+{
+	std::shared_ptr<FunctionDefinitionAST> func =
+		std::dynamic_pointer_cast<FunctionDefinitionAST>(top_level_item);
+	std::shared_ptr<StatementAST> stmt =
+		std::dynamic_pointer_cast<StatementAST>(top_level_item);
+	std::shared_ptr<ConstantDefinitionAST> constdef =
+		std::dynamic_pointer_cast<ConstantDefinitionAST>(top_level_item);
+
+	if (constdef)
+		return defineConstant(Constants, *constdef,
+				      isGlobalVariable(constdef->Name));
+	if (func)
+		return defineFunction(func);
+	return executeStatements({stmt});
+}
+
+bool InterpreterBackend::executeProgram(const ProgramAST & program)
+{
+	std::vector<std::shared_ptr<StatementAST>> main_body;
+
+	for (auto itemptr : program.TopLevelItems) {
+		auto constdef = std::dynamic_pointer_cast<ConstantDefinitionAST>(itemptr);
+		if (constdef && !defineConstant(Constants, *constdef,
+						isGlobalVariable(constdef->Name)))
+			return false;
+	}
+	for (auto itemptr : program.TopLevelItems) {
+		auto func = std::dynamic_pointer_cast<FunctionDefinitionAST>(itemptr);
+		if (func && !defineFunction(func))
+			return false;
+		auto stmt = std::dynamic_pointer_cast<StatementAST>(itemptr);
+		if (stmt)
+			main_body.push_back(stmt);
+	}
+	return executeStatements(main_body);
+}
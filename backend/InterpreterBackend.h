@@ -0,0 +1,94 @@
+#ifndef _GARTER_INTERPRETER_BACKEND_H_
+#define _GARTER_INTERPRETER_BACKEND_H_
+
+#include <backend/Backend.h>
+#include <backend/ConstantEvaluator.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace garter {
+
+class FunctionDefinitionAST;
+class StatementAST;
+
+// A function defined by a program run by an InterpreterBackend.  Each backend
+// derives the representation of its compiled functions from it.
+struct InterpreterFunction {
+	// Definition of the function, or nullptr for top-level statements
+	std::shared_ptr<FunctionDefinitionAST> Definition;
+
+	// Whether the function has been compiled.  Compilation is in progress
+	// while compiling the functions that the function calls, which may
+	// include the function itself.
+	enum { Uncompiled, Compiling, Compiled, Failed } State;
+
+	// Functions whose code refers to this one
+	std::vector<InterpreterFunction*> Callers;
+
+	InterpreterFunction(std::shared_ptr<FunctionDefinitionAST> definition)
+		: Definition(definition), State(Uncompiled)
+	{
+	}
+
+	virtual ~InterpreterFunction() { }
+};
+
+// Base of the garter Backends that run programs without LLVM
+// (TreeWalkingBackend, BytecodeBackend and TemplateJITBackend).  It keeps the
+// constants and functions defined so far and handles each kind of top-level
+// item; the backends compile functions and run top-level statements.
+// Functions are compiled when first referenced.
+class InterpreterBackend : public Backend {
+protected:
+	// Functions defined so far, by name.  All functions ever defined are
+	// owned by AllFunctions, since the code of other functions may refer
+	// to them.
+	std::map<std::string, InterpreterFunction*> Functions;
+	std::vector<std::unique_ptr<InterpreterFunction>> AllFunctions;
+
+	// Values of the constants defined so far
+	ConstantTable Constants;
+
+	// Functions being compiled, innermost last
+	std::vector<InterpreterFunction*> CompileStack;
+
+	// Return the function @name, compiling it if this is its first
+	// reference.  Returns nullptr if no such function has been defined or
+	// if its compilation failed.  A reference made while compiling a
+	// function is recorded as a call.
+	InterpreterFunction *getFunction(const std::string & name);
+
+	// Create the representation of the function defined by @definition,
+	// which will be AllFunctions[AllFunctions.size()]
+	virtual InterpreterFunction *
+	createFunction(std::shared_ptr<FunctionDefinitionAST> definition) = 0;
+
+	// Return whether @name is that of a top-level variable
+	virtual bool isGlobalVariable(const std::string & name) const = 0;
+
+	// Compile the body of @func.  Returns false after printing an error
+	// message on failure.
+	virtual bool compileFunction(InterpreterFunction & func) = 0;
+
+	// Compile top-level statements, then run them.  Statements are
+	// compiled before any is run, and a top-level 'return' ends them.
+	// Returns false after printing an error message if they couldn't be
+	// compiled, in which case the top-level variables they introduced are
+	// forgotten.
+	virtual bool executeStatements(
+			const std::vector<std::shared_ptr<StatementAST>> & stmts) = 0;
+
+private:
+	void failFunction(InterpreterFunction & func);
+	bool defineFunction(std::shared_ptr<FunctionDefinitionAST> func);
+
+public:
+	bool executeTopLevelItem(std::shared_ptr<ASTBase> top_level_item);
+	bool executeProgram(const ProgramAST & program);
+};
+
+} // End garter namespace
+
+#endif /* _GARTER_INTERPRETER_BACKEND_H_ */
@@ -0,0 +1,49 @@
+#include <backend/JITMemoryMapper.h>
+
+using namespace garter;
+using namespace llvm;
+
+sys::MemoryBlock
+JITMemoryMapper::allocateMappedMemory(SectionMemoryManager::AllocationPurpose purpose,
+				      size_t num_bytes,
+				      const sys::MemoryBlock *const near_block,
+				      unsigned flags, std::error_code & ec)
+{
+	sys::MemoryBlock block = sys::Memory::allocateMappedMemory(num_bytes,
+								   near_block,
+								   flags, ec);
+	if (block.base() == nullptr)
+		return block;
+
+	if (purpose == SectionMemoryManager::AllocationPurpose::Code)
+		CodeBytes += block.allocatedSize();
+	else
+		DataBytes += block.allocatedSize();
+
+	std::lock_guard<std::mutex> lock(Mutex);
+	Blocks[block.base()] = purpose;
+	return block;
+}
+
+std::error_code JITMemoryMapper::protectMappedMemory(const sys::MemoryBlock & block,
+						     unsigned flags)
+{
+	return sys::Memory::protectMappedMemory(block, flags);
+}
+
+std::error_code JITMemoryMapper::releaseMappedMemory(sys::MemoryBlock & block)
+{
+	const size_t size = block.allocatedSize();
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		auto it = Blocks.find(block.base());
+		if (it != Blocks.end()) {
+			if (it->second == SectionMemoryManager::AllocationPurpose::Code)
+				CodeBytes -= size;
+			else
+				DataBytes -= size;
+			Blocks.erase(it);
+		}
+	}
+	return sys::Memory::releaseMappedMemory(block);
+}
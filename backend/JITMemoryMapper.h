@@ -0,0 +1,42 @@
+#ifndef _GARTER_JIT_MEMORY_MAPPER_H_
+#define _GARTER_JIT_MEMORY_MAPPER_H_
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+
+namespace garter {
+
+// Allocator of the memory holding the code and data compiled by the JIT, which
+// keeps count of the bytes currently mapped for each.  Each object the JIT
+// loads gets a SectionMemoryManager of its own, which releases its memory
+// when the object is removed from the JIT.
+class JITMemoryMapper : public llvm::SectionMemoryManager::MemoryMapper {
+private:
+	// Purpose of each mapped block, by address
+	std::map<void*, llvm::SectionMemoryManager::AllocationPurpose> Blocks;
+	std::mutex Mutex;
+
+public:
+	// Bytes currently mapped for code and for (read-only or writable) data
+	std::atomic<uint64_t> CodeBytes;
+	std::atomic<uint64_t> DataBytes;
+
+	JITMemoryMapper() : CodeBytes(0), DataBytes(0) { }
+
+	llvm::sys::MemoryBlock
+	allocateMappedMemory(llvm::SectionMemoryManager::AllocationPurpose purpose,
+			     size_t num_bytes,
+			     const llvm::sys::MemoryBlock *const near_block,
+			     unsigned flags, std::error_code & ec) override;
+
+	std::error_code protectMappedMemory(const llvm::sys::MemoryBlock & block,
+					    unsigned flags) override;
+
+	std::error_code releaseMappedMemory(llvm::sys::MemoryBlock & block) override;
+};
+
+} // End garter namespace
+
+#endif /* _GARTER_JIT_MEMORY_MAPPER_H_ */
@@ -0,0 +1,179 @@
+#include <backend/JITObjectCache.h>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Metadata.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+#include <utime.h>
+
+using namespace garter;
+using namespace llvm;
+
+// Name of the module flag holding a module's key
+static const char KeyFlag[] = "garter.cache_key";
+
+JITObjectCache::JITObjectCache(const std::string & dir, uint64_t size_limit)
+	: Dir(dir), SizeLimit(size_limit),
+	  Hits(0), Misses(0), Stores(0), Evictions(0)
+{
+	std::error_code ec = sys::fs::create_directories(Dir);
+	if (ec)
+		std::cerr << "ERROR: can't create " << Dir << ": "
+			  << ec.message() << std::endl;
+}
+
+std::string JITObjectCache::getPath(const std::string & key) const
+{
+	SmallString<128> path(Dir);
+	sys::path::append(path, key + ".o");
+	return path.str().str();
+}
+
+// Return the key a module was tagged with, or an empty string
+std::string JITObjectCache::getKey(const Module & mod)
+{
+	MDString *key = dyn_cast_or_null<MDString>(mod.getModuleFlag(KeyFlag));
+	if (key == nullptr)
+		return "";
+	return key->getString().str();
+}
+
+bool JITObjectCache::lookup(Module & mod, const std::string & parameters)
+{
+	SmallVector<char, 4096> bitcode;
+	raw_svector_ostream os(bitcode);
+	WriteBitcodeToFile(mod, os);
+
+	SHA1 hasher;
+	hasher.update(LLVM_VERSION_STRING);
+	hasher.update(StringRef("\0", 1));
+	hasher.update(parameters);
+	hasher.update(StringRef("\0", 1));
+	hasher.update(StringRef(bitcode.data(), bitcode.size()));
+	const std::string key = toHex(hasher.final(), true);
+
+	mod.addModuleFlag(Module::Warning, KeyFlag, MDString::get(mod.getContext(), key));
+
+	const std::string path = getPath(key);
+	auto obj = MemoryBuffer::getFile(path);
+	if (!obj) {
+		Misses++;
+		return false;
+	}
+
+	// The modification time records when the object was last used.
+	utime(path.c_str(), nullptr);
+
+	Hits++;
+	std::lock_guard<std::mutex> lock(Mutex);
+	LoadedObjects[key] = std::move(*obj);
+	return true;
+}
+
+std::unique_ptr<MemoryBuffer> JITObjectCache::getObject(const Module *mod)
+{
+	const std::string key = getKey(*mod);
+	if (key.empty())
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock(Mutex);
+	auto it = LoadedObjects.find(key);
+	if (it == LoadedObjects.end())
+		return nullptr;
+	std::unique_ptr<MemoryBuffer> obj = std::move(it->second);
+	LoadedObjects.erase(it);
+	return obj;
+}
+
+void JITObjectCache::notifyObjectCompiled(const Module *mod, MemoryBufferRef obj)
+{
+	const std::string key = getKey(*mod);
+	if (key.empty())
+		return;
+
+	// Write to a temporary file, then rename it, so that other processes
+	// never see a partially written object.
+	const std::string path = getPath(key);
+	const std::string tmp_path = path + ".tmp" + std::to_string(getpid());
+	{
+		std::error_code ec;
+		raw_fd_ostream os(tmp_path, ec, sys::fs::OF_None);
+		if (ec)
+			return;
+		os << obj.getBuffer();
+		os.close();
+		if (os.has_error()) {
+			os.clear_error();
+			sys::fs::remove(tmp_path);
+			return;
+		}
+	}
+	if (sys::fs::rename(tmp_path, path)) {
+		sys::fs::remove(tmp_path);
+		return;
+	}
+	Stores++;
+	evict();
+}
+
+// Delete the least recently used objects until the cache fits in its size
+// limit
+void JITObjectCache::evict()
+{
+	Evictions += evictLeastRecentlyUsed(Dir, ".o", SizeLimit);
+}
+
+unsigned garter::evictLeastRecentlyUsed(const std::string & dir,
+					const std::string & extension,
+					uint64_t size_limit)
+{
+	struct CachedFile {
+		std::string Path;
+		uint64_t Size;
+		sys::TimePoint<> LastUsed;
+	};
+	std::vector<CachedFile> files;
+	uint64_t total_size = 0;
+	unsigned evictions = 0;
+	std::error_code ec;
+
+	for (sys::fs::directory_iterator it(dir, ec), it_end;
+	     it != it_end && !ec; it.increment(ec))
+	{
+		const std::string path = it->path();
+		if (sys::path::extension(path) != extension)
+			continue;
+		sys::fs::file_status status;
+		if (sys::fs::status(path, status))
+			continue;
+		files.push_back({path, status.getSize(),
+				 status.getLastModificationTime()});
+		total_size += status.getSize();
+	}
+	if (total_size <= size_limit)
+		return 0;
+
+	std::sort(files.begin(), files.end(),
+		  [](const CachedFile & a, const CachedFile & b) {
+			return a.LastUsed < b.LastUsed;
+		  });
+	for (const CachedFile & file : files) {
+		if (total_size <= size_limit)
+			break;
+		// Another process may have deleted it already
+		if (!sys::fs::remove(file.Path, false))
+			evictions++;
+		total_size -= file.Size;
+	}
+	return evictions;
+}
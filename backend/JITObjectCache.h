@@ -0,0 +1,74 @@
+#ifndef _GARTER_JIT_OBJECT_CACHE_H_
+#define _GARTER_JIT_OBJECT_CACHE_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+
+namespace llvm {
+	class MemoryBuffer;
+	class Module;
+};
+
+namespace garter {
+
+// Persistent cache of machine code compiled by the JIT, stored as one object
+// file per module in a directory.
+//
+// Modules are identified by a key computed from their IR before optimization,
+// so that on a cache hit neither optimization nor code generation has to be
+// done.  The user of the cache calls lookup() with the unoptimized module,
+// which tags the module with its key.  The JIT's compiler then calls
+// getObject() and notifyObjectCompiled(), which only act on tagged modules.
+//
+// When the total size of the cached objects exceeds the size limit, the least
+// recently used objects are deleted.  Several processes may use the same cache
+// directory at the same time.
+class JITObjectCache : public llvm::ObjectCache {
+private:
+	std::string Dir;
+	uint64_t SizeLimit;
+
+	// Objects found by lookup(), to be handed to the JIT by getObject()
+	std::map<std::string, std::unique_ptr<llvm::MemoryBuffer>> LoadedObjects;
+	std::mutex Mutex;
+
+	std::string getPath(const std::string & key) const;
+	static std::string getKey(const llvm::Module & mod);
+	void evict();
+
+public:
+	// Statistics
+	std::atomic<unsigned> Hits;
+	std::atomic<unsigned> Misses;
+	std::atomic<unsigned> Stores;
+	std::atomic<unsigned> Evictions;
+
+	JITObjectCache(const std::string & dir, uint64_t size_limit);
+
+	// Compute the key of the unoptimized module @mod and tag the module
+	// with it.  @parameters must describe everything besides the IR that
+	// affects the generated code, such as the optimization level and the
+	// target CPU.  Returns true if the object for the module is cached, in
+	// which case the module doesn't need to be optimized.
+	bool lookup(llvm::Module & mod, const std::string & parameters);
+
+	void notifyObjectCompiled(const llvm::Module *mod,
+				  llvm::MemoryBufferRef obj) override;
+	std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *mod) override;
+};
+
+// Delete the least recently used files with the extension @extension (such as
+// ".o") in the cache directory @dir, until the total size of the remaining ones
+// is at most @size_limit bytes.  A file's modification time records when it
+// was last used.  Returns the number of files deleted.
+unsigned evictLeastRecentlyUsed(const std::string & dir,
+				const std::string & extension,
+				uint64_t size_limit);
+
+} // End garter namespace
+
+#endif /* _GARTER_JIT_OBJECT_CACHE_H_ */
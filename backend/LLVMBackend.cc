@@ -1,20 +1,46 @@
 #include <backend/LLVMBackend.h>
+#include <backend/Profile.h>
 #include <frontend/Parser.h>
 
-#include <llvm/Assembly/PrintModulePass.h>
-#include <llvm/ExecutionEngine/GenericValue.h>
-#include <llvm/ExecutionEngine/JIT.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/Dominators.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
-#include <llvm/PassManager.h>
-#include <llvm/Support/FormattedStream.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/MC/MCSubtargetInfo.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Passes/StandardInstrumentations.h>
+#include <llvm/Support/FileUtilities.h>
 #include <llvm/Support/Host.h>
-#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Program.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/ThreadPool.h>
 #include <llvm/Support/ToolOutputFile.h>
-#include <llvm/Transforms/IPO.h>
-#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 
 using namespace garter;
 using namespace llvm;
@@ -39,56 +65,221 @@ int32_t __attribute__((weak)) __garter_exponentiate(int32_t base __attribute__((
 	abort();
 }
 
+namespace {
 
-LLVMBackend::LLVMBackend()
-		: Ctx(),
+// Handler of the LLVMContext's diagnostics that collects the optimization
+// remarks of the loop and SLP vectorizers into a VectorizationStats.  Other
+// diagnostics are left to the default handler.
+class VectorizationRemarkHandler : public DiagnosticHandler {
+private:
+	VectorizationStats & Stats;
+public:
+	VectorizationRemarkHandler(VectorizationStats & stats)
+		: Stats(stats)
+	{
+	}
+
+	bool isAnyRemarkEnabled() const override
+	{
+		return true;
+	}
+
+	bool isPassedOptRemarkEnabled(StringRef pass) const override
+	{
+		return pass == "loop-vectorize" || pass == "slp-vectorizer";
+	}
+
+	bool handleDiagnostics(const DiagnosticInfo & info) override
+	{
+		const auto *remark = dyn_cast<OptimizationRemark>(&info);
+		if (remark == nullptr ||
+		    !isPassedOptRemarkEnabled(remark->getPassName()))
+			return false;
+
+		if (remark->getPassName() == "slp-vectorizer") {
+			Stats.SLPVectorized++;
+			return true;
+		}
+
+		// "Vectorized" or "Interleaved" loop
+		std::string width = "1";
+		std::string interleave = "1";
+		for (const auto & arg : remark->getArgs()) {
+			if (arg.Key == "VectorizationFactor")
+				width = arg.Val;
+			else if (arg.Key == "InterleaveCount")
+				interleave = arg.Val;
+		}
+		Stats.Loops.push_back("loop in " +
+				      remark->getFunction().getName().str() +
+				      ": width " + width +
+				      ", interleave " + interleave);
+		unsigned n;
+		if (!StringRef(width).getAsInteger(10, n))
+			Stats.LoopsByWidth[n]++;
+		return true;
+	}
+};
+
+} // End anonymous namespace
+
+LLVMBackend::LLVMBackend(const LLVMBackendOptions & options)
+		: Options(options),
+		  TSCtx(std::make_unique<LLVMContext>()),
+		  Ctx(*TSCtx.getContext()),
 		  Mod(new Module("", Ctx)),
 		  Builder(Ctx),
 		  Int32Ty(Builder.getInt32Ty()),
-		  Engine(nullptr),
-		  StatementNumber(1)
+		  StatementNumber(1),
+		  Incremental(false),
+		  RuntimeBitcodeLoaded(false),
+		  OptimizeTime(0),
+		  CodegenTime(0),
+		  FunctionsCompiled(),
+		  TierUpStop(false)
 {
+	if (Options.ReportVectorization)
+		Ctx.setDiagnosticHandler(
+			std::make_unique<VectorizationRemarkHandler>(VecStats));
 }
 
 LLVMBackend::~LLVMBackend()
 {
-	if (Engine == nullptr)
-		delete Mod;
-	else
-		delete Engine;
+	// Wait for any optimized code being compiled, but don't start
+	// compiling more.
+	if (TierUpThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(TierUpMutex);
+			TierUpStop = true;
+		}
+		TierUpCond.notify_one();
+		TierUpThread.join();
+	}
 }
 
-// Given the AST node for a function definition, create and return the
-// llvm::Function corresponding to the function prototype.  Returns nullptr if
-// an identically-named function was already defined.
-Function *LLVMBackend::generateFunctionPrototype(const FunctionDefinitionAST & func)
+// Return the llvm::Function for the garter function @name in the current
+// module, declaring it if it was defined in another module.  If the IR for the
+// function hasn't been generated yet, it is generated now.  Returns nullptr if
+// no such function has been defined.
+Function *LLVMBackend::getFunction(const std::string & name)
 {
-	// Get function type
-	FunctionType *funcTy;
-	{
-		std::vector<Type*> param_types(func.Parameters.size(), Int32Ty);
-		funcTy = FunctionType::get(Int32Ty, param_types, false);
+	Function *f = Mod->getFunction(name);
+	if (f != nullptr)
+		return f;
+
+	if (PendingFunctions.count(name)) {
+		if (!generatePendingFunction(name))
+			return nullptr;
+		f = Mod->getFunction(name);
+		if (f != nullptr)
+			return f;
 	}
 
-	// Create the function
+	auto it = DefinedFunctions.find(name);
+	if (it == DefinedFunctions.end())
+		return nullptr;
+	return Function::Create(it->second, Function::ExternalLinkage, name, *Mod);
+}
+
+// Return the llvm::GlobalVariable for the top-level variable @name in the
+// current module.  The variable is declared if it was defined in another
+// module, or defined (initialized to 0) if it doesn't exist yet.
+GlobalVariable *LLVMBackend::getVariable(const std::string & name)
+{
+	GlobalVariable *var = Mod->getGlobalVariable(name, true);
+	if (var != nullptr)
+		return var;
+
+	if (DefinedVariables.count(name))
+		return new GlobalVariable(*Mod, Int32Ty, false,
+					  GlobalValue::ExternalLinkage,
+					  nullptr, name);
+
+	DefinedVariables.insert(name);
+	return new GlobalVariable(*Mod, Int32Ty, false,
+				  Incremental ? GlobalValue::ExternalLinkage :
+						GlobalValue::InternalLinkage,
+				  Builder.getInt32(0), name);
+}
+
+// Record the name, type and optimization level of a function definition.
+// Returns false if an identically-named function was already defined.
+bool LLVMBackend::registerFunction(const FunctionDefinitionAST & func)
+{
+	// Check for multiple definition
+	if (DefinedFunctions.count(func.Name)) {
+		std::cerr << "ERROR: Multiple definitions of "
+			  << func.Name << std::endl;
+		return false;
+	}
+
+	std::vector<Type*> param_types(func.Parameters.size(), Int32Ty);
+	DefinedFunctions[func.Name] = FunctionType::get(Int32Ty, param_types, false);
+
+	if (func.Attributes.OptLevel > 0)
+		FunctionOptLevels[func.Name] = func.Attributes.OptLevel;
+	return true;
+}
+
+// Given the AST node for a registered function definition, create and return
+// the llvm::Function corresponding to the function prototype in the current
+// module.
+Function *LLVMBackend::createFunction(const FunctionDefinitionAST & func)
+{
+	FunctionType *funcTy = DefinedFunctions[func.Name];
+
+	// Create the function.  When compiling incrementally, functions are
+	// referenced from the modules of later top-level items, so they can't
+	// have internal linkage.
 	Function::LinkageTypes linkage;
 	if (func.IsExtern) {
+		// An empty definition (such as the 'main' of a file with no
+		// top-level statements) yields to any other definition.
 		if (func.Body.size() == 0)
-			linkage = Function::ExternalWeakLinkage;
+			linkage = Function::WeakAnyLinkage;
 		else
 			linkage = Function::ExternalLinkage;
+	} else if (Incremental) {
+		linkage = Function::ExternalLinkage;
 	} else {
 		linkage = Function::InternalLinkage;
 	}
-	Function *f = Function::Create(funcTy, linkage, func.Name, Mod);
+	Function *f = Function::Create(funcTy, linkage, func.Name, *Mod);
 
 	assert(f != nullptr);
 
-	// Check for multiple definition
-	if (f->getName() != func.Name) {
-		std::cerr << "ERROR: Multiple definitions of "
-			  << func.Name << std::endl;
-		return nullptr;
+	// Apply performance attributes.  Hot and cold functions are placed in
+	// separate text sections so that rarely executed code doesn't share
+	// cache lines and pages with frequently executed code.
+	const FunctionDefinitionAST::FunctionAttributes & attrs = func.Attributes;
+	if (attrs.Hot) {
+		f->addFnAttr(Attribute::Hot);
+		f->setSection(".text.hot");
+	}
+	if (attrs.Cold) {
+		f->addFnAttr(Attribute::Cold);
+		f->setSection(".text.unlikely");
+	}
+	if (attrs.Inline)
+		f->addFnAttr(Attribute::AlwaysInline);
+	if (attrs.NoInline)
+		f->addFnAttr(Attribute::NoInline);
+	if (attrs.OptLevel == 0) {
+		// Unoptimized functions are skipped by all optimization passes.
+		// optnone requires noinline.
+		f->addFnAttr(Attribute::OptimizeNone);
+		f->removeFnAttr(Attribute::AlwaysInline);
+		f->addFnAttr(Attribute::NoInline);
+	} else if (attrs.OptLevel > 0) {
+		// Record the level in the IR too, so that it's part of the
+		// object cache key.
+		f->addFnAttr("garter-opt-level", std::to_string(attrs.OptLevel));
+
+		// Code optimized at a higher level must not be inlined into
+		// code that asked for a lower level, and vice versa.  A
+		// function asking for the default level can still be inlined.
+		if (!attrs.Inline && (unsigned)attrs.OptLevel != Options.OptLevel)
+			f->addFnAttr(Attribute::NoInline);
 	}
 
 	// Set parameter names
@@ -103,6 +294,48 @@ Function *LLVMBackend::generateFunctionPrototype(const FunctionDefinitionAST & f
 	return f;
 }
 
+// Given the AST node for a function definition, create and return the
+// llvm::Function corresponding to the function prototype.  Returns nullptr if
+// an identically-named function was already defined.
+Function *LLVMBackend::generateFunctionPrototype(const FunctionDefinitionAST & func)
+{
+	if (!registerFunction(func))
+		return nullptr;
+	return createFunction(func);
+}
+
+// Generate the IR for a function whose definition was deferred until it was
+// first referenced, and remove it from PendingFunctions.  When compiling
+// incrementally, the function gets a module of its own, which is handed to the
+// JIT; otherwise it's generated into the current module.  Returns false if IR
+// generation failed, in which case the function is forgotten.
+bool LLVMBackend::generatePendingFunction(const std::string & name)
+{
+	auto it = PendingFunctions.find(name);
+	std::shared_ptr<FunctionDefinitionAST> func = it->second;
+	PendingFunctions.erase(it);
+
+	// Generating the body may reference more pending functions, which are
+	// generated recursively.
+	IRBuilderBase::InsertPointGuard guard(Builder);
+	std::unique_ptr<Module> saved_mod;
+	if (Incremental) {
+		saved_mod = std::move(Mod);
+		startModule();
+	}
+
+	bool ok = createFunction(*func) != nullptr &&
+		  generateFunctionBodyCode(*func) != nullptr;
+	if (Incremental) {
+		ok = ok && addModuleToJIT(true);
+		Mod = std::move(saved_mod);
+	}
+
+	if (!ok)
+		DefinedFunctions.erase(name);
+	return ok;
+}
+
 namespace garter {
 
 // StatementAST and ExpressionAST visitor for LLVM IR generation
@@ -134,9 +367,16 @@ private:
 	BasicBlock * BreakTarget;
 	BasicBlock * ContinueTarget;
 
+	// Loop metadata to attach to branches back to ContinueTarget (nullptr
+	// if not in loop or if the loop has no optimization hints)
+	MDNode * LoopID;
+
 	Value *isZeroOrNotZero(Value *val, bool is_zero);
 	Value *isZero(Value *val);
 	Value *isNotZero(Value *val);
+	Value *shiftAmount(Value *amount);
+	bool generateBuiltinCall(CallExpressionAST & expr);
+	MDNode *generateLoopID(const WhileStatementAST::LoopHints & hints);
 public:
 	LLVMCodeGeneratorVisitor(LLVMBackend & backend, Function * f,
 				 std::map<std::string, Value*> & named_values,
@@ -144,7 +384,8 @@ public:
 		: Backend(backend), CurrentFunction(f),
 		  AtTopLevel(toplevel), NamedValues(named_values),
 		  ExpressionValue(nullptr), StatementSuccessful(false),
-		  BreakTarget(nullptr), ContinueTarget(nullptr)
+		  BreakTarget(nullptr), ContinueTarget(nullptr),
+		  LoopID(nullptr)
 	{ }
 
 	void visit(AssignmentStatementAST &);
@@ -202,6 +443,16 @@ Value *LLVMCodeGeneratorVisitor::isZeroOrNotZero(Value *val, bool is_zero)
 	return phi;
 }
 
+// Given a LLVM IR integer value @amount used as the right-hand side of a shift,
+// return it reduced modulo 32.  Shifting by 32 or more bits is undefined in
+// LLVM IR, whereas in garter only the low 5 bits of the shift amount are
+// significant.  This matches what the x86 shift instructions do in hardware,
+// so the mask normally disappears during instruction selection.
+Value *LLVMCodeGeneratorVisitor::shiftAmount(Value *amount)
+{
+	return Backend.Builder.CreateAnd(amount, Backend.Builder.getInt32(31));
+}
+
 Value *LLVMCodeGeneratorVisitor::isNotZero(Value *val)
 {
 	return isZeroOrNotZero(val, false);
@@ -264,6 +515,26 @@ void LLVMCodeGeneratorVisitor::visit(BinaryExpressionAST & expr)
 		ExpressionValue = Backend.Builder.CreateICmpNE(lhs_value,
 							       rhs_value);
 		break;
+	case BinaryExpressionAST::BitwiseOr:
+		ExpressionValue = Backend.Builder.CreateOr(lhs_value,
+							   rhs_value);
+		break;
+	case BinaryExpressionAST::BitwiseXor:
+		ExpressionValue = Backend.Builder.CreateXor(lhs_value,
+							    rhs_value);
+		break;
+	case BinaryExpressionAST::BitwiseAnd:
+		ExpressionValue = Backend.Builder.CreateAnd(lhs_value,
+							    rhs_value);
+		break;
+	case BinaryExpressionAST::LeftShift:
+		ExpressionValue = Backend.Builder.CreateShl(lhs_value,
+							    shiftAmount(rhs_value));
+		break;
+	case BinaryExpressionAST::RightShift:
+		ExpressionValue = Backend.Builder.CreateAShr(lhs_value,
+							     shiftAmount(rhs_value));
+		break;
 	case BinaryExpressionAST::Add:
 		ExpressionValue = Backend.Builder.CreateAdd(lhs_value,
 							    rhs_value);
@@ -290,13 +561,13 @@ void LLVMCodeGeneratorVisitor::visit(BinaryExpressionAST & expr)
 			FunctionType *exp_type =
 				FunctionType::get(Backend.Int32Ty, param_types,
 						  false);
-			Constant * exp =
+			FunctionCallee exp =
 				Backend.Mod->getOrInsertFunction("__garter_exponentiate",
 								exp_type);
 
-			ExpressionValue = Backend.Builder.CreateCall2(exp,
-								      lhs_value,
-								      rhs_value);
+			ExpressionValue = Backend.Builder.CreateCall(exp,
+								     {lhs_value,
+								      rhs_value});
 		}
 		break;
 	case BinaryExpressionAST::In:
@@ -333,7 +604,9 @@ void LLVMCodeGeneratorVisitor::visit(ContinueStatementAST & expr __attribute__((
 		std::cerr << "ERROR: continue statement not in loop" << std::endl;
 		StatementSuccessful = false;
 	} else {
-		Backend.Builder.CreateBr(ContinueTarget);
+		BranchInst *br = Backend.Builder.CreateBr(ContinueTarget);
+		if (LoopID != nullptr)
+			br->setMetadata("llvm.loop", LoopID);
 
 		BasicBlock *deadcode = BasicBlock::Create(Backend.Ctx,
 							  "", CurrentFunction);
@@ -342,12 +615,66 @@ void LLVMCodeGeneratorVisitor::visit(ContinueStatementAST & expr __attribute__((
 	}
 }
 
+// Builtin functions that map directly onto LLVM intrinsics.  Each takes one
+// argument.
+static const struct {
+	const char *Name;
+	Intrinsic::ID ID;
+	bool HasZeroUndefFlag;
+} Builtins[] = {
+	{"popcount", Intrinsic::ctpop, false},
+	{"clz",      Intrinsic::ctlz,  true},
+	{"ctz",      Intrinsic::cttz,  true},
+	{"bswap",    Intrinsic::bswap, false},
+};
+
+// If the call expression @expr names a builtin function, generate LLVM IR in the
+// current function for calling the corresponding intrinsic and return true,
+// with the resulting value (or nullptr on error) in this->ExpressionValue.
+// Otherwise return false.
+bool LLVMCodeGeneratorVisitor::generateBuiltinCall(CallExpressionAST & expr)
+{
+	for (const auto & builtin : Builtins) {
+		if (expr.Callee != builtin.Name)
+			continue;
+
+		ExpressionValue = nullptr;
+		if (expr.Arguments.size() != 1) {
+			std::cerr << "ERROR: Wrong number of arguments to "
+				  << expr.Callee << std::endl;
+			return true;
+		}
+
+		expr.Arguments[0]->acceptVisitor(*this);
+		if (ExpressionValue == nullptr)
+			return true;
+
+		Function *intrinsic = Intrinsic::getDeclaration(Backend.Mod.get(),
+								builtin.ID,
+								Backend.Int32Ty);
+		std::vector<Value*> args;
+		args.push_back(ExpressionValue);
+
+		// clz(0) and ctz(0) are defined to be 32 rather than undefined.
+		if (builtin.HasZeroUndefFlag)
+			args.push_back(Backend.Builder.getInt1(false));
+
+		ExpressionValue = Backend.Builder.CreateCall(intrinsic, args);
+		return true;
+	}
+	return false;
+}
+
 // Generate LLVM IR in the current function for a function call.  The resulting
 // pointer to the llvm::Value representing the return value of the called
 // function is returned in this->ExpressionValue.
 void LLVMCodeGeneratorVisitor::visit(CallExpressionAST & expr)
 {
-	Function *callee = Backend.Mod->getFunction(expr.Callee);
+	Function *callee = Backend.getFunction(expr.Callee);
+
+	// Functions not defined by the program may name a builtin
+	if (callee == nullptr && generateBuiltinCall(expr))
+		return;
 
 	// Make sure the called function is actually declared
 	if (callee == nullptr) {
@@ -402,6 +729,9 @@ void LLVMCodeGeneratorVisitor::visit(UnaryExpressionAST & expr)
 	case UnaryExpressionAST::Plus:
 		// Unary plus does nothing
 		return;
+	case UnaryExpressionAST::BitwiseNot:
+		ExpressionValue = Backend.Builder.CreateNot(ExpressionValue);
+		break;
 	case UnaryExpressionAST::Not:
 		// unary not:  0 -> 1, nonzero -> 0
 		ExpressionValue =
@@ -413,21 +743,21 @@ void LLVMCodeGeneratorVisitor::visit(UnaryExpressionAST & expr)
 
 // Generate LLVM IR in the current function for a variable expression.  The
 // resulting pointer to the llvm::Value representing the variable is returned in
-// this->ExpressionValue.
+// this->ExpressionValue.  References to constants become immediate operands
+// (and this->ExpressionPointer is set to nullptr).
 void LLVMCodeGeneratorVisitor::visit(VariableExpressionAST & expr)
 {
 	Value *var_ptr, *var_value;
+
+	auto const_it = Backend.Constants.find(expr.Name);
+	if (const_it != Backend.Constants.end()) {
+		ExpressionValue = Backend.Builder.getInt32(const_it->second);
+		ExpressionPointer = nullptr;
+		return;
+	}
+
 	if (AtTopLevel) {
-		var_ptr = Backend.Mod->getGlobalVariable(expr.Name, true);
-		Constant *zero = Backend.Builder.getInt32(0);
-		if (var_ptr == nullptr) {
-			var_ptr = new GlobalVariable(*Backend.Mod,
-						     Backend.Int32Ty,
-						     false,
-						     GlobalValue::InternalLinkage,
-						     zero,
-						     expr.Name);
-		}
+		var_ptr = Backend.getVariable(expr.Name);
 		assert(var_ptr != nullptr);
 	} else {
 		var_ptr = NamedValues[expr.Name];
@@ -444,7 +774,7 @@ void LLVMCodeGeneratorVisitor::visit(VariableExpressionAST & expr)
 		var_value = zero;
 	} else {
 		// Variable already existed in the current function.
-		var_value = Backend.Builder.CreateLoad(var_ptr);
+		var_value = Backend.Builder.CreateLoad(Backend.Int32Ty, var_ptr);
 	}
 	ExpressionValue = var_value;
 	ExpressionPointer = var_ptr;
@@ -455,6 +785,12 @@ void LLVMCodeGeneratorVisitor::visit(AssignmentStatementAST & stmt)
 {
 	StatementSuccessful = false;
 
+	if (Backend.Constants.count(stmt.Variable->Name)) {
+		std::cerr << "ERROR: Cannot assign to constant "
+			  << stmt.Variable->Name << std::endl;
+		return;
+	}
+
 	stmt.Variable->acceptVisitor(*this);
 	if (ExpressionValue == nullptr)
 		return;
@@ -559,8 +895,7 @@ void LLVMCodeGeneratorVisitor::visit(PrintStatementAST & stmt)
 
 	// Retrieve print function (in runtime library)
 	FunctionType *funcTy = FunctionType::get(Backend.Int32Ty, Backend.Int32Ty, true);
-	Constant *print = Backend.Mod->getOrInsertFunction("__garter_print", funcTy);
-	assert(print != nullptr);
+	FunctionCallee print = Backend.Mod->getOrInsertFunction("__garter_print", funcTy);
 
 	// Build a vector of llvm::Value pointers representing the function
 	// arguments.  Note that this may involve recursive IR generation for
@@ -595,6 +930,73 @@ void LLVMCodeGeneratorVisitor::visit(ReturnStatementAST & stmt)
 	StatementSuccessful = true;
 }
 
+// Build the 'llvm.loop' metadata node that conveys a loop's optimization hints
+// to the loop unroller and vectorizer.  Returns nullptr if there are no hints.
+MDNode *LLVMCodeGeneratorVisitor::generateLoopID(const WhileStatementAST::LoopHints & hints)
+{
+	std::vector<Metadata*> args;
+	std::vector<Metadata*> unroll_hints;
+
+	if (hints.empty())
+		return nullptr;
+
+	// The first operand is reserved for a self-reference, which makes the
+	// loop ID distinct from that of any other loop.
+	args.push_back(nullptr);
+
+	auto make_hint = [&](const char *name, Constant *value) {
+		std::vector<Metadata*> hint;
+		hint.push_back(MDString::get(Backend.Ctx, name));
+		if (value != nullptr)
+			hint.push_back(ConstantAsMetadata::get(value));
+		return MDNode::get(Backend.Ctx, hint);
+	};
+
+	if (hints.Unroll) {
+		if (hints.UnrollCount != 0)
+			unroll_hints.push_back(make_hint("llvm.loop.unroll.count",
+							 Backend.Builder.getInt32(hints.UnrollCount)));
+		else
+			unroll_hints.push_back(make_hint("llvm.loop.unroll.enable", nullptr));
+	}
+	if (hints.NoUnroll)
+		args.push_back(make_hint("llvm.loop.unroll.disable", nullptr));
+	if (hints.Vectorize) {
+		args.push_back(make_hint("llvm.loop.vectorize.enable",
+					 Backend.Builder.getTrue()));
+		if (hints.VectorizeWidth != 0)
+			args.push_back(make_hint("llvm.loop.vectorize.width",
+						 Backend.Builder.getInt32(hints.VectorizeWidth)));
+	}
+	if (hints.NoVectorize)
+		args.push_back(make_hint("llvm.loop.vectorize.enable",
+					 Backend.Builder.getFalse()));
+
+	// A loop that is to be both vectorized and unrolled is unrolled after
+	// being vectorized, as with clang.  Otherwise, if the number of
+	// iterations isn't known, the loop is unrolled with a remainder loop
+	// before the vectorizer runs, and it's the remainder that ends up
+	// carrying the vectorization hints.  Without an unroll factor, the
+	// vectorized loop is left to the vectorizer's interleaving, as the
+	// unroller won't pick a factor for a body that large when the number
+	// of iterations isn't known.
+	if (!hints.Vectorize) {
+		args.insert(args.end(), unroll_hints.begin(), unroll_hints.end());
+	} else if (hints.UnrollCount != 0) {
+		std::vector<Metadata*> followup;
+		followup.push_back(MDString::get(Backend.Ctx,
+				   "llvm.loop.vectorize.followup_vectorized"));
+		followup.push_back(make_hint("llvm.loop.isvectorized", nullptr));
+		followup.insert(followup.end(), unroll_hints.begin(),
+				unroll_hints.end());
+		args.push_back(MDNode::get(Backend.Ctx, followup));
+	}
+
+	MDNode *loop_id = MDNode::getDistinct(Backend.Ctx, args);
+	loop_id->replaceOperandWith(0, loop_id);
+	return loop_id;
+}
+
 // Generate LLVM IR in the current function for a while statement.
 void LLVMCodeGeneratorVisitor::visit(WhileStatementAST & stmt)
 {
@@ -602,6 +1004,10 @@ void LLVMCodeGeneratorVisitor::visit(WhileStatementAST & stmt)
 
 	BasicBlock * break_target_save = BreakTarget;
 	BasicBlock * continue_target_save = ContinueTarget;
+	MDNode * loop_id_save = LoopID;
+
+	// Metadata attached to the loop's back edges
+	LoopID = generateLoopID(stmt.Hints);
 
 	// Basic block for testing while loop condition
 	BasicBlock *condbb = BasicBlock::Create(Backend.Ctx, "", CurrentFunction);
@@ -637,7 +1043,11 @@ void LLVMCodeGeneratorVisitor::visit(WhileStatementAST & stmt)
 			goto out;
 	}
 	// At end of body, jump to condition test
-	Backend.Builder.CreateBr(condbb);
+	{
+		BranchInst *br = Backend.Builder.CreateBr(condbb);
+		if (LoopID != nullptr)
+			br->setMetadata("llvm.loop", LoopID);
+	}
 
 	// Finally, set the insertion point to the basic block after the while
 	// statement.
@@ -648,6 +1058,7 @@ void LLVMCodeGeneratorVisitor::visit(WhileStatementAST & stmt)
 out:
 	BreakTarget = break_target_save;
 	ContinueTarget = continue_target_save;
+	LoopID = loop_id_save;
 }
 
 // Generate LLVM IR for a function body.
@@ -675,8 +1086,15 @@ Function *LLVMBackend::generateFunctionBodyCode(const FunctionDefinitionAST & fu
 		for (Function::arg_iterator argptr = f->arg_begin();
 		     argptr != f->arg_end(); i++, argptr++)
 		{
+			if (Constants.count(func.Parameters[i])) {
+				std::cerr << "ERROR: Parameter " << func.Parameters[i]
+					  << " of " << func.Name
+					  << " has the same name as a constant"
+					  << std::endl;
+				return nullptr;
+			}
 			AllocaInst *a = Builder.CreateAlloca(Int32Ty, 0, func.Parameters[i]);
-			Builder.CreateStore(argptr, a);
+			Builder.CreateStore(&*argptr, a);
 			named_values[func.Parameters[i]] = a;
 		}
 	}
@@ -690,21 +1108,45 @@ Function *LLVMBackend::generateFunctionBodyCode(const FunctionDefinitionAST & fu
 	}
 	Builder.CreateRet(Builder.getInt32(0));
 
-	assert (llvm::verifyFunction (*f));
+	assert(!llvm::verifyFunction(*f, &errs()));
 
 	return f;
 }
 
+bool LLVMBackend::defineConstant(const ConstantDefinitionAST & constdef)
+{
+	return garter::defineConstant(Constants, constdef,
+				      DefinedVariables.count(constdef.Name));
+}
+
 bool LLVMBackend::generateProgramIR(const ProgramAST & program)
 {
-	// Generate prototypes for all functions
+	// Compute the values of all constants, which are visible in all
+	// functions
+	for (auto itemptr : program.TopLevelItems) {
+		auto constdef = std::dynamic_pointer_cast<ConstantDefinitionAST>(itemptr);
+		if (constdef == nullptr)
+			continue;
+
+		if (!defineConstant(*constdef))
+			return false;
+	}
+
+	// Generate prototypes for all functions.  With lazy IR generation,
+	// functions are only registered, and their IR is generated when they
+	// are first referenced.
 	for (auto itemptr : program.TopLevelItems) {
 		auto func = std::dynamic_pointer_cast<FunctionDefinitionAST>(itemptr);
 		if (func == nullptr)
 			continue;
 
-		if (nullptr == generateFunctionPrototype(*func))
+		if (Options.LazyIRGeneration) {
+			if (!registerFunction(*func))
+				return false;
+			PendingFunctions[func->Name] = func;
+		} else if (nullptr == generateFunctionPrototype(*func)) {
 			return false;
+		}
 	}
 
 	// Treat toplevel statements as anonymous function
@@ -725,7 +1167,7 @@ bool LLVMBackend::generateProgramIR(const ProgramAST & program)
 	// containing the toplevel statements
 	for (auto itemptr : program.TopLevelItems) {
 		auto func = std::dynamic_pointer_cast<FunctionDefinitionAST>(itemptr);
-		if (func == nullptr)
+		if (func == nullptr || Options.LazyIRGeneration)
 			continue;
 
 		if (nullptr == generateFunctionBodyCode(*func))
@@ -737,120 +1179,1415 @@ bool LLVMBackend::generateProgramIR(const ProgramAST & program)
 	return true;
 }
 
+// Run the IR optimization pipeline for the given optimization level over
+// @mod.  @mach, if not nullptr, provides target information to the passes.
+void LLVMBackend::runOptimizationPipeline(Module & mod, unsigned opt_level,
+					  TargetMachine *mach)
+{
+	LoopAnalysisManager lam;
+	FunctionAnalysisManager fam;
+	CGSCCAnalysisManager cgam;
+	ModuleAnalysisManager mam;
+
+	// As with clang, loops and straight-line code are vectorized
+	// automatically at -O2 and above.
+	PipelineTuningOptions tuning;
+	tuning.LoopVectorization = opt_level >= 2;
+	tuning.LoopInterleaving = opt_level >= 2;
+	tuning.SLPVectorization = opt_level >= 2;
+	// Functions marked optnone are only skipped by the passes if the pass
+	// managers are told to.
+	PassInstrumentationCallbacks callbacks;
+	OptNoneInstrumentation optnone(false);
+	optnone.registerCallbacks(callbacks);
+	PassBuilder builder(mach, tuning, None, &callbacks);
+
+	builder.registerModuleAnalyses(mam);
+	builder.registerCGSCCAnalyses(cgam);
+	builder.registerFunctionAnalyses(fam);
+	builder.registerLoopAnalyses(lam);
+	builder.crossRegisterProxies(lam, fam, cgam, mam);
+
+	// Functions are specialized on constant arguments once their
+	// parameters have been promoted out of memory, leaving the rest of the
+	// pipeline to simplify and inline the clones.
+	if (opt_level >= 2 && Options.SpecializeMaxGrowth != 0) {
+		builder.registerPipelineEarlySimplificationEPCallback(
+			[&](ModulePassManager & mpm, OptimizationLevel) {
+				mpm.addPass(FunctionSpecializationPass(
+						Options.SpecializeSizeLimit,
+						Options.SpecializeMaxGrowth,
+						&SpecStats));
+			});
+	}
+
+	// The hints of loops annotated with @vectorize or @unroll are honored at
+	// -O1 and above, even though at -O1 the vectorizer otherwise leaves
+	// loops alone.  The -O0 pipeline runs neither pass, so there the hints
+	// are ignored.
+	ModulePassManager mpm;
+	switch (opt_level) {
+	case 0:
+		mpm = builder.buildO0DefaultPipeline(OptimizationLevel::O0);
+		break;
+	case 1:
+		mpm = builder.buildPerModuleDefaultPipeline(OptimizationLevel::O1);
+		break;
+	case 2:
+		mpm = builder.buildPerModuleDefaultPipeline(OptimizationLevel::O2);
+		break;
+	default:
+		mpm = builder.buildPerModuleDefaultPipeline(OptimizationLevel::O3);
+		break;
+	}
+	mpm.run(mod, mam);
+}
+
+// Return the optimization level at which the function @f is to be optimized.
+// Functions annotated with @opt(0) are marked optnone, which the passes at any
+// level respect, so they are treated as having the default level.
+unsigned LLVMBackend::getFunctionOptLevel(const Function & f) const
+{
+	auto it = FunctionOptLevels.find(f.getName().str());
+	if (it == FunctionOptLevels.end())
+		return Options.OptLevel;
+	return it->second;
+}
+
+// Run the IR optimization passes over the module.
+//
+// If some functions were annotated with an optimization level different from
+// the default, the module is split into one copy per optimization level.  In
+// each copy, the bodies of the functions belonging to other levels are
+// deleted, leaving only declarations, except for those of functions annotated
+// with @inline.  Each copy is optimized at its own
+// level, then the copies are linked back together.
+bool LLVMBackend::optimizeModule(TargetMachine *mach)
+{
+	std::set<unsigned> levels;
+	levels.insert(Options.OptLevel);
+	for (const Function & f : *Mod)
+		if (!f.isDeclaration())
+			levels.insert(getFunctionOptLevel(f));
+
+	if (levels.size() == 1) {
+		runOptimizationPipeline(*Mod, Options.OptLevel, mach);
+		return true;
+	}
+
+	// Functions and variables in one copy may be referenced from another,
+	// so temporarily give all of them external (but hidden) linkage.
+	std::vector<std::string> local_names;
+	for (Function & f : *Mod) {
+		if (f.hasLocalLinkage()) {
+			local_names.push_back(f.getName().str());
+			f.setLinkage(GlobalValue::ExternalLinkage);
+			f.setVisibility(GlobalValue::HiddenVisibility);
+		}
+	}
+	for (GlobalVariable & var : Mod->globals()) {
+		if (var.hasLocalLinkage()) {
+			local_names.push_back(var.getName().str());
+			var.setLinkage(GlobalValue::ExternalLinkage);
+			var.setVisibility(GlobalValue::HiddenVisibility);
+		}
+	}
+
+	std::unique_ptr<Module> combined;
+	for (unsigned level : levels) {
+		std::unique_ptr<Module> part = CloneModule(*Mod);
+
+		// Functions that must be inlined keep their bodies, so that
+		// they're still inlined into callers of other levels, but are
+		// only emitted by their own copy.
+		for (Function & f : *part) {
+			if (f.isDeclaration() || getFunctionOptLevel(f) == level)
+				continue;
+			if (f.hasFnAttribute(Attribute::AlwaysInline))
+				f.setLinkage(GlobalValue::AvailableExternallyLinkage);
+			else
+				f.deleteBody();
+		}
+
+		// Variables are defined in the copy containing 'main', which
+		// has the default optimization level.
+		if (level != Options.OptLevel) {
+			for (GlobalVariable & var : part->globals()) {
+				if (!var.isDeclaration()) {
+					var.setInitializer(nullptr);
+					var.setLinkage(GlobalValue::ExternalLinkage);
+				}
+			}
+		}
+
+		runOptimizationPipeline(*part, level, mach);
+
+		if (combined == nullptr) {
+			combined = std::move(part);
+		} else if (Linker::linkModules(*combined, std::move(part))) {
+			std::cerr << "ERROR: couldn't link optimized modules" << std::endl;
+			return false;
+		}
+	}
+
+	// Restore the original linkage
+	for (const std::string & name : local_names) {
+		GlobalValue *value = combined->getNamedValue(name);
+		if (value != nullptr && !value->isDeclaration()) {
+			value->setLinkage(GlobalValue::InternalLinkage);
+			value->setVisibility(GlobalValue::DefaultVisibility);
+		}
+	}
+
+	Mod = std::move(combined);
+	return true;
+}
+
+static uint64_t nanosecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+}
+
+// The host's target triple, CPU, CPU features and registered Target.  These
+// are looked up, and the targets initialized, only once per process, even when
+// several LLVMBackends compile programs at the same time.
+struct HostTarget {
+	std::string Triple;
+	std::string CPU;
+	std::vector<std::string> Features;
+	const Target *TheTarget;
+	std::string Error;
+};
+
+static const HostTarget & getHostTarget()
+{
+	static const HostTarget host = []() {
+		HostTarget host;
+
+		llvm::InitializeAllTargets();
+		llvm::InitializeAllTargetMCs();
+		llvm::InitializeAllAsmPrinters();
+
+		host.Triple = sys::getDefaultTargetTriple();
+		host.CPU = sys::getHostCPUName().str();
+
+		// The CPU name alone doesn't tell which features are
+		// enabled: for example, AVX is unusable if the OS doesn't
+		// save the AVX registers.
+		StringMap<bool> features;
+		if (sys::getHostCPUFeatures(features)) {
+			for (const auto & feature : features)
+				host.Features.push_back(
+					(feature.second ? "+" : "-") +
+					feature.first().str());
+			std::sort(host.Features.begin(), host.Features.end());
+		}
+		host.TheTarget = TargetRegistry::lookupTarget(host.Triple,
+							      host.Error);
+		return host;
+	}();
+	return host;
+}
+
+void garter::getTargetCPUAndFeatures(const LLVMBackendOptions & options,
+				     std::string & cpu, std::string & features)
+{
+	const HostTarget & host = getHostTarget();
+	SubtargetFeatures subtarget_features;
+
+	if (options.TargetCPU == "native") {
+		cpu = host.CPU;
+		for (const std::string & feature : host.Features)
+			subtarget_features.AddFeature(feature);
+	} else {
+		cpu = options.TargetCPU;
+	}
+
+	SmallVector<StringRef, 8> extra_features;
+	StringRef(options.TargetFeatures).split(extra_features, ',', -1, false);
+	for (StringRef feature : extra_features)
+		subtarget_features.AddFeature(feature.trim());
+
+	features = subtarget_features.getString();
+}
+
+// Return the code generator's optimization level for -O@opt_level
+static CodeGenOpt::Level getCodeGenOptLevel(unsigned opt_level)
+{
+	static const CodeGenOpt::Level codegen_levels[] = {
+		CodeGenOpt::None, CodeGenOpt::Less,
+		CodeGenOpt::Default, CodeGenOpt::Aggressive,
+	};
+	return codegen_levels[std::min(opt_level, 3U)];
+}
+
+// Create a TargetMachine generating code for the host's target triple, and the
+// CPU and features chosen in @options.  The code is position-independent,
+// since the linker produces position-independent executables by default, and
+// the code generator optimizes as much as the IR optimizer (-O in @options).
+// Returns nullptr after printing an error message on failure.
+static std::unique_ptr<TargetMachine>
+createHostTargetMachine(const LLVMBackendOptions & options)
+{
+	const HostTarget & host = getHostTarget();
+
+	if (host.TheTarget == nullptr) {
+		std::cerr << "ERROR: " << host.Error << std::endl;
+		return nullptr;
+	}
+
+	std::string cpu, features;
+	getTargetCPUAndFeatures(options, cpu, features);
+
+	// LLVM would only warn about an unknown CPU, then ignore it.
+	std::unique_ptr<MCSubtargetInfo> sti(
+		host.TheTarget->createMCSubtargetInfo(host.Triple, "", ""));
+	if (sti != nullptr && !sti->isCPUStringValid(cpu)) {
+		std::cerr << "ERROR: unknown CPU '" << cpu << "' for target "
+			  << host.Triple << std::endl;
+		return nullptr;
+	}
+
+	std::unique_ptr<TargetMachine> mach(
+		host.TheTarget->createTargetMachine(host.Triple, cpu, features,
+						    TargetOptions(), Reloc::PIC_,
+						    None,
+						    getCodeGenOptLevel(options.OptLevel)));
+	if (mach == nullptr)
+		std::cerr << "ERROR: couldn't create TargetMachine" << std::endl;
+	return mach;
+}
+
+// Generate the machine code for @mod into @os as an object file
+static bool emitObjectFile(Module & mod, TargetMachine & mach,
+			   raw_pwrite_stream & os)
+{
+	legacy::PassManager mgr;
+
+	if (mach.addPassesToEmitFile(mgr, os, nullptr, CGFT_ObjectFile)) {
+		std::cerr << "ERROR: couldn't add passes "
+			"to create object file" << std::endl;
+		return false;
+	}
+	mgr.run(mod);
+	return true;
+}
+
 bool LLVMBackend::compileProgram(const ProgramAST & program,
-				 const char *out_filename, bool obj_output)
+				 const char *out_filename, OutputKind kind)
 {
-	std::string err_str;
-	std::string triple;
-	std::string cpu;
-	std::string features;
-	TargetOptions options;
-	const Target *target;
+	auto start = std::chrono::steady_clock::now();
+	if (!generateProgramIR(program))
+		return false;
+
+	// Profiles are matched with the unoptimized IR.  With link-time
+	// optimization, the profile data is in the bitcode.
+	if (!Options.ProfileUse.empty()) {
+		ProfileData profile;
+		if (!profile.read(Options.ProfileUse))
+			return false;
+		profile.annotate(*Mod, Options.SourceFileName);
+	}
+	if (Options.ProfileGenerate)
+		instrumentForProfiling(*Mod, Options.SourceFileName);
+
+	return compileModule(out_filename, kind, "IR generation",
+			     nanosecondsSince(start));
+}
+
+// Optimize Mod, except when creating bitcode to be optimized at link time, and
+// write it to @out_filename in the form @kind.  @first_phase names the phase
+// that created Mod and @first_phase_time is the time it took, which are
+// reported with the times of the other phases if Options.ReportCompileTime is
+// set.
+bool LLVMBackend::compileModule(const char *out_filename, OutputKind kind,
+				const char *first_phase,
+				uint64_t first_phase_time)
+{
+	std::error_code ec;
 	std::unique_ptr<TargetMachine> mach;
-	PassManager mgr;
 
-	if (!generateProgramIR(program))
+	ToolOutputFile os(out_filename, ec,
+			  kind == OutputKind::LLVMIR ? sys::fs::OF_Text :
+						       sys::fs::OF_None);
+	if (ec) {
+		std::cerr << "ERROR: " << ec.message() << std::endl;
+		return false;
+	}
+
+	mach = createHostTargetMachine(Options);
+	if (mach == nullptr)
+		return false;
+
+	Mod->setTargetTriple(mach->getTargetTriple().str());
+	Mod->setDataLayout(mach->createDataLayout());
+
+	auto start = std::chrono::steady_clock::now();
+	if (kind != OutputKind::Bitcode && !optimizeModule(mach.get()))
+		return false;
+	const uint64_t optimize_time = nanosecondsSince(start);
+
+	if (Options.ReportSpecializations && kind != OutputKind::Bitcode) {
+		for (const std::string & spec : SpecStats.Specializations)
+			std::cerr << "specialized " << spec << std::endl;
+		std::cerr << SpecStats.Specializations.size()
+			  << " specializations created, "
+			  << SpecStats.CallsRedirected << " calls redirected, "
+			  << SpecStats.InstructionsAdded << " instructions added"
+			  << std::endl;
+	}
+
+	if (Options.ReportVectorization && kind != OutputKind::Bitcode) {
+		for (const std::string & loop : VecStats.Loops)
+			std::cerr << "vectorized " << loop << std::endl;
+		std::cerr << VecStats.Loops.size() << " loops vectorized";
+		if (!VecStats.LoopsByWidth.empty()) {
+			const char *sep = " (";
+			for (const auto & entry : VecStats.LoopsByWidth) {
+				std::cerr << sep << entry.second << " with width "
+					  << entry.first;
+				sep = ", ";
+			}
+			std::cerr << ")";
+		}
+		std::cerr << ", " << VecStats.SLPVectorized
+			  << " straight-line code sequences SLP vectorized"
+			  << std::endl;
+	}
+
+	unsigned num_parts = 1;
+	if (kind == OutputKind::ObjectFile) {
+		unsigned num_functions = 0;
+		for (const Function & f : *Mod)
+			if (!f.isDeclaration())
+				num_functions++;
+		num_parts = std::min(Options.CompileJobs, num_functions);
+		if (num_parts > 1 && !canGenerateCodeInParallel(Options))
+			num_parts = 1;
+	}
+
+	start = std::chrono::steady_clock::now();
+	if (num_parts > 1) {
+		os.os().close();
+		if (!emitObjectFileInParallel(out_filename, num_parts))
+			return false;
+	} else if (kind == OutputKind::ObjectFile) {
+		if (!emitObjectFile(*Mod, *mach, os.os()))
+			return false;
+	} else if (kind == OutputKind::Bitcode) {
+		WriteBitcodeToFile(*Mod, os.os());
+	} else {
+		Mod->print(os.os(), nullptr);
+	}
+
+	if (Options.ReportCompileTime) {
+		std::cerr << std::fixed << std::setprecision(3)
+			  << "program: " << first_phase << " "
+			  << first_phase_time / 1e6
+			  << " ms, optimization " << optimize_time / 1e6
+			  << " ms, code generation "
+			  << nanosecondsSince(start) / 1e6 << " ms";
+		if (num_parts > 1)
+			std::cerr << " (" << num_parts << " partitions)";
+		std::cerr << std::endl;
+	}
+
+	os.keep();
+	return true;
+}
+
+bool LLVMBackend::linkBitcodeFiles(const std::vector<std::string> & files,
+				   bool internalize, const char *out_filename)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	for (const std::string & file : files) {
+		ErrorOr<std::unique_ptr<MemoryBuffer>> buffer =
+			MemoryBuffer::getFile(file);
+		if (!buffer) {
+			std::cerr << "ERROR: can't read " << file << ": "
+				  << buffer.getError().message() << std::endl;
+			return false;
+		}
+		Expected<std::unique_ptr<Module>> mod =
+			parseBitcodeFile(**buffer, Ctx);
+		if (!mod) {
+			std::cerr << "ERROR: " << file << ": "
+				  << toString(mod.takeError()) << std::endl;
+			return false;
+		}
+		if (Linker::linkModules(*Mod, std::move(*mod))) {
+			std::cerr << "ERROR: couldn't link " << file << std::endl;
+			return false;
+		}
+	}
+
+	// With nothing but 'main' visible outside the program, functions that
+	// are inlined everywhere, such as runtime functions, can be deleted.
+	if (internalize) {
+		internalizeModule(*Mod, [](const GlobalValue & value) {
+			return value.getName() == "main";
+		});
+	}
+
+	// Recover the levels of functions annotated with @opt(N)
+	for (const Function & f : *Mod) {
+		if (f.hasFnAttribute("garter-opt-level")) {
+			FunctionOptLevels[f.getName().str()] = std::stoi(
+				f.getFnAttribute("garter-opt-level")
+				 .getValueAsString().str());
+		}
+	}
+
+	return compileModule(out_filename, OutputKind::ObjectFile,
+			     "linking", nanosecondsSince(start));
+}
+
+bool garter::canGenerateCodeInParallel(const LLVMBackendOptions & options)
+{
+	return !options.Linker.empty() &&
+	       sys::fs::can_execute(options.Linker) &&
+	       sys::findProgramByName("objcopy");
+}
+
+// Run the program @path with the arguments @args, returning false after
+// printing an error message if it doesn't succeed
+static bool runTool(StringRef path, std::vector<StringRef> args)
+{
+	std::string err_str;
+	args.insert(args.begin(), path);
+	int ret = sys::ExecuteAndWait(path, args, None, {}, 0, 0, &err_str);
+	if (ret != 0) {
+		std::cerr << "ERROR: " << path.str() << " failed";
+		if (!err_str.empty())
+			std::cerr << ": " << err_str;
+		std::cerr << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Generate the machine code for the optimized Mod into the object file
+// @out_filename on Options.CompileJobs threads.
+//
+// The module is split into @num_parts partitions with about the same number of
+// instructions, with the functions and variables that have internal linkage
+// given hidden external linkage so that they can be referenced from other
+// partitions.  Each partition is compiled on a thread of its own, in an
+// LLVMContext of its own.  The partitions' object files are then combined with
+// a relocatable link by Options.Linker, after which objcopy makes the hidden
+// symbols local again, so that they can't clash with the symbols of other
+// object files.
+//
+// Only code generation is done in parallel: the optimization passes still see
+// the whole program, so that they can inline functions into callers in any
+// partition and delete the functions that are no longer called.
+bool LLVMBackend::emitObjectFileInParallel(const char *out_filename,
+					   unsigned num_parts)
+{
+	// Modules can't be moved between contexts, so the partitions are
+	// passed to the threads as bitcode.
+	std::vector<SmallVector<char, 0>> bitcode;
+	SplitModule(*Mod, num_parts, [&](std::unique_ptr<Module> part) {
+		bitcode.emplace_back();
+		raw_svector_ostream os(bitcode.back());
+		WriteBitcodeToFile(*part, os);
+	});
+
+	std::vector<SmallVector<char, 0>> objects(bitcode.size());
+	std::atomic<bool> failed(false);
+	{
+		ThreadPool pool(hardware_concurrency(Options.CompileJobs));
+		for (size_t i = 0; i < bitcode.size(); i++) {
+			pool.async([&, i]() {
+				if (!emitPartition(bitcode[i], objects[i]))
+					failed = true;
+			});
+		}
+		pool.wait();
+	}
+	if (failed)
+		return false;
+
+	std::deque<FileRemover> removers;
+	std::vector<SmallString<128>> part_files(objects.size());
+	std::vector<StringRef> link_args = { "-r", "-o", out_filename };
+	for (size_t i = 0; i < objects.size(); i++) {
+		int fd;
+		std::error_code ec = sys::fs::createTemporaryFile("garter-part", "o",
+								  fd, part_files[i]);
+		if (ec) {
+			std::cerr << "ERROR: " << ec.message() << std::endl;
+			return false;
+		}
+		removers.emplace_back(part_files[i]);
+		raw_fd_ostream os(fd, true);
+		os.write(objects[i].data(), objects[i].size());
+		link_args.push_back(part_files[i]);
+	}
+
+	ErrorOr<std::string> objcopy = sys::findProgramByName("objcopy");
+	if (!objcopy) {
+		std::cerr << "ERROR: can't find objcopy" << std::endl;
 		return false;
+	}
+	return runTool(Options.Linker, link_args) &&
+	       runTool(*objcopy, { "--localize-hidden", out_filename });
+}
 
-	/* XXX: llvm::sys::fs::F_Binary flag should be used to open the output
-	 * file, but it was not available in LLVM version being tested.  */
-	tool_output_file os(out_filename, err_str);
-	if (err_str.length() != 0) {
-		std::cerr << "ERROR: " << err_str << std::endl;
+// Generate the machine code for one partition of a program, given as
+// @bitcode, and store the object file in @object.  This runs on a thread of
+// the pool started by emitObjectFileInParallel().
+bool LLVMBackend::emitPartition(const SmallVectorImpl<char> & bitcode,
+				SmallVectorImpl<char> & object)
+{
+	LLVMContext ctx;
+	Expected<std::unique_ptr<Module>> mod = parseBitcodeFile(
+		MemoryBufferRef(StringRef(bitcode.data(), bitcode.size()),
+				"partition"), ctx);
+	if (!mod) {
+		std::cerr << "ERROR: " << toString(mod.takeError()) << std::endl;
 		return false;
 	}
 
-	formatted_raw_ostream out(os.os());
+	std::unique_ptr<TargetMachine> mach = createHostTargetMachine(Options);
+	if (mach == nullptr)
+		return false;
 
-	llvm::InitializeAllTargets();
-	llvm::InitializeAllTargetMCs();
-	llvm::InitializeAllAsmPrinters();
+	raw_svector_ostream os(object);
+	return emitObjectFile(**mod, *mach, os);
+}
 
-	triple = sys::getDefaultTargetTriple();
-	cpu = sys::getHostCPUName();
+namespace {
 
-	target = TargetRegistry::lookupTarget(triple, err_str);
-	if (target == nullptr) {
-		std::cerr << "ERROR: " << err_str << std::endl;
+// Wrapper around the JIT's IR compiler that adds the time spent generating
+// machine code to a counter.
+class TimedIRCompiler : public orc::IRCompileLayer::IRCompiler {
+private:
+	std::unique_ptr<orc::IRCompileLayer::IRCompiler> Compiler;
+	std::atomic<uint64_t> & Time;
+public:
+	TimedIRCompiler(std::unique_ptr<orc::IRCompileLayer::IRCompiler> compiler,
+			std::atomic<uint64_t> & time)
+		: IRCompiler(compiler->getManglingOptions()),
+		  Compiler(std::move(compiler)), Time(time)
+	{
+	}
+
+	Expected<std::unique_ptr<MemoryBuffer>> operator()(Module & mod) override
+	{
+		auto start = std::chrono::steady_clock::now();
+		auto obj = (*Compiler)(mod);
+		Time += nanosecondsSince(start);
+		return obj;
+	}
+};
+
+} // End anonymous namespace
+
+// Create the JIT compiler used for executing top-level items and make the
+// runtime library available to the code it compiles.
+bool LLVMBackend::initializeJIT()
+{
+	llvm::InitializeNativeTarget();
+	llvm::InitializeNativeTargetAsmPrinter();
+
+	auto jtmb = orc::JITTargetMachineBuilder::detectHost();
+	if (!jtmb) {
+		std::cerr << "ERROR: " << toString(jtmb.takeError()) << std::endl;
 		return false;
 	}
+	jtmb->setCodeGenOptLevel(getCodeGenOptLevel(Options.OptLevel));
 
-	mach.reset(target->createTargetMachine(triple, cpu, features, options));
-	if (mach == nullptr) {
-		std::cerr << "ERROR: couldn't create TargetMachine" << std::endl;
+	// TargetMachine providing target information to the IR optimizer
+	auto mach = jtmb->createTargetMachine();
+	if (!mach) {
+		std::cerr << "ERROR: " << toString(mach.takeError()) << std::endl;
 		return false;
 	}
+	JITMachine = std::move(*mach);
 
-	PassManagerBuilder builder;
-	builder.OptLevel = 2;
-	builder.Inliner = llvm::createFunctionInliningPass();
-	builder.populateModulePassManager(mgr);
+	if (!Options.CacheDir.empty())
+		ObjCache.reset(new JITObjectCache(Options.CacheDir,
+						     Options.CacheSizeLimit));
 
-	if (obj_output) {
-		if (mach->addPassesToEmitFile(mgr, out,
-					      TargetMachine::CGFT_ObjectFile,
-					      false))
+	// With background compile threads, each compile needs a TargetMachine
+	// of its own.
+	auto create_compiler = [this](orc::JITTargetMachineBuilder jtmb)
+		-> Expected<std::unique_ptr<orc::IRCompileLayer::IRCompiler>>
+	{
+		std::unique_ptr<orc::IRCompileLayer::IRCompiler> compiler;
+		if (Options.JITCompileThreads != 0) {
+			compiler.reset(new orc::ConcurrentIRCompiler(std::move(jtmb),
+								     ObjCache.get()));
+		} else {
+			auto mach = jtmb.createTargetMachine();
+			if (!mach)
+				return mach.takeError();
+			compiler.reset(new orc::TMOwningSimpleCompiler(std::move(*mach),
+								       ObjCache.get()));
+		}
+		return std::unique_ptr<orc::IRCompileLayer::IRCompiler>(
+				new TimedIRCompiler(std::move(compiler), CodegenTime));
+	};
+
+	// Each object gets a memory manager of its own, so that removing it
+	// from the JIT releases its memory.
+	auto create_object_layer = [this](orc::ExecutionSession & es, const Triple &)
+		-> Expected<std::unique_ptr<orc::ObjectLayer>>
+	{
+		return std::unique_ptr<orc::ObjectLayer>(
+			new orc::RTDyldObjectLinkingLayer(es, [this]() {
+				return std::make_unique<SectionMemoryManager>(&MemMapper);
+			}));
+	};
+
+	auto jit = orc::LLLazyJITBuilder()
+			.setJITTargetMachineBuilder(*jtmb)
+			.setObjectLinkingLayerCreator(create_object_layer)
+			.setCompileFunctionCreator(create_compiler)
+			.setNumCompileThreads(Options.JITCompileThreads)
+			.create();
+	if (!jit) {
+		std::cerr << "ERROR: " << toString(jit.takeError()) << std::endl;
+		return false;
+	}
+	JIT = std::move(*jit);
+
+	// Each lazily compiled module defines a single function, so compile it
+	// whole.  Otherwise the JIT copies the function into a new context,
+	// and it would no longer be optimized and compiled under the lock of
+	// the context shared with the rest of the code.
+	JIT->setPartitionFunction(orc::CompileOnDemandLayer::compileWholeModule);
+
+	// Optimize each module (or, for lazily compiled functions, each
+	// function) just before it is compiled.
+	JIT->getIRTransformLayer().setTransform(
+		[this](orc::ThreadSafeModule tsm,
+		       const orc::MaterializationResponsibility &)
 		{
-			std::cerr << "ERROR: couldn't add passes "
-				"to create object file" << std::endl;
+			tsm.withModuleDo([this](Module & mod) {
+				optimizeJITModule(mod);
+			});
+			return Expected<orc::ThreadSafeModule>(std::move(tsm));
+		});
+
+
+	// The runtime library is linked into the interpreter itself.
+	orc::MangleAndInterner mangle(JIT->getExecutionSession(),
+				      JIT->getDataLayout());
+	orc::SymbolMap runtime_symbols;
+	runtime_symbols[mangle("__garter_print")] =
+		JITEvaluatedSymbol(pointerToJITTargetAddress(&__garter_print),
+				   JITSymbolFlags::Exported);
+	runtime_symbols[mangle("__garter_exponentiate")] =
+		JITEvaluatedSymbol(pointerToJITTargetAddress(&__garter_exponentiate),
+				   JITSymbolFlags::Exported);
+	runtime_symbols[mangle("__garter_tier_up")] =
+		JITEvaluatedSymbol(pointerToJITTargetAddress(&tierUpCallback),
+				   JITSymbolFlags::Exported);
+
+	orc::JITDylib & jd = JIT->getMainJITDylib();
+	if (Error err = jd.define(orc::absoluteSymbols(runtime_symbols))) {
+		std::cerr << "ERROR: " << toString(std::move(err)) << std::endl;
+		return false;
+	}
+
+	// Other symbols, such as library functions that LLVM generates calls
+	// to, are resolved in the interpreter process.
+	auto generator = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+				JIT->getDataLayout().getGlobalPrefix());
+	if (!generator) {
+		std::cerr << "ERROR: " << toString(generator.takeError()) << std::endl;
+		return false;
+	}
+	jd.addGenerator(std::move(*generator));
+
+	if (tieredCompilationEnabled())
+		TierUpThread = std::thread(&LLVMBackend::runTierUpThread, this);
+	return true;
+}
+
+// Start a new module for the IR of the next top-level item to be JIT compiled.
+void LLVMBackend::startModule()
+{
+	Mod.reset(new Module("", Ctx));
+	Mod->setDataLayout(JIT->getDataLayout());
+	Mod->setTargetTriple(JIT->getTargetTriple().str());
+}
+
+// Hand the current module over to the JIT.  If @lazy, each function in it is
+// only compiled when first called; a copy of its unoptimized IR is also kept in
+// FunctionLibrary for importing into callers.  If @tracker is given, the
+// module's code can be freed by removing the tracker.
+bool LLVMBackend::addModuleToJIT(bool lazy, orc::ResourceTrackerSP tracker)
+{
+	if (lazy) {
+		for (const Function & f : *Mod)
+			if (!f.isDeclaration())
+				FunctionLibrary[f.getName().str()] = CloneModule(*Mod);
+	}
+
+	// Functions whose optimization level was chosen with @opt(N) are
+	// compiled at that level directly.
+	if (lazy && tieredCompilationEnabled()) {
+		for (Function & f : *Mod) {
+			const std::string name = f.getName().str();
+			if (f.isDeclaration() || FunctionOptLevels.count(name) ||
+			    f.hasOptNone())
+				continue;
+			TieredFunctions.emplace_back(this, name);
+			BaselineFunctions.insert(name);
+			instrumentForTiering(f, &TieredFunctions.back());
+		}
+	}
+
+	orc::ThreadSafeModule tsm(std::move(Mod), TSCtx);
+	Error err = lazy ? JIT->addLazyIRModule(std::move(tsm)) :
+		    tracker ? JIT->addIRModule(tracker, std::move(tsm)) :
+			      JIT->addIRModule(std::move(tsm));
+	if (err) {
+		std::cerr << "ERROR: " << toString(std::move(err)) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Move the top-level variables defined in the current module into
+// VariableStorage, leaving declarations in the module, and make them visible
+// to the JIT.  Returns false if they couldn't be defined in the JIT.
+bool LLVMBackend::allocateVariables()
+{
+	orc::MangleAndInterner mangle(JIT->getExecutionSession(),
+				      JIT->getDataLayout());
+	orc::SymbolMap symbols;
+
+	for (GlobalVariable & var : Mod->globals()) {
+		if (var.isDeclaration())
+			continue;
+		VariableStorage.push_back(0);
+		symbols[mangle(var.getName())] =
+			JITEvaluatedSymbol(pointerToJITTargetAddress(&VariableStorage.back()),
+					   JITSymbolFlags::Exported);
+		var.setInitializer(nullptr);
+	}
+	if (symbols.empty())
+		return true;
+
+	if (Error err = JIT->getMainJITDylib().define(orc::absoluteSymbols(symbols))) {
+		std::cerr << "ERROR: " << toString(std::move(err)) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Parse the runtime library's bitcode and add the functions it defines to
+// FunctionLibrary, so that they are imported like the functions given to the
+// JIT.  Returns false after printing an error message if some bitcode couldn't
+// be parsed.
+bool LLVMBackend::loadRuntimeBitcode()
+{
+	RuntimeBitcodeLoaded = true;
+
+	for (const EmbeddedBitcode & file : Options.RuntimeBitcode) {
+		MemoryBufferRef buffer(StringRef((const char *)file.Data, file.Size),
+				       file.Name);
+		Expected<std::unique_ptr<Module>> mod = parseBitcodeFile(buffer, Ctx);
+		if (!mod) {
+			std::cerr << "ERROR: " << file.Name << ": "
+				  << toString(mod.takeError()) << std::endl;
 			return false;
 		}
-	} else {
-		mgr.add(llvm::createPrintModulePass(&out));
+
+		// The runtime was compiled for this host, but its triple may
+		// be spelled differently from the JIT's.
+		(*mod)->setDataLayout(JIT->getDataLayout());
+		(*mod)->setTargetTriple(JIT->getTargetTriple().str());
+
+		// Bitcode compiled from garter code has a weak 'main'.
+		for (const Function & f : **mod) {
+			if (!f.isDeclaration() && !f.hasLocalLinkage() &&
+			    f.getName() != "main")
+				FunctionLibrary.emplace(f.getName().str(),
+							CloneModule(**mod));
+		}
 	}
+	return true;
+}
 
-	mgr.run(*Mod);
-	os.keep();
+// Import the definitions of the functions called from @mod out of
+// FunctionLibrary, so that the inliner can see their bodies.  The imported
+// copies are available_externally: they may be inlined but are never emitted,
+// so calls that aren't inlined still go to the JIT's compiled function, or to
+// the runtime linked into the executable.
+void LLVMBackend::importCallees(Module & mod)
+{
+	std::vector<const Module*> callees;
+	for (const Function & f : mod) {
+		if (!f.isDeclaration() || f.isIntrinsic())
+			continue;
+		auto it = FunctionLibrary.find(f.getName().str());
+		if (it == FunctionLibrary.end() && !RuntimeBitcodeLoaded) {
+			loadRuntimeBitcode();
+			it = FunctionLibrary.find(f.getName().str());
+		}
+		if (it != FunctionLibrary.end())
+			callees.push_back(it->second.get());
+	}
+
+	for (const Module *callee : callees) {
+		std::unique_ptr<Module> import = CloneModule(*callee);
+		for (Function & f : *import)
+			if (!f.isDeclaration())
+				f.setLinkage(GlobalValue::AvailableExternallyLinkage);
+
+		if (Linker::linkModules(mod, std::move(import), Linker::LinkOnlyNeeded)) {
+			std::cerr << "ERROR: couldn't import functions for inlining"
+				  << std::endl;
+			return;
+		}
+	}
+}
+
+// Optimize a module about to be compiled by the JIT.  This is called on the
+// JIT's compile threads with the context locked.  The module contains either
+// a statement or a single lazily compiled function, so it's optimized at the
+// level of the function it defines.
+void LLVMBackend::optimizeJITModule(Module & mod)
+{
+	// Whole programs are optimized before being handed to the JIT.
+	if (mod.getModuleFlag("garter.optimized") != nullptr)
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+	unsigned level = Options.OptLevel;
+	bool baseline = false;
+
+	for (const Function & f : mod) {
+		if (!f.isDeclaration()) {
+			const std::string name = f.getName().str();
+			baseline = BaselineFunctions.count(name);
+			if (baseline)
+				level = Options.BaselineOptLevel;
+			else
+				level = getFunctionOptLevel(f);
+			if (name.compare(0, 18, "__garter_anonymous") != 0)
+				FunctionsCompiled[std::min(level, 3U)]++;
+			break;
+		}
+	}
+	if (level >= 2)
+		importCallees(mod);
+
+	// Baseline code is cheap to compile, and tiered functions' baseline
+	// code contains addresses that differ between runs, so it isn't
+	// cached.
+	if (ObjCache == nullptr || baseline ||
+	    !ObjCache->lookup(mod, getCacheParameters(level)))
+		runOptimizationPipeline(mod, level, JITMachine.get());
+
+	OptimizeTime += nanosecondsSince(start);
+}
+
+// Return a description of the settings besides the IR that affect the code
+// compiled by the JIT at optimization level @level, for use in object cache
+// keys
+std::string LLVMBackend::getCacheParameters(unsigned level) const
+{
+	std::ostringstream params;
+	params << "O" << level
+	       << " cpu=" << JITMachine->getTargetCPU().str()
+	       << " features=" << JITMachine->getTargetFeatureString().str()
+	       << " specialize=" << Options.SpecializeSizeLimit
+	       << "," << Options.SpecializeMaxGrowth;
+	return params.str();
+}
+
+bool LLVMBackend::tieredCompilationEnabled() const
+{
+	return Options.TierUpThreshold != 0 &&
+	       Options.BaselineOptLevel < Options.OptLevel;
+}
+
+// Insert code before @insert_before that increments *@counter, then calls
+// __garter_tier_up() if the function described by @info became hot and its
+// recompilation hasn't been requested yet.
+void LLVMBackend::generateCounterIncrement(Instruction *insert_before,
+					   uint32_t *counter, TieredFunction *info)
+{
+	Type *ptr_type = Int32Ty->getPointerTo();
+	Value *counter_ptr = Builder.getInt64((uintptr_t)counter);
+	Value *calls_ptr = Builder.getInt64((uintptr_t)&info->Calls);
+	Value *back_edges_ptr = Builder.getInt64((uintptr_t)&info->BackEdges);
+
+	Builder.SetInsertPoint(insert_before);
+	counter_ptr = Builder.CreateIntToPtr(counter_ptr, ptr_type);
+	calls_ptr = Builder.CreateIntToPtr(calls_ptr, ptr_type);
+	back_edges_ptr = Builder.CreateIntToPtr(back_edges_ptr, ptr_type);
+
+	Value *count = Builder.CreateLoad(Int32Ty, counter_ptr);
+	Builder.CreateStore(Builder.CreateAdd(count, Builder.getInt32(1)),
+			    counter_ptr);
+
+	Value *total = Builder.CreateAdd(Builder.CreateLoad(Int32Ty, calls_ptr),
+					 Builder.CreateLoad(Int32Ty, back_edges_ptr));
+	Value *is_hot = Builder.CreateICmpUGE(total,
+				Builder.getInt32(Options.TierUpThreshold));
+	Instruction *then = SplitBlockAndInsertIfThen(is_hot, insert_before, false);
+
+	Builder.SetInsertPoint(then);
+	Value *requested_ptr = Builder.CreateIntToPtr(
+			Builder.getInt64((uintptr_t)&info->TierUpRequested),
+			Builder.getInt8PtrTy());
+	LoadInst *requested = Builder.CreateAlignedLoad(Builder.getInt8Ty(),
+							requested_ptr, Align(1));
+	requested->setAtomic(AtomicOrdering::Monotonic);
+	then = SplitBlockAndInsertIfThen(Builder.CreateIsNull(requested),
+					 then, false);
+	Builder.SetInsertPoint(then);
+
+	Type *info_ptr_type = Builder.getInt8PtrTy();
+	FunctionType *funcTy = FunctionType::get(Builder.getVoidTy(),
+						 info_ptr_type, false);
+	FunctionCallee tier_up = Mod->getOrInsertFunction("__garter_tier_up", funcTy);
+	Builder.CreateCall(tier_up, Builder.CreateIntToPtr(
+				Builder.getInt64((uintptr_t)info), info_ptr_type));
+}
+
+// Turn @f into the baseline code for a tiered function.  On entry, @f jumps to
+// the optimized code if it's ready; otherwise it counts the call.  Each loop
+// back edge is counted too.
+void LLVMBackend::instrumentForTiering(Function & f, TieredFunction *info)
+{
+	BasicBlock *body = &f.getEntryBlock();
+
+	DominatorTree dom_tree(f);
+	LoopInfo loop_info(dom_tree);
+	SmallVector<BasicBlock*, 8> latches;
+	for (Loop *loop : loop_info.getLoopsInPreorder())
+		loop->getLoopLatches(latches);
+	for (BasicBlock *latch : latches) {
+		// The loop hints are left to the optimized code; with the
+		// counters in them, the baseline code's loops can't be
+		// vectorized anyway.
+		latch->getTerminator()->setMetadata(LLVMContext::MD_loop, nullptr);
+		generateCounterIncrement(latch->getTerminator(),
+					 &info->BackEdges, info);
+	}
+
+	BasicBlock *dispatch = BasicBlock::Create(Ctx, "dispatch", &f, body);
+	BasicBlock *optimized = BasicBlock::Create(Ctx, "optimized", &f, body);
+	BasicBlock *baseline = BasicBlock::Create(Ctx, "baseline", &f, body);
+
+	// Keep the allocas in the entry block
+	while (isa<AllocaInst>(body->front()))
+		body->front().moveBefore(*dispatch, dispatch->end());
+
+	Builder.SetInsertPoint(dispatch);
+	Type *code_ptr_type = f.getFunctionType()->getPointerTo();
+	Value *slot = Builder.CreateIntToPtr(
+			Builder.getInt64((uintptr_t)&info->OptimizedCode),
+			code_ptr_type->getPointerTo());
+	LoadInst *code = Builder.CreateAlignedLoad(code_ptr_type, slot,
+						   Align(sizeof(void*)));
+	code->setAtomic(AtomicOrdering::Acquire);
+	Builder.CreateCondBr(Builder.CreateIsNotNull(code), optimized, baseline);
+
+	Builder.SetInsertPoint(optimized);
+	std::vector<Value*> args;
+	for (Argument & arg : f.args())
+		args.push_back(&arg);
+	CallInst *call = Builder.CreateCall(f.getFunctionType(), code, args);
+	call->setTailCallKind(CallInst::TCK_MustTail);
+	Builder.CreateRet(call);
+
+	Builder.SetInsertPoint(baseline);
+	BranchInst *br = Builder.CreateBr(body);
+	generateCounterIncrement(br, &info->Calls, info);
+
+	assert(!llvm::verifyFunction(f, &errs()));
+}
+
+// Called from the baseline code of a function that just became hot.  Queues
+// the function to be recompiled at the full optimization level.
+void LLVMBackend::tierUpCallback(TieredFunction *info)
+{
+	LLVMBackend & backend = *info->Backend;
+
+	// Several threads may run the baseline code at once
+	if (info->TierUpRequested.exchange(true))
+		return;
+	TierUpRequest request = {
+		info, info->Calls, info->BackEdges,
+		std::chrono::steady_clock::now(),
+	};
+	{
+		std::lock_guard<std::mutex> lock(backend.TierUpMutex);
+		backend.TierUpQueue.push_back(request);
+	}
+	backend.TierUpCond.notify_one();
+}
+
+void LLVMBackend::runTierUpThread()
+{
+	std::unique_lock<std::mutex> lock(TierUpMutex);
+	for (;;) {
+		TierUpCond.wait(lock, [this] {
+			return TierUpStop || !TierUpQueue.empty();
+		});
+		if (TierUpStop)
+			return;
+		TierUpRequest request = TierUpQueue.front();
+		TierUpQueue.pop_front();
+
+		lock.unlock();
+		compileOptimizedVersion(request);
+		lock.lock();
+	}
+}
+
+// Compile the requested function at the full optimization level from its IR in
+// FunctionLibrary, then point its baseline code at the result.
+void LLVMBackend::compileOptimizedVersion(const TierUpRequest & request)
+{
+	TieredFunction *info = request.Function;
+	const std::string name = info->Name + ".opt";
+	{
+		auto lock = TSCtx.getLock();
+		std::unique_ptr<Module> mod = CloneModule(*FunctionLibrary[info->Name]);
+		// Renaming the clone also makes its recursive calls go
+		// straight to the optimized code.
+		Function *f = mod->getFunction(info->Name);
+		f->setName(name);
+
+		orc::ThreadSafeModule tsm(std::move(mod), TSCtx);
+		if (Error err = JIT->addIRModule(std::move(tsm))) {
+			std::cerr << "ERROR: " << toString(std::move(err)) << std::endl;
+			return;
+		}
+	}
+
+	auto sym = JIT->lookup(name);
+	if (!sym) {
+		std::cerr << "ERROR: " << toString(sym.takeError()) << std::endl;
+		return;
+	}
+	info->OptimizedCode.store((void*)sym->getAddress(),
+				  std::memory_order_release);
+
+	std::ostringstream event;
+	event << std::fixed << std::setprecision(3) << info->Name
+	      << " became hot after " << request.Calls << " calls and "
+	      << request.BackEdges << " back edges; O" << Options.OptLevel
+	      << " code ready " << nanosecondsSince(request.Time) / 1e6
+	      << " ms later";
+	std::lock_guard<std::mutex> lock(TierUpMutex);
+	TierUpEvents.push_back(event.str());
+}
+
+bool LLVMBackend::executeProgram(const ProgramAST & program)
+{
+	if (JIT == nullptr && !initializeJIT())
+		return false;
+
+	auto start = std::chrono::steady_clock::now();
+	uint64_t irgen_time;
+	uint64_t optimize_time;
+	{
+		auto lock = TSCtx.getLock();
+
+		startModule();
+		if (!generateProgramIR(program))
+			return false;
+		irgen_time = nanosecondsSince(start);
+
+		for (const Function & f : *Mod)
+			if (!f.isDeclaration())
+				FunctionsCompiled[getFunctionOptLevel(f)]++;
+
+		// Optimize the program the same way as garterc does, rather
+		// than one function at a time in the JIT.
+		start = std::chrono::steady_clock::now();
+		if (Options.OptLevel >= 2)
+			importCallees(*Mod);
+		if ((ObjCache == nullptr ||
+		     !ObjCache->lookup(*Mod, getCacheParameters(Options.OptLevel))) &&
+		    !optimizeModule(JITMachine.get()))
+			return false;
+		optimize_time = nanosecondsSince(start);
+		OptimizeTime += optimize_time;
+
+		Mod->addModuleFlag(Module::Warning, "garter.optimized", 1);
+		if (!addModuleToJIT(false))
+			return false;
+	}
+
+	const uint64_t codegen_time = CodegenTime;
+	NativeFunction<0> main_func = getNativeFunction<0>("main");
+	if (main_func == nullptr)
+		return false;
+
+	if (Options.ReportCompileTime) {
+		std::cerr << std::fixed << std::setprecision(3)
+			  << "program: IR generation " << irgen_time / 1e6
+			  << " ms, optimization " << optimize_time / 1e6
+			  << " ms, code generation "
+			  << (CodegenTime - codegen_time) / 1e6
+			  << " ms" << std::endl;
+	}
+
+	main_func();
+	return true;
+}
+
+void *LLVMBackend::getFunctionAddress(const std::string & name)
+{
+	if (JIT == nullptr || !DefinedFunctions.count(name))
+		return nullptr;
+
+	{
+		auto lock = TSCtx.getLock();
+		if (PendingFunctions.count(name) && !generatePendingFunction(name))
+			return nullptr;
+	}
+
+	auto sym = JIT->lookup(name);
+	if (!sym) {
+		std::cerr << "ERROR: " << toString(sym.takeError()) << std::endl;
+		return nullptr;
+	}
+	return (void*)sym->getAddress();
+}
+
+JITMemoryUsage LLVMBackend::getJITMemoryUsage() const
+{
+	return JITMemoryUsage { MemMapper.CodeBytes, MemMapper.DataBytes };
+}
+
+int LLVMBackend::getFunctionArity(const std::string & name) const
+{
+	auto it = DefinedFunctions.find(name);
+	if (it == DefinedFunctions.end())
+		return -1;
+	return it->second->getNumParams();
+}
+
+typedef int32_t (*Trampoline)(void *code, const int32_t *args);
+
+template <size_t... I>
+static int32_t callWithArgs(void *code, const int32_t *args,
+			    std::index_sequence<I...>)
+{
+	return ((NativeFunction<sizeof...(I)>)code)(args[I]...);
+}
+
+// Call the native code @code of a function taking N parameters, passing it
+// args[0] through args[N - 1]
+template <size_t N>
+static int32_t trampoline(void *code, const int32_t *args)
+{
+	return callWithArgs(code, args, std::make_index_sequence<N>());
+}
+
+static const Trampoline Trampolines[MaxTrampolineArity + 1] = {
+	trampoline<0>, trampoline<1>, trampoline<2>,
+	trampoline<3>, trampoline<4>, trampoline<5>,
+	trampoline<6>, trampoline<7>, trampoline<8>,
+};
+
+bool LLVMBackend::callFunction(const std::string & name,
+			       const std::vector<int32_t> & args,
+			       int32_t & result)
+{
+	const int arity = getFunctionArity(name);
+	if (arity < 0 || (size_t)arity != args.size() ||
+	    args.size() > MaxTrampolineArity)
+		return false;
+
+	void *code = getFunctionAddress(name);
+	if (code == nullptr)
+		return false;
+
+	result = Trampolines[arity](code, args.data());
 	return true;
 }
 
+void LLVMBackend::printJITStatistics(std::ostream & os)
+{
+	os << "JIT statistics:" << std::endl;
+	os << "  statements compiled: " << StatementNumber - 1 << std::endl;
+	{
+		auto lock = TSCtx.getLock();
+		for (unsigned level = 0; level <= 3; level++) {
+			if (FunctionsCompiled[level] != 0)
+				os << "  functions compiled at O" << level << ": "
+				   << FunctionsCompiled[level] << std::endl;
+		}
+	}
+	os << std::fixed << std::setprecision(3)
+	   << "  optimization time: " << OptimizeTime / 1e6 << " ms" << std::endl
+	   << "  code generation time: " << CodegenTime / 1e6 << " ms" << std::endl
+	   << "  live JIT memory: " << MemMapper.CodeBytes << " bytes code, "
+	   << MemMapper.DataBytes << " bytes data" << std::endl;
+	if (ObjCache != nullptr) {
+		os << "  object cache: " << ObjCache->Hits << " hits, "
+		   << ObjCache->Misses << " misses, "
+		   << ObjCache->Stores << " stored, "
+		   << ObjCache->Evictions << " evicted" << std::endl;
+	}
+
+	if (!TieredFunctions.empty()) {
+		os << "Baseline code counters:" << std::endl;
+		for (const TieredFunction & info : TieredFunctions) {
+			os << "  " << info.Name << ": " << info.Calls << " calls, "
+			   << info.BackEdges << " back edges";
+			if (info.OptimizedCode != nullptr)
+				os << ", optimized";
+			else if (info.TierUpRequested)
+				os << ", tier-up pending";
+			os << std::endl;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(TierUpMutex);
+	if (!TierUpEvents.empty()) {
+		os << "Tier-up events:" << std::endl;
+		for (const std::string & event : TierUpEvents)
+			os << "  " << event << std::endl;
+	}
+}
+
 bool LLVMBackend::executeTopLevelItem(std::shared_ptr<ASTBase> top_level_item)
 {
 	std::shared_ptr<FunctionDefinitionAST> func =
 		std::dynamic_pointer_cast<FunctionDefinitionAST>(top_level_item);
 	std::shared_ptr<StatementAST> stmt =
 		std::dynamic_pointer_cast<StatementAST>(top_level_item);
+	std::shared_ptr<ConstantDefinitionAST> constdef =
+		std::dynamic_pointer_cast<ConstantDefinitionAST>(top_level_item);
+	std::string name;
 	Function *f;
+	orc::ResourceTrackerSP tracker;
 
-	if (stmt) {
-		if (Engine == nullptr) {
-			llvm::InitializeNativeTarget();
-			Engine = EngineBuilder(Mod).create();
+	if (constdef) {
+		// Statements and functions compiled from now on see the
+		// constant as a literal.
+		return defineConstant(*constdef);
+	}
 
+	if (JIT == nullptr && !initializeJIT())
+		return false;
+	Incremental = true;
 
-			FunctionType *print_type = FunctionType::get(Int32Ty, Int32Ty, true);
-			Constant *print = Mod->getOrInsertFunction("__garter_print", print_type);
-			Engine->addGlobalMapping(static_cast<GlobalValue*>(print),
-						 (void*)__garter_print);
+	auto start = std::chrono::steady_clock::now();
+	uint64_t irgen_time;
+	{
+		// The JIT may be compiling other modules in the same context on
+		// its own threads.
+		auto lock = TSCtx.getLock();
+		// Variables defined by a statement that fails to compile are
+		// forgotten along with its module.
+		auto prev_variables = DefinedVariables;
+
+		if (func && Options.LazyIRGeneration) {
+			// Generate the IR when the function is first referenced
+			if (!registerFunction(*func))
+				return false;
+			PendingFunctions[func->Name] = func;
+			return true;
+		}
 
-			std::vector<Type*> param_types(2, Int32Ty);
-			FunctionType *exp_type = FunctionType::get(Int32Ty, param_types, false);
-			Constant *exp = Mod->getOrInsertFunction("__garter_exponentiate", exp_type);
-			Engine->addGlobalMapping(static_cast<GlobalValue*>(exp),
-						 (void*)__garter_exponentiate);
+		startModule();
+
+		if (stmt) {
+			char buf[50];
+			sprintf(buf, "__garter_anonymous%lu", StatementNumber++);
+			name = buf;
+			FunctionDefinitionAST anon_func(name, {}, {stmt});
+
+			f = generateFunctionPrototype(anon_func);
+			if (f != nullptr)
+				f = generateFunctionBodyCode(anon_func, true);
+		} else {
+			name = func->Name;
+			f = generateFunctionPrototype(*func);
+			if (f != nullptr)
+				f = generateFunctionBodyCode(*func);
+		}
+		if (f == nullptr) {
+			// Discard the partially generated module, along with
+			// anything it defined.  Functions it referenced for the
+			// first time were generated into modules of their own
+			// and remain defined.
+			if (Mod->getFunction(name) != nullptr)
+				DefinedFunctions.erase(name);
+			Mod.reset();
+			DefinedVariables = prev_variables;
+			return false;
+		}
 
+		// Statements run only once, so unless they contain loops,
+		// there's no point in optimizing them.
+		if (stmt && tieredCompilationEnabled()) {
+			DominatorTree dom_tree(*f);
+			LoopInfo loop_info(dom_tree);
+			if (loop_info.empty())
+				BaselineFunctions.insert(name);
 		}
-		char buf[50];
-		sprintf(buf, "__garter_anonymous%lu", StatementNumber++);
-		FunctionDefinitionAST func(std::string(buf), {}, {stmt});
 
-		f = generateFunctionPrototype(func);
-		if (f == nullptr)
-			return false;
-		f = generateFunctionBodyCode(func, true);
-		if (f == nullptr)
+		// Functions are compiled when first called; statements are
+		// compiled now, then run, then freed.
+		irgen_time = nanosecondsSince(start);
+		if (stmt) {
+			tracker = JIT->getMainJITDylib().createResourceTracker();
+			if (!allocateVariables()) {
+				Mod.reset();
+				DefinedVariables = prev_variables;
+				return false;
+			}
+		}
+		if (!addModuleToJIT(func != nullptr, tracker))
 			return false;
+	}
 
-		Engine->runFunction(f, {});
-		f->eraseFromParent();
-	} else {
-		f = generateFunctionPrototype(*func);
-		if (f == nullptr)
+	if (stmt) {
+		const uint64_t optimize_time = OptimizeTime;
+		const uint64_t codegen_time = CodegenTime;
+
+		NativeFunction<0> anon_func = getNativeFunction<0>(name);
+		if (anon_func != nullptr)
+			anon_func();
+
+		{
+			auto lock = TSCtx.getLock();
+			DefinedFunctions.erase(name);
+			BaselineFunctions.erase(name);
+		}
+		if (Error err = tracker->remove()) {
+			std::cerr << "ERROR: " << toString(std::move(err)) << std::endl;
 			return false;
-		f = generateFunctionBodyCode(*func);
-		if (f == nullptr)
+		}
+		// The names of the symbols removed stay interned until dead
+		// entries are cleared, which takes time proportional to the
+		// number of symbols, so do it only occasionally.
+		if (StatementNumber % 1024 == 0)
+			JIT->getExecutionSession().getSymbolStringPool()->clearDeadEntries();
+		if (anon_func == nullptr)
 			return false;
-	}
 
+		// Functions compiled lazily while the statement ran are
+		// included in its compile time.
+		if (Options.ReportCompileTime) {
+			std::cerr << std::fixed << std::setprecision(3)
+				  << "statement " << StatementNumber - 1
+				  << ": IR generation " << irgen_time / 1e6
+				  << " ms, optimization "
+				  << (OptimizeTime - optimize_time) / 1e6
+				  << " ms, code generation "
+				  << (CodegenTime - codegen_time) / 1e6
+				  << " ms" << std::endl;
+		}
+	}
 	return true;
 }
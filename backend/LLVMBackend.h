@@ -2,57 +2,450 @@
 #define _GARTER_LLVM_BACKEND_H_
 
 #include <backend/Backend.h>
+#include <backend/ConstantEvaluator.h>
+#include <backend/FunctionSpecialization.h>
+#include <backend/JITMemoryMapper.h>
+#include <backend/JITObjectCache.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <llvm/ExecutionEngine/Orc/Core.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/IRBuilder.h>
 
 namespace llvm {
-	class ExecutionEngine;
+	class Function;
+	class GlobalVariable;
 	class Module;
+	class TargetMachine;
+	namespace orc {
+		class LLLazyJIT;
+	};
 };
 
 namespace garter {
 
+class ConstantDefinitionAST;
 class FunctionDefinitionAST;
+class LLVMBackend;
 class LLVMCodeGeneratorVisitor;
 
+// A bitcode file built into an executable
+struct EmbeddedBitcode {
+	const char *Name;
+	const unsigned char *Data;
+	size_t Size;
+};
+
+// Options affecting how LLVMBackend compiles programs
+struct LLVMBackendOptions {
+	// Functions larger than this many instructions are not specialized
+	// on constant arguments
+	unsigned SpecializeSizeLimit;
+
+	// Maximum code growth from function specialization, as a percentage
+	// of the program size (0 disables specialization)
+	unsigned SpecializeMaxGrowth;
+
+	// Print the specialized functions created to standard error
+	bool ReportSpecializations;
+
+	// Optimization level (0-3) for functions not annotated with @opt(N)
+	unsigned OptLevel;
+
+	// Number of threads the JIT compiler uses to compile functions in the
+	// background (0 compiles on the thread calling the function)
+	unsigned JITCompileThreads;
+
+	// Number of threads compileProgramToObjectFile() uses to generate
+	// machine code (1 compiles on the calling thread)
+	unsigned CompileJobs;
+
+	// Linker with which the object files generated on several threads are
+	// combined.  Combining them also needs objcopy; without either, the
+	// machine code is generated on the calling thread.
+	std::string Linker;
+
+	// CPU that compiled programs are generated for, or "native" for the
+	// host's CPU with the features detected on the host.  The JIT always
+	// generates code for the host.
+	std::string TargetCPU;
+
+	// Target features to enable ("+feature") or disable ("-feature") in
+	// compiled programs on top of those of TargetCPU, separated by commas
+	std::string TargetFeatures;
+
+	// Print the loops and code vectorized when compiling a program, and
+	// a summary, to standard error
+	bool ReportVectorization;
+
+	// Name of the source file of the program being compiled, which
+	// identifies its functions in profiles
+	std::string SourceFileName;
+
+	// Add profile counters to compiled programs (see backend/Profile.h)
+	bool ProfileGenerate;
+
+	// Profile file whose counts guide the optimization of compiled
+	// programs (empty for none)
+	std::string ProfileUse;
+
+	// Print the time spent in each phase of compiling a program, or when
+	// executing top-level items, compiling each statement, to standard
+	// error
+	bool ReportCompileTime;
+
+	// When executing top-level items, functions are first compiled at
+	// BaselineOptLevel and recompiled at OptLevel in the background once
+	// their calls plus loop iterations reach TierUpThreshold (0 disables
+	// tiered compilation)
+	unsigned BaselineOptLevel;
+	unsigned TierUpThreshold;
+
+	// When executing top-level items or whole programs, generate the IR
+	// for a function only when it is first referenced
+	bool LazyIRGeneration;
+
+	// Directory in which to cache the machine code compiled by the JIT
+	// (empty disables caching), and the maximum total size of the cached
+	// objects in bytes
+	std::string CacheDir;
+	uint64_t CacheSizeLimit;
+
+	// Bitcode of the runtime library.  When JIT compiling at -O2 or
+	// above, the definitions of the runtime functions called from a
+	// module are imported into it, so that they can be inlined and
+	// specialized; calls that aren't inlined still go to the runtime
+	// linked into the executable.
+	std::vector<EmbeddedBitcode> RuntimeBitcode;
+
+	LLVMBackendOptions()
+		: SpecializeSizeLimit(200),
+		  SpecializeMaxGrowth(50),
+		  ReportSpecializations(false),
+		  OptLevel(2),
+		  JITCompileThreads(0),
+		  CompileJobs(1),
+		  TargetCPU("native"),
+		  ReportVectorization(false),
+		  ProfileGenerate(false),
+		  ReportCompileTime(false),
+		  BaselineOptLevel(0),
+		  TierUpThreshold(0),
+		  LazyIRGeneration(false),
+		  CacheSizeLimit(64 << 20)
+	{
+	}
+};
+
+// Return whether compileProgramToObjectFile() can generate machine code on
+// several threads with @options, which needs the tools that combine the
+// object files
+bool canGenerateCodeInParallel(const LLVMBackendOptions & options);
+
+// Find the CPU name and target feature string that programs compiled with
+// @options are generated for
+void getTargetCPUAndFeatures(const LLVMBackendOptions & options,
+			     std::string & cpu, std::string & features);
+
+// Statistics collected from the remarks of the loop and SLP vectorizers
+struct VectorizationStats {
+	// Description of each loop vectorized or interleaved, for example
+	// "loop in sum_to: width 8, interleave 2"
+	std::vector<std::string> Loops;
+
+	// Number of loops vectorized with each vectorization width (1 for
+	// loops that were only interleaved)
+	std::map<unsigned, unsigned> LoopsByWidth;
+
+	// Number of sequences of straight-line code the SLP vectorizer
+	// combined into vector instructions
+	unsigned SLPVectorized;
+
+	VectorizationStats()
+		: SLPVectorized(0)
+	{
+	}
+};
+
+// Native function pointer type of a compiled garter function taking N
+// parameters, for example NativeFunction<2> is int32_t (*)(int32_t, int32_t)
+template <typename Indices> struct NativeFunctionType;
+
+template <size_t... I>
+struct NativeFunctionType<std::index_sequence<I...>> {
+	typedef int32_t (*type)(decltype((void)I, int32_t())...);
+};
+
+template <size_t N>
+using NativeFunction = typename NativeFunctionType<std::make_index_sequence<N>>::type;
+
+// Maximum number of parameters of a function called with
+// LLVMBackend::callFunction()
+static const size_t MaxTrampolineArity = 8;
+
+// Execution counters and state of a function JIT compiled with tiered
+// compilation.  The counters are incremented by the function's baseline code.
+// Once the optimized code is ready, the baseline code jumps to it on entry.
+// The counters may keep running, and wrap around, after the function became
+// hot; TierUpRequested makes sure it's queued for recompilation only once.
+struct TieredFunction {
+	LLVMBackend *Backend;
+	std::string Name;
+	uint32_t Calls;
+	uint32_t BackEdges;
+	std::atomic<bool> TierUpRequested;
+	std::atomic<void*> OptimizedCode;
+
+	TieredFunction(LLVMBackend *backend, const std::string & name)
+		: Backend(backend), Name(name), Calls(0), BackEdges(0),
+		  TierUpRequested(false), OptimizedCode(nullptr)
+	{
+	}
+};
+
+// Request to recompile a tiered function that became hot, with its counters
+// at that time
+struct TierUpRequest {
+	TieredFunction *Function;
+	uint32_t Calls;
+	uint32_t BackEdges;
+	std::chrono::steady_clock::time_point Time;
+};
+
+// Memory currently used for code and data compiled by the JIT, in bytes
+struct JITMemoryUsage {
+	uint64_t CodeBytes;
+	uint64_t DataBytes;
+};
+
 // Implementation of a garter Backend that uses LLVM for code generation.
 // It additionally offers the function compileProgramToLLVMIR() for creating a
-// LLVM IR file instead of a native object file.
+// LLVM IR file instead of a native object file, and for link-time optimization,
+// compileProgramToBitcode() and linkBitcodeFiles().
+//
+// When compiling a whole program, all IR is generated into a single module,
+// which is optimized as a whole and may then be split into partitions whose
+// machine code is generated on several threads.
+// When executing top-level items one at a time, each item is generated into a
+// module of its own which is handed to an ORC JIT: function definitions are
+// compiled lazily when first called, and statements are compiled and run
+// immediately, after which their code is freed.  Each module the JIT compiles
+// is first run through the same optimization pipeline as whole programs, with
+// the functions it calls imported from FunctionLibrary so that they can be
+// inlined.  Runtime functions are imported the same way from the runtime
+// library's bitcode, if given.
+//
+// With tiered compilation, functions are first compiled cheaply with counters
+// added, and hot functions are recompiled from FunctionLibrary on a background
+// thread.
 class LLVMBackend : public Backend {
 
-	llvm::LLVMContext Ctx;
-	llvm::Module *Mod;
+	LLVMBackendOptions Options;
+	llvm::orc::ThreadSafeContext TSCtx;
+	llvm::LLVMContext & Ctx;
+	std::unique_ptr<llvm::Module> Mod;
 	llvm::IRBuilder<> Builder;
 	llvm::IntegerType *Int32Ty;
-	llvm::ExecutionEngine *Engine;
+	// Declared before JIT, whose memory managers use it
+	JITMemoryMapper MemMapper;
+	std::unique_ptr<llvm::orc::LLLazyJIT> JIT;
+	std::unique_ptr<llvm::TargetMachine> JITMachine;
+	std::unique_ptr<JITObjectCache> ObjCache;
 	unsigned long StatementNumber;
 
+	// True when top-level items are compiled one at a time into separate
+	// modules, so functions and variables must be visible across modules
+	bool Incremental;
+
+	// Unoptimized copies of the modules of the functions given to the JIT,
+	// by function name.  The runtime functions in Options.RuntimeBitcode
+	// are added when a module first calls a function not found here.
+	std::map<std::string, std::unique_ptr<llvm::Module>> FunctionLibrary;
+	bool RuntimeBitcodeLoaded;
+
+	// Nanoseconds the JIT has spent optimizing IR and generating machine
+	// code.  These are updated from the JIT's compile threads.
+	std::atomic<uint64_t> OptimizeTime;
+	std::atomic<uint64_t> CodegenTime;
+
+	// Number of functions (not counting statements) compiled at each
+	// optimization level.  Protected by the context lock.
+	unsigned FunctionsCompiled[4];
+
+	// Tiered compilation state.  BaselineFunctions contains the names of
+	// the functions and statements to compile at the baseline level.
+	// Requests to optimize hot functions are queued to TierUpThread.
+	std::deque<TieredFunction> TieredFunctions;
+	std::set<std::string> BaselineFunctions;
+	std::thread TierUpThread;
+	std::mutex TierUpMutex;
+	std::condition_variable TierUpCond;
+	std::deque<TierUpRequest> TierUpQueue;
+	std::vector<std::string> TierUpEvents;
+	bool TierUpStop;
+
+	// Functions and top-level variables defined so far.  When JIT
+	// compiling, these may have been defined in a module other than Mod,
+	// in which case getFunction() and getVariable() declare them in Mod.
+	std::map<std::string, llvm::FunctionType*> DefinedFunctions;
+	std::set<std::string> DefinedVariables;
+
+	// Storage of the top-level variables when JIT compiling.  Variables
+	// live outside the modules of the statements assigning them, so that
+	// statements can be freed after they run.
+	std::deque<int32_t> VariableStorage;
+
+	// With lazy IR generation, the functions defined but not referenced yet
+	std::map<std::string, std::shared_ptr<FunctionDefinitionAST>> PendingFunctions;
+
+	// Optimization levels requested for individual functions with @opt(N)
+	std::map<std::string, unsigned> FunctionOptLevels;
+
+	// Values of the constants defined so far.  References to constants
+	// are compiled as immediate operands.
+	ConstantTable Constants;
+
+	bool defineConstant(const ConstantDefinitionAST & constdef);
+
+	// Statistics from the function specialization pass
+	SpecializationStats SpecStats;
+
+	// Statistics from the vectorizers, collected if
+	// Options.ReportVectorization is set
+	VectorizationStats VecStats;
+
+	llvm::Function *getFunction(const std::string & name);
+	llvm::GlobalVariable *getVariable(const std::string & name);
+	bool registerFunction(const FunctionDefinitionAST & func);
+	llvm::Function *createFunction(const FunctionDefinitionAST & func);
 	llvm::Function *generateFunctionPrototype(const FunctionDefinitionAST & func);
+	bool generatePendingFunction(const std::string & name);
 	llvm::Function *generateFunctionBodyCode(const FunctionDefinitionAST & func,
 						 bool toplevel = false);
 	bool generateProgramIR(const ProgramAST & program);
+	void runOptimizationPipeline(llvm::Module & mod, unsigned opt_level,
+				     llvm::TargetMachine *mach);
+	unsigned getFunctionOptLevel(const llvm::Function & f) const;
+	bool optimizeModule(llvm::TargetMachine *mach);
+	enum class OutputKind { ObjectFile, LLVMIR, Bitcode };
 	bool compileProgram(const ProgramAST & program,
-			    const char *out_filename, bool obj_output);
+			    const char *out_filename, OutputKind kind);
+	bool compileModule(const char *out_filename, OutputKind kind,
+			   const char *first_phase, uint64_t first_phase_time);
+	bool emitObjectFileInParallel(const char *out_filename,
+				      unsigned num_parts);
+	bool emitPartition(const llvm::SmallVectorImpl<char> & bitcode,
+			   llvm::SmallVectorImpl<char> & object);
+	bool initializeJIT();
+	void startModule();
+	bool addModuleToJIT(bool lazy,
+			    llvm::orc::ResourceTrackerSP tracker = nullptr);
+	bool allocateVariables();
+	bool loadRuntimeBitcode();
+	void importCallees(llvm::Module & mod);
+	void optimizeJITModule(llvm::Module & mod);
+	std::string getCacheParameters(unsigned level) const;
+	bool tieredCompilationEnabled() const;
+	void generateCounterIncrement(llvm::Instruction *insert_before,
+				      uint32_t *counter, TieredFunction *info);
+	void instrumentForTiering(llvm::Function & f, TieredFunction *info);
+	static void tierUpCallback(TieredFunction *info);
+	void runTierUpThread();
+	void compileOptimizedVersion(const TierUpRequest & request);
 
 	friend class LLVMCodeGeneratorVisitor;
 
 
 public:
-	LLVMBackend();
+	LLVMBackend(const LLVMBackendOptions & options = LLVMBackendOptions());
 	~LLVMBackend();
 
 	bool compileProgramToObjectFile(const ProgramAST & program,
 					const char *out_filename)
 	{
-		return compileProgram(program, out_filename, true);
+		return compileProgram(program, out_filename,
+				      OutputKind::ObjectFile);
 	}
 	bool compileProgramToLLVMIR(const ProgramAST & program,
 				    const char *out_filename)
 	{
-		return compileProgram(program, out_filename, false);
+		return compileProgram(program, out_filename,
+				      OutputKind::LLVMIR);
 	}
+
+	// Write the unoptimized IR of a program to a bitcode file, to be
+	// optimized together with other files by linkBitcodeFiles()
+	bool compileProgramToBitcode(const ProgramAST & program,
+				     const char *out_filename)
+	{
+		return compileProgram(program, out_filename,
+				      OutputKind::Bitcode);
+	}
+
+	// Link the bitcode files @files, such as those written by
+	// compileProgramToBitcode(), into one module, optimize it as a whole,
+	// and compile it to the object file @out_filename.  If @internalize is
+	// set, every function and variable except 'main' is given internal
+	// linkage first, so the object file must be the whole program.  Can't
+	// be combined with other uses of the same LLVMBackend.
+	bool linkBitcodeFiles(const std::vector<std::string> & files,
+			      bool internalize, const char *out_filename);
 	bool executeTopLevelItem(std::shared_ptr<ASTBase> top_level_item);
+
+	// Execute a whole program at once.  Like compileProgramToObjectFile(),
+	// all top-level statements are compiled into a single 'main' function,
+	// which is then JIT compiled and run.  This can't be combined with
+	// executeTopLevelItem() on the same LLVMBackend.
+	bool executeProgram(const ProgramAST & program);
+
+	// Return the address of the native code for the garter function @name,
+	// or nullptr if there is no such function.  The function must have
+	// been defined with executeTopLevelItem().  It is compiled, if needed,
+	// when first called.
+	void *getFunctionAddress(const std::string & name);
+
+	// Return the number of parameters of the garter function @name, or -1
+	// if there is no such function.
+	int getFunctionArity(const std::string & name) const;
+
+	// Return a typed pointer to the native code for the garter function
+	// @name, or nullptr if there is no such function or it doesn't take N
+	// parameters.  The pointer can be called any number of times.
+	template <size_t N>
+	NativeFunction<N> getNativeFunction(const std::string & name)
+	{
+		if (getFunctionArity(name) != (int)N)
+			return nullptr;
+		return (NativeFunction<N>)getFunctionAddress(name);
+	}
+
+	// Call the garter function @name with @args through a trampoline for
+	// its arity, and store its return value in @result.  Returns false if
+	// there is no such function, @args has the wrong number of arguments,
+	// or the function has more than MaxTrampolineArity parameters.
+	bool callFunction(const std::string & name,
+			  const std::vector<int32_t> & args, int32_t & result);
+
+	// Return the memory currently mapped for the code and data of the
+	// functions and statements JIT compiled so far.  Statements' memory is
+	// released once they have run.
+	JITMemoryUsage getJITMemoryUsage() const;
+
+	// Print statistics about JIT compilation of top-level items: amount of
+	// code compiled at each level, live JIT memory, execution counters of
+	// tiered functions, and tier-up events
+	void printJITStatistics(std::ostream & os);
 };
 
 } // End garter namespace
@@ -0,0 +1,240 @@
+#include <backend/Profile.h>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/ProfileSummary.h>
+#include <llvm/ProfileData/InstrProf.h>
+#include <llvm/ProfileData/ProfileCommon.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+#include <algorithm>
+#include <ctype.h>
+#include <iostream>
+#include <sstream>
+
+using namespace garter;
+using namespace llvm;
+
+// Return the conditional branches of @f, in the order their counters are laid
+// out
+static std::vector<BranchInst*> getConditionalBranches(Function & f)
+{
+	std::vector<BranchInst*> branches;
+	for (BasicBlock & block : f) {
+		BranchInst *br = dyn_cast<BranchInst>(block.getTerminator());
+		if (br != nullptr && br->isConditional())
+			branches.push_back(br);
+	}
+	return branches;
+}
+
+// Return the name of @f in profiles.  Names are separated from the counts by
+// spaces and from each other by newlines, so those characters, and '%', are
+// written as '%' followed by their code in hexadecimal.
+static std::string getProfileName(const std::string & source_name,
+				  const Function & f)
+{
+	const std::string name = source_name + ":" + f.getName().str();
+	std::string escaped;
+
+	for (unsigned char c : name) {
+		if (c == '%' || isspace(c)) {
+			static const char hex[] = "0123456789ABCDEF";
+			escaped += '%';
+			escaped += hex[c >> 4];
+			escaped += hex[c & 15];
+		} else {
+			escaped += c;
+		}
+	}
+	return escaped;
+}
+
+// Each function has an entry counter, then two counters for each conditional
+// branch: the times it went to its first and to its second successor.
+void garter::instrumentForProfiling(Module & mod, const std::string & source_name)
+{
+	LLVMContext & ctx = mod.getContext();
+	IRBuilder<> builder(ctx);
+	Type *int64_ty = builder.getInt64Ty();
+
+	std::vector<std::pair<Function*, std::vector<BranchInst*>>> functions;
+	std::string layout;
+	unsigned num_counters = 0;
+
+	for (Function & f : mod) {
+		if (f.isDeclaration())
+			continue;
+		functions.emplace_back(&f, getConditionalBranches(f));
+		const unsigned n = 1 + 2 * functions.back().second.size();
+		layout += getProfileName(source_name, f) + " " +
+			  std::to_string(n) + "\n";
+		num_counters += n;
+	}
+	if (num_counters == 0)
+		return;
+
+	ArrayType *counters_ty = ArrayType::get(int64_ty, num_counters);
+	GlobalVariable *counters = new GlobalVariable(
+			mod, counters_ty, false, GlobalValue::InternalLinkage,
+			ConstantAggregateZero::get(counters_ty),
+			"__garter_profile_counters");
+
+	auto add_to_counter = [&](unsigned index, Value *amount) {
+		Value *ptr = builder.CreateConstInBoundsGEP2_32(counters_ty,
+								counters, 0, index);
+		Value *count = builder.CreateLoad(int64_ty, ptr);
+		builder.CreateStore(builder.CreateAdd(count, amount), ptr);
+	};
+
+	unsigned index = 0;
+	for (auto & entry : functions) {
+		// Keep the allocas at the start of the entry block
+		BasicBlock & entry_block = entry.first->getEntryBlock();
+		auto it = entry_block.begin();
+		while (isa<AllocaInst>(*it))
+			++it;
+		builder.SetInsertPoint(&entry_block, it);
+		add_to_counter(index++, builder.getInt64(1));
+
+		for (BranchInst *br : entry.second) {
+			builder.SetInsertPoint(br);
+			Value *first = builder.CreateZExt(br->getCondition(), int64_ty);
+			add_to_counter(index++, first);
+			add_to_counter(index++, builder.CreateSub(builder.getInt64(1),
+								  first));
+		}
+	}
+
+	// Register the counters with the runtime library when the program
+	// starts
+	FunctionType *register_ty = FunctionType::get(
+			builder.getVoidTy(),
+			{ builder.getInt8PtrTy(), int64_ty->getPointerTo() }, false);
+	FunctionCallee register_func = mod.getOrInsertFunction(
+			"__garter_profile_register", register_ty);
+
+	Function *ctor = Function::Create(FunctionType::get(builder.getVoidTy(), false),
+					  GlobalValue::InternalLinkage,
+					  "__garter_profile_init", mod);
+	builder.SetInsertPoint(BasicBlock::Create(ctx, "", ctor));
+	builder.CreateCall(register_func, {
+		builder.CreateGlobalStringPtr(layout, "__garter_profile_layout"),
+		builder.CreateConstInBoundsGEP2_32(counters_ty, counters, 0, 0),
+	});
+	builder.CreateRetVoid();
+	appendToGlobalCtors(mod, ctor, 0);
+}
+
+ProfileData::ProfileData()
+{
+}
+
+ProfileData::~ProfileData()
+{
+}
+
+bool ProfileData::read(const std::string & filename)
+{
+	ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(filename);
+	if (!buffer) {
+		std::cerr << "ERROR: can't read profile " << filename << ": "
+			  << buffer.getError().message() << std::endl;
+		return false;
+	}
+
+	InstrProfSummaryBuilder summary_builder(ProfileSummaryBuilder::DefaultCutoffs);
+
+	std::istringstream is((*buffer)->getBuffer().str());
+	std::string line;
+	unsigned line_number = 0;
+	while (std::getline(is, line)) {
+		line_number++;
+		std::istringstream fields(line);
+		std::string name;
+		std::vector<uint64_t> counts;
+		uint64_t count;
+
+		if (!(fields >> name))
+			continue;
+		while (fields >> count)
+			counts.push_back(count);
+		if (!fields.eof() || counts.empty()) {
+			std::cerr << "ERROR: " << filename << ":" << line_number
+				  << ": invalid profile record" << std::endl;
+			return false;
+		}
+
+		summary_builder.addRecord(InstrProfRecord(counts));
+		Functions[name] = std::move(counts);
+	}
+
+	// The optimizer estimates the counts of blocks from the entry counts
+	// and branch weights, and its estimates of the hottest blocks come out
+	// slightly below their real counts.  In a profile dominated by a few
+	// loops, the hot and cold thresholds can both be the count of the
+	// hottest loop, which would then look cold.  So the thresholds are
+	// lowered a little.
+	std::unique_ptr<ProfileSummary> summary = summary_builder.getSummary();
+	SummaryEntryVector detailed;
+	for (const ProfileSummaryEntry & entry : summary->getDetailedSummary())
+		detailed.emplace_back(entry.Cutoff,
+				      entry.MinCount - entry.MinCount / 32,
+				      entry.NumCounts);
+	Summary.reset(new ProfileSummary(ProfileSummary::PSK_Instr, detailed,
+					 summary->getTotalCount(),
+					 summary->getMaxCount(),
+					 summary->getMaxInternalCount(),
+					 summary->getMaxFunctionCount(),
+					 summary->getNumCounts(),
+					 summary->getNumFunctions()));
+	return true;
+}
+
+unsigned ProfileData::annotate(Module & mod, const std::string & source_name) const
+{
+	MDBuilder md_builder(mod.getContext());
+	unsigned annotated = 0;
+
+	for (Function & f : mod) {
+		if (f.isDeclaration())
+			continue;
+
+		auto it = Functions.find(getProfileName(source_name, f));
+		if (it == Functions.end())
+			continue;
+		const std::vector<uint64_t> & counts = it->second;
+
+		std::vector<BranchInst*> branches = getConditionalBranches(f);
+		if (counts.size() != 1 + 2 * branches.size()) {
+			std::cerr << "WARNING: the profile of " << it->first
+				  << " doesn't match its code; ignoring it"
+				  << std::endl;
+			continue;
+		}
+
+		f.setEntryCount(Function::ProfileCount(counts[0], Function::PCT_Real));
+		for (size_t i = 0; i < branches.size(); i++) {
+			const uint64_t first = counts[1 + 2 * i];
+			const uint64_t second = counts[2 + 2 * i];
+			if (first == 0 && second == 0)
+				continue;
+			// Branch weights are 32-bit, so the counts are
+			// scaled down to fit.
+			const uint64_t scale = std::max(first, second) / UINT32_MAX + 1;
+			branches[i]->setMetadata(LLVMContext::MD_prof,
+				md_builder.createBranchWeights(first / scale,
+							       second / scale));
+		}
+		annotated++;
+	}
+
+	// The summary tells which counts are hot and cold in the whole program
+	if (annotated != 0)
+		mod.setProfileSummary(Summary->getMD(mod.getContext()),
+				      ProfileSummary::PSK_Instr);
+	return annotated;
+}
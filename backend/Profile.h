@@ -0,0 +1,61 @@
+#ifndef _GARTER_PROFILE_H_
+#define _GARTER_PROFILE_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+	class Module;
+	class ProfileSummary;
+};
+
+namespace garter {
+
+// Profile-guided optimization.  A program compiled with profile instrumentation
+// counts how often each function is entered and which way each conditional
+// branch goes, and the runtime library adds the counts to a profile file when
+// the program exits (see runtime/profile.cc).  When the program is compiled
+// again with that profile, the counts are attached to the IR as function entry
+// counts and branch weights, together with a summary of the whole profile, so
+// that the optimizer knows which code is hot: inlining, block placement and
+// the placement of cold functions then follow the real workload.
+//
+// Both steps are applied to the unoptimized IR of a source file.  Functions are
+// named in profiles by the source file's name and the function's name, with
+// whitespace and '%' escaped as "%XX", and
+// their counters are matched with the IR by order, so a function whose code
+// changed since its profile was collected is left without profile data.
+
+// Add profile counters to the functions defined in @mod, which was generated
+// from the source file @source_name, and a constructor registering them with
+// the runtime library.  The IR must not have been optimized yet.
+void instrumentForProfiling(llvm::Module & mod, const std::string & source_name);
+
+// Counts read from a profile file
+class ProfileData {
+private:
+	// Counters of each function, by "<source file>:<function>"
+	std::map<std::string, std::vector<uint64_t>> Functions;
+
+	std::unique_ptr<llvm::ProfileSummary> Summary;
+
+public:
+	ProfileData();
+	~ProfileData();
+
+	// Read the profile file @filename.  Returns false after printing an
+	// error message on failure.
+	bool read(const std::string & filename);
+
+	// Attach the counts of the functions of @mod, generated from the
+	// source file @source_name, to its unoptimized IR.  Functions without
+	// profile data are left alone.  Returns the number of functions
+	// annotated.
+	unsigned annotate(llvm::Module & mod, const std::string & source_name) const;
+};
+
+} // End garter namespace
+
+#endif /* _GARTER_PROFILE_H_ */
@@ -0,0 +1,863 @@
+#include <backend/TemplateJITBackend.h>
+#include <frontend/Parser.h>
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+using namespace garter;
+
+// Machine code template: bytes copied as is, except for one operand (a 32-bit
+// immediate or displacement, or a 64-bit address) patched in at offset Hole
+struct CodeTemplate {
+	std::vector<uint8_t> Bytes;
+	int Hole;
+};
+
+// The x86-64 templates.  The value of an expression is computed in %eax; the
+// right operand of a binary operator is loaded into %ecx.
+static const CodeTemplate LoadConstant = {		// mov $imm32, %eax
+	{0xB8, 0, 0, 0, 0}, 1 };
+static const CodeTemplate LoadLocal = {			// mov disp32(%rbp), %eax
+	{0x8B, 0x85, 0, 0, 0, 0}, 2 };
+static const CodeTemplate StoreLocal = {		// mov %eax, disp32(%rbp)
+	{0x89, 0x85, 0, 0, 0, 0}, 2 };
+static const CodeTemplate ZeroLocal = {			// movl $0, disp32(%rbp)
+	{0xC7, 0x85, 0, 0, 0, 0, 0, 0, 0, 0}, 2 };
+static const CodeTemplate LoadGlobal = {		// movabs addr64, %eax
+	{0xA1, 0, 0, 0, 0, 0, 0, 0, 0}, 1 };
+static const CodeTemplate StoreGlobal = {		// movabs %eax, addr64
+	{0xA3, 0, 0, 0, 0, 0, 0, 0, 0}, 1 };
+static const CodeTemplate LoadOperandConstant = {	// mov $imm32, %ecx
+	{0xB9, 0, 0, 0, 0}, 1 };
+static const CodeTemplate LoadOperandLocal = {		// mov disp32(%rbp), %ecx
+	{0x8B, 0x8D, 0, 0, 0, 0}, 2 };
+static const CodeTemplate PushValue = {			// push %rax
+	{0x50}, -1 };
+static const CodeTemplate PopOperand = {		// mov %eax, %ecx; pop %rax
+	{0x89, 0xC1, 0x58}, -1 };
+
+// Operations of BinaryExpressionAST, in the order of BinaryOp, on %eax and %ecx.
+// Exponentiate is compiled as a call.
+static const CodeTemplate BinaryOperations[] = {
+	// Or: or %ecx, %eax; setne %al; movzbl %al, %eax
+	{ {0x09, 0xC8, 0x0F, 0x95, 0xC0, 0x0F, 0xB6, 0xC0}, -1 },
+	// And: test %eax, %eax; setne %al; test %ecx, %ecx; setne %cl;
+	// and %cl, %al; movzbl %al, %eax
+	{ {0x85, 0xC0, 0x0F, 0x95, 0xC0, 0x85, 0xC9, 0x0F, 0x95, 0xC1,
+	   0x20, 0xC8, 0x0F, 0xB6, 0xC0}, -1 },
+	// Comparisons: cmp %ecx, %eax; setCC %al; movzbl %al, %eax
+	{ {0x39, 0xC8, 0x0F, 0x9C, 0xC0, 0x0F, 0xB6, 0xC0}, -1 },	// setl
+	{ {0x39, 0xC8, 0x0F, 0x9F, 0xC0, 0x0F, 0xB6, 0xC0}, -1 },	// setg
+	{ {0x39, 0xC8, 0x0F, 0x9E, 0xC0, 0x0F, 0xB6, 0xC0}, -1 },	// setle
+	{ {0x39, 0xC8, 0x0F, 0x9D, 0xC0, 0x0F, 0xB6, 0xC0}, -1 },	// setge
+	{ {0x39, 0xC8, 0x0F, 0x94, 0xC0, 0x0F, 0xB6, 0xC0}, -1 },	// sete
+	{ {0x39, 0xC8, 0x0F, 0x95, 0xC0, 0x0F, 0xB6, 0xC0}, -1 },	// setne
+	{ {0x09, 0xC8}, -1 },				// or %ecx, %eax
+	{ {0x31, 0xC8}, -1 },				// xor %ecx, %eax
+	{ {0x21, 0xC8}, -1 },				// and %ecx, %eax
+	{ {0xD3, 0xE0}, -1 },				// shl %cl, %eax
+	{ {0xD3, 0xF8}, -1 },				// sar %cl, %eax
+	{ {0x01, 0xC8}, -1 },				// add %ecx, %eax
+	{ {0x29, 0xC8}, -1 },				// sub %ecx, %eax
+	{ {0x0F, 0xAF, 0xC1}, -1 },			// imul %ecx, %eax
+	// Like native code, division by zero traps.
+	{ {0x99, 0xF7, 0xF9}, -1 },			// cltd; idiv %ecx
+	{ {0x99, 0xF7, 0xF9, 0x89, 0xD0}, -1 },		// cltd; idiv %ecx; mov %edx, %eax
+};
+
+static const CodeTemplate NotOperation = {	// test %eax, %eax; sete %al; movzbl %al, %eax
+	{0x85, 0xC0, 0x0F, 0x94, 0xC0, 0x0F, 0xB6, 0xC0}, -1 };
+static const CodeTemplate MinusOperation = {	// neg %eax
+	{0xF7, 0xD8}, -1 };
+static const CodeTemplate BitwiseNotOperation = {	// not %eax
+	{0xF7, 0xD0}, -1 };
+static const CodeTemplate BswapOperation = {	// bswap %eax
+	{0x0F, 0xC8}, -1 };
+
+// Jumps, whose hole is the offset of the target from the end of the jump
+static const CodeTemplate Jump = {			// jmp rel32
+	{0xE9, 0, 0, 0, 0}, 1 };
+static const CodeTemplate JumpIfZero = {		// test %eax, %eax; jz rel32
+	{0x85, 0xC0, 0x0F, 0x84, 0, 0, 0, 0}, 4 };
+static const CodeTemplate JumpIfNonZero = {		// test %eax, %eax; jnz rel32
+	{0x85, 0xC0, 0x0F, 0x85, 0, 0, 0, 0}, 4 };
+// Comparisons of %eax with %ecx, in the order of BinaryOp:
+// cmp %ecx, %eax; jCC rel32
+static const CodeTemplate CompareAndJump[] = {
+	{ {0x39, 0xC8, 0x0F, 0x8C, 0, 0, 0, 0}, 4 },	// jl
+	{ {0x39, 0xC8, 0x0F, 0x8F, 0, 0, 0, 0}, 4 },	// jg
+	{ {0x39, 0xC8, 0x0F, 0x8E, 0, 0, 0, 0}, 4 },	// jle
+	{ {0x39, 0xC8, 0x0F, 0x8D, 0, 0, 0, 0}, 4 },	// jge
+	{ {0x39, 0xC8, 0x0F, 0x84, 0, 0, 0, 0}, 4 },	// je
+	{ {0x39, 0xC8, 0x0F, 0x85, 0, 0, 0, 0}, 4 },	// jne
+};
+
+// Call the C++ function at addr64 with the stack aligned as the ABI requires.
+// %r12 is preserved by the callee.
+// mov %rsp, %r12; and $-16, %rsp; movabs $addr64, %rax; call *%rax; mov %r12, %rsp
+static const CodeTemplate CallHelper = {
+	{0x49, 0x89, 0xE4, 0x48, 0x83, 0xE4, 0xF0, 0x48, 0xB8,
+	 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xD0, 0x4C, 0x89, 0xE4}, 9 };
+static const CodeTemplate MoveHelperArgument = {	// mov %eax, %edi
+	{0x89, 0xC7}, -1 };
+static const CodeTemplate MoveHelperArguments = {	// mov %eax, %edi; mov %ecx, %esi
+	{0x89, 0xC7, 0x89, 0xCE}, -1 };
+static const CodeTemplate MovePrintArguments = {	// mov %rsp, %rdi; mov $imm32, %esi
+	{0x48, 0x89, 0xE7, 0xBE, 0, 0, 0, 0}, 4 };
+
+// Call a garter function through the pointer to its code at addr64, then pop
+// its arguments
+static const CodeTemplate CallFunction = {		// movabs $addr64, %rax; call *(%rax)
+	{0x48, 0xB8, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0x10}, 2 };
+static const CodeTemplate PopArguments = {		// add $imm32, %rsp
+	{0x48, 0x81, 0xC4, 0, 0, 0, 0}, 3 };
+
+// Function entry: set up a frame of imm32 bytes and zero it.  %rdi and %ecx
+// are free since garter functions take their arguments on the stack.
+// push %rbp; mov %rsp, %rbp; sub $imm32, %rsp
+static const CodeTemplate Prologue = {
+	{0x55, 0x48, 0x89, 0xE5, 0x48, 0x81, 0xEC, 0, 0, 0, 0}, 7 };
+// mov %rsp, %rdi; mov $imm32, %ecx; xor %eax, %eax; rep stosq
+static const CodeTemplate ZeroFrame = {
+	{0x48, 0x89, 0xE7, 0xB9, 0, 0, 0, 0, 0x31, 0xC0, 0xF3, 0x48, 0xAB}, 4 };
+static const CodeTemplate Epilogue = {			// leave; ret
+	{0xC9, 0xC3}, -1 };
+static const CodeTemplate ReturnZero = {		// xor %eax, %eax; leave; ret
+	{0x31, 0xC0, 0xC9, 0xC3}, -1 };
+
+// Entry and exit of the code of top-level statements, which is called from C++
+// and so must preserve %r12.  push %rbp; mov %rsp, %rbp; push %r12; push %r12
+static const CodeTemplate TopLevelPrologue = {
+	{0x55, 0x48, 0x89, 0xE5, 0x41, 0x54, 0x41, 0x54}, -1 };
+// mov -8(%rbp), %r12; leave; ret
+static const CodeTemplate TopLevelEpilogue = {
+	{0x4C, 0x8B, 0x65, 0xF8, 0xC9, 0xC3}, -1 };
+
+
+// Functions called by the generated code
+static void printValues(const int64_t *values, int32_t count)
+{
+	// The arguments were pushed in order, so the first is at the highest
+	// address.  Print them the same way as __garter_print() in the runtime
+	// library.
+	for (int32_t i = 0; i < count; i++)
+		printf(i == 0 ? "%d" : " %d", (int32_t)values[count - 1 - i]);
+	putchar('\n');
+}
+
+static int32_t popcountHelper(uint32_t arg)
+{
+	return __builtin_popcount(arg);
+}
+
+static int32_t clzHelper(uint32_t arg)
+{
+	return (arg == 0) ? 32 : __builtin_clz(arg);
+}
+
+static int32_t ctzHelper(uint32_t arg)
+{
+	return (arg == 0) ? 32 : __builtin_ctz(arg);
+}
+
+namespace garter {
+
+// A function defined by the program
+struct TemplateJITFunction : public InterpreterFunction {
+	// Address of the function's machine code.  Calls to the function load
+	// it from here, so that they can be compiled before the function is.
+	void *Code;
+
+	TemplateJITFunction(std::shared_ptr<FunctionDefinitionAST> definition)
+		: InterpreterFunction(definition), Code(nullptr)
+	{
+	}
+};
+
+// Region of memory in which machine code is installed.  The region is only
+// writable while code is being copied into it.
+class ExecutableMemory {
+private:
+	uint8_t *Base;
+	size_t Size;
+	size_t Used;
+
+public:
+	ExecutableMemory(size_t size)
+		: Size(size), Used(0)
+	{
+		void *p = mmap(nullptr, size, PROT_READ | PROT_EXEC,
+			       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		Base = (p == MAP_FAILED) ? nullptr : (uint8_t *)p;
+	}
+
+	~ExecutableMemory()
+	{
+		if (Base != nullptr)
+			munmap(Base, Size);
+	}
+
+	bool isValid() const
+	{
+		return Base != nullptr;
+	}
+
+	size_t getAvailable() const
+	{
+		return Size - Used;
+	}
+
+	void clear()
+	{
+		Used = 0;
+	}
+
+	// Copy @code into the region and return its address, or nullptr if it
+	// doesn't fit
+	void *install(const std::vector<uint8_t> & code)
+	{
+		if (code.size() > getAvailable())
+			return nullptr;
+		if (mprotect(Base, Size, PROT_READ | PROT_WRITE) != 0)
+			return nullptr;
+		uint8_t *addr = Base + Used;
+		memcpy(addr, code.data(), code.size());
+		mprotect(Base, Size, PROT_READ | PROT_EXEC);
+		Used += (code.size() + 15) & ~(size_t)15;
+		Used = std::min(Used, Size);
+		return addr;
+	}
+};
+
+// StatementAST and ExpressionAST visitor that generates the machine code of a
+// function body or of top-level statements.  On failure, an error message is
+// printed.
+class TemplateJITCompiler : public StatementASTVisitor,
+			    public ExpressionASTVisitor {
+private:
+	TemplateJITBackend & Backend;
+
+	// Function being compiled, or nullptr for top-level statements
+	TemplateJITFunction *Function;
+
+	std::vector<uint8_t> Code;
+
+	// Frame offsets (from %rbp) of the local variables seen so far, and
+	// number of local variables that aren't parameters
+	std::map<std::string, int32_t> Slots;
+	int32_t NumLocals;
+
+	// Offset of the hole for the frame size in the prologue, and of the
+	// hole for the number of 8-byte words to zero
+	size_t FrameSizeHole;
+	size_t ZeroCountHole;
+
+	// For each enclosing loop, the offset of the code testing its
+	// condition and the holes of the jumps of its 'break' statements
+	struct Loop {
+		size_t Top;
+		std::vector<size_t> Breaks;
+	};
+	std::vector<Loop> Loops;
+
+	// Used to return whether an expression or statement was successfully
+	// compiled
+	bool ExpressionSuccessful;
+	bool StatementSuccessful;
+
+	size_t emit(const CodeTemplate & t)
+	{
+		size_t start = Code.size();
+		Code.insert(Code.end(), t.Bytes.begin(), t.Bytes.end());
+		return start;
+	}
+
+	// Emit @t with @operand patched into its hole, and return the offset
+	// of the hole
+	size_t emit(const CodeTemplate & t, int32_t operand)
+	{
+		size_t hole = emit(t) + t.Hole;
+		memcpy(&Code[hole], &operand, sizeof(operand));
+		return hole;
+	}
+
+	size_t emit(const CodeTemplate & t, const void *operand)
+	{
+		size_t hole = emit(t) + t.Hole;
+		uint64_t addr = (uintptr_t)operand;
+		memcpy(&Code[hole], &addr, sizeof(addr));
+		return hole;
+	}
+
+	void patch(size_t hole, int32_t value)
+	{
+		memcpy(&Code[hole], &value, sizeof(value));
+	}
+
+	// Make the jump whose hole is at @hole jump to @target
+	void patchJump(size_t hole, size_t target)
+	{
+		patch(hole, (int32_t)target - (int32_t)(hole + 4));
+	}
+	void patchJump(size_t hole)
+	{
+		patchJump(hole, Code.size());
+	}
+
+	void emitHelperCall(const void *helper)
+	{
+		emit(CallHelper, helper);
+	}
+
+	int32_t allocateLocal(const std::string & name)
+	{
+		int32_t offset = -4 * ++NumLocals;
+		Slots[name] = offset;
+		return offset;
+	}
+
+	bool compileOperand(ExpressionAST & expr);
+	bool compileJump(ExpressionAST & cond, bool jump_if, size_t & hole);
+	void compileBuiltinCall(CallExpressionAST & expr);
+public:
+	TemplateJITCompiler(TemplateJITBackend & backend,
+			    TemplateJITFunction *function);
+
+	bool compile(ExpressionAST & expr)
+	{
+		ExpressionSuccessful = false;
+		expr.acceptVisitor(*this);
+		return ExpressionSuccessful;
+	}
+
+	bool compile(const std::vector<std::shared_ptr<StatementAST>> & stmts);
+	const std::vector<uint8_t> & finish();
+
+	void visit(AssignmentStatementAST &);
+	void visit(BreakStatementAST &);
+	void visit(ContinueStatementAST &);
+	void visit(ExpressionStatementAST &);
+	void visit(IfStatementAST &);
+	void visit(PassStatementAST &);
+	void visit(PrintStatementAST &);
+	void visit(ReturnStatementAST &);
+	void visit(WhileStatementAST &);
+
+	void visit(BinaryExpressionAST &);
+	void visit(CallExpressionAST &);
+	void visit(NumberExpressionAST &);
+	void visit(UnaryExpressionAST &);
+	void visit(VariableExpressionAST &);
+};
+
+} // End garter namespace
+
+// Parameters are at positive offsets from %rbp: the caller pushed them in
+// order, followed by the return address and the saved %rbp.  Other local
+// variables are at negative offsets.
+TemplateJITCompiler::TemplateJITCompiler(TemplateJITBackend & backend,
+					 TemplateJITFunction *function)
+	: Backend(backend), Function(function), NumLocals(0),
+	  FrameSizeHole(0), ZeroCountHole(0),
+	  ExpressionSuccessful(false), StatementSuccessful(false)
+{
+	if (Function == nullptr) {
+		emit(TopLevelPrologue);
+		return;
+	}
+
+	const std::vector<std::string> & params = Function->Definition->Parameters;
+	for (size_t i = 0; i < params.size(); i++)
+		Slots[params[i]] = 16 + 8 * (params.size() - 1 - i);
+	FrameSizeHole = emit(Prologue, 0);
+	ZeroCountHole = emit(ZeroFrame, 0);
+}
+
+// Compile the statements @stmts, appending their code
+bool TemplateJITCompiler::compile(const std::vector<std::shared_ptr<StatementAST>> & stmts)
+{
+	for (auto stmtptr : stmts) {
+		stmtptr->acceptVisitor(*this);
+		if (!StatementSuccessful)
+			return false;
+	}
+	return true;
+}
+
+// Return 0 if the end of the code is reached, fill in the frame size, and
+// return the code.  Functions without local variables other than their
+// parameters don't zero their frame.
+const std::vector<uint8_t> & TemplateJITCompiler::finish()
+{
+	if (Function == nullptr) {
+		emit(LoadConstant, 0);
+		emit(TopLevelEpilogue);
+	} else {
+		int32_t frame_size = (4 * NumLocals + 15) & ~15;
+		emit(ReturnZero);
+		patch(FrameSizeHole, frame_size);
+		patch(ZeroCountHole, frame_size / 8);
+		if (frame_size == 0) {
+			// Skip the zeroing entirely: jmp over the rest of it
+			size_t start = ZeroCountHole - ZeroFrame.Hole;
+			Code[start] = 0xEB;
+			Code[start + 1] = ZeroFrame.Bytes.size() - 2;
+		}
+	}
+	return Code;
+}
+
+// Load the value of @expr into %ecx, preserving %eax.  Numbers, constants and
+// local variables are loaded directly.
+bool TemplateJITCompiler::compileOperand(ExpressionAST & expr)
+{
+	auto number = dynamic_cast<NumberExpressionAST*>(&expr);
+	auto var = dynamic_cast<VariableExpressionAST*>(&expr);
+
+	if (number != nullptr) {
+		emit(LoadOperandConstant, number->Number);
+		return true;
+	}
+	if (var != nullptr) {
+		auto const_it = Backend.Constants.find(var->Name);
+		if (const_it != Backend.Constants.end()) {
+			emit(LoadOperandConstant, const_it->second);
+			return true;
+		}
+		auto it = Slots.find(var->Name);
+		if (Function != nullptr && it != Slots.end()) {
+			emit(LoadOperandLocal, it->second);
+			return true;
+		}
+	}
+
+	emit(PushValue);
+	if (!compile(expr))
+		return false;
+	emit(PopOperand);
+	return true;
+}
+
+// Emit code evaluating @cond followed by a jump, taken if the condition is true
+// (if @jump_if) or false (otherwise), whose target is left to patch.  The
+// offset of the jump's hole is stored in @hole.  Comparisons jump directly on
+// the flags.
+bool TemplateJITCompiler::compileJump(ExpressionAST & cond, bool jump_if, size_t & hole)
+{
+	static const int Negations[] = { 3, 2, 1, 0, 5, 4 };
+	auto binary = dynamic_cast<BinaryExpressionAST*>(&cond);
+	auto unary = dynamic_cast<UnaryExpressionAST*>(&cond);
+
+	if (binary && binary->Op >= BinaryExpressionAST::LessThan &&
+	    binary->Op <= BinaryExpressionAST::NotEqualTo)
+	{
+		int comparison = binary->Op - BinaryExpressionAST::LessThan;
+
+		if (!jump_if)
+			comparison = Negations[comparison];
+		if (!compile(*binary->LHS) || !compileOperand(*binary->RHS))
+			return false;
+		hole = emit(CompareAndJump[comparison], 0);
+		return true;
+	}
+	if (unary && unary->Op == UnaryExpressionAST::Not)
+		return compileJump(*unary->Expression, !jump_if, hole);
+
+	if (!compile(cond))
+		return false;
+	hole = emit(jump_if ? JumpIfNonZero : JumpIfZero, 0);
+	return true;
+}
+
+void TemplateJITCompiler::visit(AssignmentStatementAST & stmt)
+{
+	const std::string & name = stmt.Variable->Name;
+
+	StatementSuccessful = false;
+	if (Backend.Constants.count(name)) {
+		std::cerr << "ERROR: Cannot assign to constant " << name << std::endl;
+		return;
+	}
+
+	if (Function == nullptr) {
+		int32_t *variable = Backend.getGlobalVariable(name);
+		if (!compile(*stmt.Expression))
+			return;
+		emit(StoreGlobal, variable);
+		StatementSuccessful = true;
+		return;
+	}
+
+	auto it = Slots.find(name);
+	int32_t offset;
+	if (it == Slots.end()) {
+		// The assigned value may refer to the variable being declared.
+		offset = allocateLocal(name);
+		emit(ZeroLocal, offset);
+	} else {
+		offset = it->second;
+	}
+	if (!compile(*stmt.Expression))
+		return;
+	emit(StoreLocal, offset);
+	StatementSuccessful = true;
+}
+
+void TemplateJITCompiler::visit(BreakStatementAST & stmt __attribute__((unused)))
+{
+	if (Loops.empty()) {
+		std::cerr << "ERROR: break statement not in loop" << std::endl;
+		StatementSuccessful = false;
+	} else {
+		Loops.back().Breaks.push_back(emit(Jump, 0));
+		StatementSuccessful = true;
+	}
+}
+
+void TemplateJITCompiler::visit(ContinueStatementAST & stmt __attribute__((unused)))
+{
+	if (Loops.empty()) {
+		std::cerr << "ERROR: continue statement not in loop" << std::endl;
+		StatementSuccessful = false;
+	} else {
+		patchJump(emit(Jump, 0), Loops.back().Top);
+		StatementSuccessful = true;
+	}
+}
+
+void TemplateJITCompiler::visit(ExpressionStatementAST & stmt)
+{
+	StatementSuccessful = compile(*stmt.Expression);
+}
+
+void TemplateJITCompiler::visit(IfStatementAST & stmt)
+{
+	std::vector<size_t> jumps_to_end;
+
+	StatementSuccessful = false;
+	for (size_t i = 0; i <= stmt.ElifClauses.size(); i++) {
+		ExpressionAST & cond = (i == 0) ? *stmt.Condition :
+					*stmt.ElifClauses[i - 1]->Condition;
+		const std::vector<std::shared_ptr<StatementAST>> & body =
+			(i == 0) ? stmt.Body : stmt.ElifClauses[i - 1]->Body;
+		size_t jump_to_next;
+
+		if (!compileJump(cond, false, jump_to_next))
+			return;
+		if (!compile(body))
+			return;
+		if (i < stmt.ElifClauses.size() || !stmt.ElseBody.empty())
+			jumps_to_end.push_back(emit(Jump, 0));
+		patchJump(jump_to_next);
+	}
+	if (!compile(stmt.ElseBody))
+		return;
+	for (size_t hole : jumps_to_end)
+		patchJump(hole);
+	StatementSuccessful = true;
+}
+
+void TemplateJITCompiler::visit(PassStatementAST & stmt __attribute__((unused)))
+{
+	StatementSuccessful = true;
+}
+
+// The arguments are pushed, then printed by a helper
+void TemplateJITCompiler::visit(PrintStatementAST & stmt)
+{
+	const int32_t num_args = stmt.Arguments.size();
+
+	StatementSuccessful = false;
+	for (auto exprptr : stmt.Arguments) {
+		if (!compile(*exprptr))
+			return;
+		emit(PushValue);
+	}
+	emit(MovePrintArguments, num_args);
+	emitHelperCall((const void *)printValues);
+	if (num_args != 0)
+		emit(PopArguments, 8 * num_args);
+	StatementSuccessful = true;
+}
+
+void TemplateJITCompiler::visit(ReturnStatementAST & stmt)
+{
+	StatementSuccessful = false;
+	if (!compile(*stmt.Expression))
+		return;
+	emit(Function == nullptr ? TopLevelEpilogue : Epilogue);
+	StatementSuccessful = true;
+}
+
+void TemplateJITCompiler::visit(WhileStatementAST & stmt)
+{
+	size_t exit_jump;
+
+	StatementSuccessful = false;
+	Loops.push_back({Code.size(), {}});
+	if (!compileJump(*stmt.Condition, false, exit_jump))
+		return;
+	if (!compile(stmt.Body))
+		return;
+	patchJump(emit(Jump, 0), Loops.back().Top);
+	patchJump(exit_jump);
+	for (size_t hole : Loops.back().Breaks)
+		patchJump(hole);
+	Loops.pop_back();
+	StatementSuccessful = true;
+}
+
+void TemplateJITCompiler::visit(BinaryExpressionAST & expr)
+{
+	if (!compile(*expr.LHS) || !compileOperand(*expr.RHS)) {
+		ExpressionSuccessful = false;
+		return;
+	}
+
+	if (expr.Op == BinaryExpressionAST::In ||
+	    expr.Op == BinaryExpressionAST::NotIn)
+	{
+		std::cerr << "ERROR: Operator " << expr.getOpStr()
+			  << " is not supported" << std::endl;
+		ExpressionSuccessful = false;
+		return;
+	}
+	if (expr.Op == BinaryExpressionAST::Exponentiate) {
+		emit(MoveHelperArguments);
+		emitHelperCall((const void *)exponentiate);
+	} else {
+		emit(BinaryOperations[expr.Op]);
+	}
+	ExpressionSuccessful = true;
+}
+
+// Builtin functions, each taking one argument.  Helper is nullptr for functions
+// compiled inline.
+static const struct {
+	const char *Name;
+	const void *Helper;
+} Builtins[] = {
+	{"popcount", (const void *)popcountHelper},
+	{"clz",      (const void *)clzHelper},
+	{"ctz",      (const void *)ctzHelper},
+	{"bswap",    nullptr},
+};
+
+// If the call expression @expr names a builtin function, compile the call.
+// Otherwise report an unknown function.
+void TemplateJITCompiler::compileBuiltinCall(CallExpressionAST & expr)
+{
+	ExpressionSuccessful = false;
+	for (const auto & builtin : Builtins) {
+		if (expr.Callee != builtin.Name)
+			continue;
+
+		if (expr.Arguments.size() != 1) {
+			std::cerr << "ERROR: Wrong number of arguments to "
+				  << expr.Callee << std::endl;
+			return;
+		}
+		if (!compile(*expr.Arguments[0]))
+			return;
+		if (builtin.Helper == nullptr) {
+			emit(BswapOperation);
+		} else {
+			emit(MoveHelperArgument);
+			emitHelperCall(builtin.Helper);
+		}
+		ExpressionSuccessful = true;
+		return;
+	}
+
+	std::cerr << "ERROR: Unknown function " << expr.Callee << std::endl;
+}
+
+// The arguments are pushed in order and popped by the caller.
+void TemplateJITCompiler::visit(CallExpressionAST & expr)
+{
+	TemplateJITFunction *callee =
+		static_cast<TemplateJITFunction*>(Backend.getFunction(expr.Callee));
+
+	// Functions not defined by the program may name a builtin
+	if (callee == nullptr) {
+		compileBuiltinCall(expr);
+		return;
+	}
+
+	ExpressionSuccessful = false;
+	if (callee->Definition->Parameters.size() != expr.Arguments.size()) {
+		std::cerr << "ERROR: Wrong number of arguments to "
+			  << expr.Callee << std::endl;
+		return;
+	}
+
+	for (auto exprptr : expr.Arguments) {
+		if (!compile(*exprptr))
+			return;
+		emit(PushValue);
+	}
+	emit(CallFunction, (const void *)&callee->Code);
+	if (!expr.Arguments.empty())
+		emit(PopArguments, 8 * (int32_t)expr.Arguments.size());
+	ExpressionSuccessful = true;
+}
+
+void TemplateJITCompiler::visit(NumberExpressionAST & expr)
+{
+	emit(LoadConstant, expr.Number);
+	ExpressionSuccessful = true;
+}
+
+void TemplateJITCompiler::visit(UnaryExpressionAST & expr)
+{
+	if (!compile(*expr.Expression))
+		return;
+
+	switch (expr.Op) {
+	case UnaryExpressionAST::Not:
+		emit(NotOperation);
+		break;
+	case UnaryExpressionAST::Minus:
+		emit(MinusOperation);
+		break;
+	case UnaryExpressionAST::BitwiseNot:
+		emit(BitwiseNotOperation);
+		break;
+	default:
+		break;
+	}
+}
+
+// References to constants become numbers.  Other variables are top-level
+// variables at top level, and local variables in functions.
+void TemplateJITCompiler::visit(VariableExpressionAST & expr)
+{
+	ExpressionSuccessful = true;
+
+	auto const_it = Backend.Constants.find(expr.Name);
+	if (const_it != Backend.Constants.end()) {
+		emit(LoadConstant, const_it->second);
+		return;
+	}
+
+	if (Function == nullptr) {
+		emit(LoadGlobal, Backend.getGlobalVariable(expr.Name));
+		return;
+	}
+
+	auto it = Slots.find(expr.Name);
+	if (it != Slots.end()) {
+		emit(LoadLocal, it->second);
+	} else {
+		// First reference to the variable, which zeroes it
+		emit(ZeroLocal, allocateLocal(expr.Name));
+		emit(LoadConstant, 0);
+	}
+}
+
+TemplateJITBackend::TemplateJITBackend()
+{
+}
+
+TemplateJITBackend::~TemplateJITBackend()
+{
+}
+
+bool TemplateJITBackend::compileProgramToObjectFile(const ProgramAST & program __attribute__((unused)),
+						    const char *out_filename __attribute__((unused)))
+{
+	std::cerr << "ERROR: The template JIT backend can't compile programs "
+		     "to object files" << std::endl;
+	return false;
+}
+
+InterpreterFunction *
+TemplateJITBackend::createFunction(std::shared_ptr<FunctionDefinitionAST> definition)
+{
+	return new TemplateJITFunction(definition);
+}
+
+bool TemplateJITBackend::isGlobalVariable(const std::string & name) const
+{
+	return GlobalVariables.count(name);
+}
+
+// Return the storage of the top-level variable @name, creating it (initialized
+// to 0) if it doesn't exist yet.
+int32_t *TemplateJITBackend::getGlobalVariable(const std::string & name)
+{
+	auto it = GlobalVariables.find(name);
+	if (it != GlobalVariables.end())
+		return it->second;
+
+	GlobalStorage.push_back(0);
+	GlobalVariables[name] = &GlobalStorage.back();
+	return &GlobalStorage.back();
+}
+
+// Copy the machine code of a function into executable memory and return its
+// address, or nullptr if no memory could be allocated
+void *TemplateJITBackend::installFunctionCode(const std::vector<uint8_t> & code)
+{
+	static const size_t ChunkSize = 1 << 20;
+
+	if (FunctionCode.empty() ||
+	    FunctionCode.back()->getAvailable() < code.size())
+	{
+		FunctionCode.emplace_back(new ExecutableMemory(
+					std::max(ChunkSize, code.size())));
+		if (!FunctionCode.back()->isValid()) {
+			FunctionCode.pop_back();
+			std::cerr << "ERROR: Can't allocate memory for "
+				     "machine code" << std::endl;
+			return nullptr;
+		}
+	}
+	return FunctionCode.back()->install(code);
+}
+
+bool TemplateJITBackend::compileFunction(InterpreterFunction & function)
+{
+	TemplateJITFunction & func = static_cast<TemplateJITFunction &>(function);
+	TemplateJITCompiler compiler(*this, &func);
+
+	if (!compiler.compile(func.Definition->Body))
+		return false;
+	func.Code = installFunctionCode(compiler.finish());
+	return func.Code != nullptr;
+}
+
+bool TemplateJITBackend::executeStatements(
+			const std::vector<std::shared_ptr<StatementAST>> & stmts)
+{
+	auto prev_variables = GlobalVariables;
+	TemplateJITCompiler compiler(*this, nullptr);
+
+	if (!compiler.compile(stmts)) {
+		GlobalVariables = prev_variables;
+		return false;
+	}
+	const std::vector<uint8_t> & code = compiler.finish();
+
+#if defined(__x86_64__)
+	if (StatementCode == nullptr || StatementCode->getAvailable() < code.size()) {
+		StatementCode.reset(new ExecutableMemory(
+				std::max((size_t)1 << 16, 2 * code.size())));
+	}
+	StatementCode->clear();
+	void *addr = StatementCode->isValid() ? StatementCode->install(code) : nullptr;
+	if (addr == nullptr) {
+		std::cerr << "ERROR: Can't allocate memory for machine code"
+			  << std::endl;
+		return false;
+	}
+	reinterpret_cast<int32_t (*)()>(addr)();
+	return true;
+#else
+	std::cerr << "ERROR: The template JIT backend only generates x86-64 code"
+		  << std::endl;
+	return false;
+#endif
+}
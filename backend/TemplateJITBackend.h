@@ -0,0 +1,67 @@
+#ifndef _GARTER_TEMPLATE_JIT_BACKEND_H_
+#define _GARTER_TEMPLATE_JIT_BACKEND_H_
+
+#include <backend/InterpreterBackend.h>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace garter {
+
+class TemplateJITCompiler;
+class ExecutableMemory;
+
+// Implementation of a garter Backend that generates x86-64 machine code
+// directly from the AST, without LLVM, for programs that spend more time being
+// compiled than running.  Each kind of AST node is compiled by copying one or
+// more fixed machine code templates and patching their operands (a constant, a
+// variable's address, or a jump offset) into them.  There is no optimization
+// and no register allocation: expressions are computed in %eax, the pending
+// left operands of binary operators and the arguments of calls are pushed on
+// the stack, and every local variable lives in a stack slot of its function's
+// frame.  Compiling takes a few microseconds per statement, against
+// milliseconds for LLVMBackend at -O0.
+//
+// Functions are compiled when first referenced and called through a pointer
+// to their code, so a function can be called before its own compilation
+// finishes.  The code of a top-level statement is overwritten by that of the
+// next statement.
+//
+// Machine code can only be run on x86-64; on other hosts, executing anything
+// but definitions fails with an error message.
+class TemplateJITBackend : public InterpreterBackend {
+private:
+	// Top-level variables, by name, and their values
+	std::map<std::string, int32_t*> GlobalVariables;
+	std::deque<int32_t> GlobalStorage;
+
+	// Memory holding the code of functions, and the code of the last
+	// top-level statement executed
+	std::vector<std::unique_ptr<ExecutableMemory>> FunctionCode;
+	std::unique_ptr<ExecutableMemory> StatementCode;
+
+	int32_t *getGlobalVariable(const std::string & name);
+	void *installFunctionCode(const std::vector<uint8_t> & code);
+
+	InterpreterFunction *
+	createFunction(std::shared_ptr<FunctionDefinitionAST> definition);
+	bool isGlobalVariable(const std::string & name) const;
+	bool compileFunction(InterpreterFunction & func);
+	bool executeStatements(const std::vector<std::shared_ptr<StatementAST>> & stmts);
+
+	friend class TemplateJITCompiler;
+
+public:
+	TemplateJITBackend();
+	~TemplateJITBackend();
+
+	// Not supported: prints an error message and returns false
+	bool compileProgramToObjectFile(const ProgramAST & program,
+					const char *out_filename);
+};
+
+} // End garter namespace
+
+#endif /* _GARTER_TEMPLATE_JIT_BACKEND_H_ */
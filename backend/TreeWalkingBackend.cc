@@ -0,0 +1,836 @@
+#include <backend/TreeWalkingBackend.h>
+#include <frontend/Parser.h>
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+
+using namespace garter;
+
+namespace garter {
+
+// Node of the tree for an expression.  evaluate() computes the value of the
+// expression in @frame, the frame of the function being executed.
+struct ExpressionNode {
+	virtual ~ExpressionNode() { }
+	virtual int32_t evaluate(int32_t *frame) const = 0;
+};
+
+typedef std::unique_ptr<ExpressionNode> ExpressionNodePtr;
+
+// How control leaves a statement
+enum Completion {
+	NormalCompletion,
+	BreakCompletion,
+	ContinueCompletion,
+	ReturnCompletion,
+};
+
+// Node of the tree for a statement.  execute() executes the statement in
+// @frame.  A return statement stores the value returned in @result.
+struct StatementNode {
+	virtual ~StatementNode() { }
+	virtual Completion execute(int32_t *frame, int32_t & result) const = 0;
+};
+
+typedef std::vector<std::unique_ptr<StatementNode>> StatementList;
+
+// A function defined by the program
+struct InterpretedFunction : public InterpreterFunction {
+	// Number of slots in the function's frame.  The parameters come first,
+	// followed by the other local variables.
+	size_t NumSlots;
+
+	StatementList Body;
+
+	InterpretedFunction(std::shared_ptr<FunctionDefinitionAST> definition)
+		: InterpreterFunction(definition),
+		  NumSlots(definition->Parameters.size())
+	{
+	}
+};
+
+} // End garter namespace
+
+static Completion executeStatements(const StatementList & stmts,
+				    int32_t *frame, int32_t & result)
+{
+	for (const auto & stmt : stmts) {
+		Completion completion = stmt->execute(frame, result);
+		if (completion != NormalCompletion)
+			return completion;
+	}
+	return NormalCompletion;
+}
+
+namespace {
+
+struct NumberNode : public ExpressionNode {
+	int32_t Value;
+
+	NumberNode(int32_t value) : Value(value) { }
+
+	int32_t evaluate(int32_t *) const override
+	{
+		return Value;
+	}
+};
+
+struct LocalVariableNode : public ExpressionNode {
+	size_t Slot;
+
+	LocalVariableNode(size_t slot) : Slot(slot) { }
+
+	int32_t evaluate(int32_t *frame) const override
+	{
+		return frame[Slot];
+	}
+};
+
+// First reference to a local variable in a function.  As in the code generated
+// by LLVMBackend, this sets the variable to 0 each time it's executed.
+struct LocalVariableDeclarationNode : public ExpressionNode {
+	size_t Slot;
+
+	LocalVariableDeclarationNode(size_t slot) : Slot(slot) { }
+
+	int32_t evaluate(int32_t *frame) const override
+	{
+		frame[Slot] = 0;
+		return 0;
+	}
+};
+
+struct GlobalVariableNode : public ExpressionNode {
+	int32_t *Variable;
+
+	GlobalVariableNode(int32_t *variable) : Variable(variable) { }
+
+	int32_t evaluate(int32_t *) const override
+	{
+		return *Variable;
+	}
+};
+
+// Both operands are always evaluated, as in the code generated by LLVMBackend.
+struct BinaryNode : public ExpressionNode {
+	BinaryExpressionAST::BinaryOp Op;
+	ExpressionNodePtr LHS, RHS;
+
+	BinaryNode(BinaryExpressionAST::BinaryOp op,
+		   ExpressionNodePtr lhs, ExpressionNodePtr rhs)
+		: Op(op), LHS(std::move(lhs)), RHS(std::move(rhs))
+	{
+	}
+
+	int32_t evaluate(int32_t *frame) const override
+	{
+		int32_t lhs = LHS->evaluate(frame);
+		int32_t rhs = RHS->evaluate(frame);
+
+		switch (Op) {
+		case BinaryExpressionAST::Or:
+			return lhs != 0 || rhs != 0;
+		case BinaryExpressionAST::And:
+			return lhs != 0 && rhs != 0;
+		case BinaryExpressionAST::LessThan:
+			return lhs < rhs;
+		case BinaryExpressionAST::GreaterThan:
+			return lhs > rhs;
+		case BinaryExpressionAST::LessThanOrEqualTo:
+			return lhs <= rhs;
+		case BinaryExpressionAST::GreaterThanOrEqualTo:
+			return lhs >= rhs;
+		case BinaryExpressionAST::EqualTo:
+			return lhs == rhs;
+		case BinaryExpressionAST::NotEqualTo:
+			return lhs != rhs;
+		case BinaryExpressionAST::BitwiseOr:
+			return lhs | rhs;
+		case BinaryExpressionAST::BitwiseXor:
+			return lhs ^ rhs;
+		case BinaryExpressionAST::BitwiseAnd:
+			return lhs & rhs;
+		case BinaryExpressionAST::LeftShift:
+			return (uint32_t)lhs << (rhs & 31);
+		case BinaryExpressionAST::RightShift:
+			return lhs >> (rhs & 31);
+		case BinaryExpressionAST::Add:
+			return (uint32_t)lhs + (uint32_t)rhs;
+		case BinaryExpressionAST::Subtract:
+			return (uint32_t)lhs - (uint32_t)rhs;
+		case BinaryExpressionAST::Multiply:
+			return (uint32_t)lhs * (uint32_t)rhs;
+		// Like native code, division by zero traps.
+		case BinaryExpressionAST::Divide:
+			return lhs / rhs;
+		case BinaryExpressionAST::Modulo:
+			return lhs % rhs;
+		case BinaryExpressionAST::Exponentiate:
+			return exponentiate(lhs, rhs);
+		default:
+			// Rejected during translation
+			abort();
+		}
+	}
+};
+
+struct UnaryNode : public ExpressionNode {
+	UnaryExpressionAST::UnaryOp Op;
+	ExpressionNodePtr Operand;
+
+	UnaryNode(UnaryExpressionAST::UnaryOp op, ExpressionNodePtr operand)
+		: Op(op), Operand(std::move(operand))
+	{
+	}
+
+	int32_t evaluate(int32_t *frame) const override
+	{
+		int32_t value = Operand->evaluate(frame);
+
+		switch (Op) {
+		case UnaryExpressionAST::Not:
+			return value == 0;
+		case UnaryExpressionAST::Minus:
+			return -(uint32_t)value;
+		case UnaryExpressionAST::BitwiseNot:
+			return ~value;
+		default:
+			return value;
+		}
+	}
+};
+
+struct BuiltinCallNode : public ExpressionNode {
+	enum Builtin { Popcount, Clz, Ctz, Bswap } Function;
+	ExpressionNodePtr Argument;
+
+	BuiltinCallNode(Builtin function, ExpressionNodePtr argument)
+		: Function(function), Argument(std::move(argument))
+	{
+	}
+
+	int32_t evaluate(int32_t *frame) const override
+	{
+		uint32_t arg = Argument->evaluate(frame);
+
+		switch (Function) {
+		case Popcount:
+			return __builtin_popcount(arg);
+		case Clz:
+			return (arg == 0) ? 32 : __builtin_clz(arg);
+		case Ctz:
+			return (arg == 0) ? 32 : __builtin_ctz(arg);
+		default:
+			return __builtin_bswap32(arg);
+		}
+	}
+};
+
+struct CallNode : public ExpressionNode {
+	const InterpretedFunction *Callee;
+	std::vector<ExpressionNodePtr> Arguments;
+
+	CallNode(const InterpretedFunction *callee,
+		 std::vector<ExpressionNodePtr> arguments)
+		: Callee(callee), Arguments(std::move(arguments))
+	{
+	}
+
+	int32_t evaluate(int32_t *frame) const override
+	{
+		// Small frames, which most are, live on the native stack.
+		static const size_t SmallFrameSlots = 16;
+		int32_t small_frame[SmallFrameSlots];
+		std::unique_ptr<int32_t[]> large_frame;
+		int32_t *callee_frame = small_frame;
+		const size_t num_slots = Callee->NumSlots;
+		const size_t num_args = Arguments.size();
+		int32_t result = 0;
+
+		if (num_slots > SmallFrameSlots) {
+			large_frame.reset(new int32_t[num_slots]);
+			callee_frame = large_frame.get();
+		}
+		for (size_t i = 0; i < num_args; i++)
+			callee_frame[i] = Arguments[i]->evaluate(frame);
+		std::fill(callee_frame + num_args, callee_frame + num_slots, 0);
+
+		executeStatements(Callee->Body, callee_frame, result);
+		return result;
+	}
+};
+
+struct LocalAssignmentNode : public StatementNode {
+	size_t Slot;
+	bool Declaration;
+	ExpressionNodePtr Value;
+
+	LocalAssignmentNode(size_t slot, bool declaration, ExpressionNodePtr value)
+		: Slot(slot), Declaration(declaration), Value(std::move(value))
+	{
+	}
+
+	Completion execute(int32_t *frame, int32_t &) const override
+	{
+		// The assigned value may refer to the variable being declared.
+		if (Declaration)
+			frame[Slot] = 0;
+		frame[Slot] = Value->evaluate(frame);
+		return NormalCompletion;
+	}
+};
+
+struct GlobalAssignmentNode : public StatementNode {
+	int32_t *Variable;
+	ExpressionNodePtr Value;
+
+	GlobalAssignmentNode(int32_t *variable, ExpressionNodePtr value)
+		: Variable(variable), Value(std::move(value))
+	{
+	}
+
+	Completion execute(int32_t *frame, int32_t &) const override
+	{
+		*Variable = Value->evaluate(frame);
+		return NormalCompletion;
+	}
+};
+
+struct BreakNode : public StatementNode {
+	Completion execute(int32_t *, int32_t &) const override
+	{
+		return BreakCompletion;
+	}
+};
+
+struct ContinueNode : public StatementNode {
+	Completion execute(int32_t *, int32_t &) const override
+	{
+		return ContinueCompletion;
+	}
+};
+
+struct ExpressionStatementNode : public StatementNode {
+	ExpressionNodePtr Expression;
+
+	ExpressionStatementNode(ExpressionNodePtr expression)
+		: Expression(std::move(expression))
+	{
+	}
+
+	Completion execute(int32_t *frame, int32_t &) const override
+	{
+		Expression->evaluate(frame);
+		return NormalCompletion;
+	}
+};
+
+// An 'if' statement.  The 'if' and 'elif' clauses are in Conditions and
+// Bodies; ElseBody may be empty.
+struct IfNode : public StatementNode {
+	std::vector<ExpressionNodePtr> Conditions;
+	std::vector<StatementList> Bodies;
+	StatementList ElseBody;
+
+	Completion execute(int32_t *frame, int32_t & result) const override
+	{
+		for (size_t i = 0; i < Conditions.size(); i++)
+			if (Conditions[i]->evaluate(frame) != 0)
+				return executeStatements(Bodies[i], frame, result);
+		return executeStatements(ElseBody, frame, result);
+	}
+};
+
+struct PrintNode : public StatementNode {
+	std::vector<ExpressionNodePtr> Arguments;
+
+	PrintNode(std::vector<ExpressionNodePtr> arguments)
+		: Arguments(std::move(arguments))
+	{
+	}
+
+	// Print the same way as __garter_print() in the runtime library, once
+	// all arguments have been evaluated
+	Completion execute(int32_t *frame, int32_t &) const override
+	{
+		std::vector<int32_t> values;
+		for (const auto & arg : Arguments)
+			values.push_back(arg->evaluate(frame));
+		for (size_t i = 0; i < values.size(); i++)
+			printf(i == 0 ? "%d" : " %d", values[i]);
+		putchar('\n');
+		return NormalCompletion;
+	}
+};
+
+struct ReturnNode : public StatementNode {
+	ExpressionNodePtr Value;
+
+	ReturnNode(ExpressionNodePtr value) : Value(std::move(value)) { }
+
+	Completion execute(int32_t *frame, int32_t & result) const override
+	{
+		result = Value->evaluate(frame);
+		return ReturnCompletion;
+	}
+};
+
+struct WhileNode : public StatementNode {
+	ExpressionNodePtr Condition;
+	StatementList Body;
+
+	WhileNode(ExpressionNodePtr condition, StatementList body)
+		: Condition(std::move(condition)), Body(std::move(body))
+	{
+	}
+
+	Completion execute(int32_t *frame, int32_t & result) const override
+	{
+		while (Condition->evaluate(frame) != 0) {
+			Completion completion = executeStatements(Body, frame, result);
+			if (completion == BreakCompletion)
+				break;
+			if (completion == ReturnCompletion)
+				return completion;
+		}
+		return NormalCompletion;
+	}
+};
+
+} // End anonymous namespace
+
+namespace garter {
+
+// StatementAST and ExpressionAST visitor that translates the AST of a function
+// body or of top-level statements into nodes.  On failure, an error message is
+// printed.
+class TreeWalkingResolver : public StatementASTVisitor,
+			    public ExpressionASTVisitor {
+private:
+	TreeWalkingBackend & Backend;
+
+	// Function being translated, or nullptr for top-level statements
+	InterpretedFunction *Function;
+
+	// Frame slots of the local variables of Function seen so far
+	std::map<std::string, size_t> Slots;
+
+	// Number of loops enclosing the statement being translated
+	unsigned LoopDepth;
+
+	// Used to return the node translated from an expression (nullptr on
+	// failure) or statement (nullptr for 'pass')
+	ExpressionNodePtr Expression;
+	std::unique_ptr<StatementNode> Statement;
+
+	// Used to return whether a statement was successfully translated
+	bool StatementSuccessful;
+
+	ExpressionNodePtr translateBuiltinCall(CallExpressionAST & expr);
+public:
+	TreeWalkingResolver(TreeWalkingBackend & backend,
+			    InterpretedFunction *function)
+		: Backend(backend), Function(function), LoopDepth(0),
+		  StatementSuccessful(false)
+	{
+	}
+
+	void addParameter(const std::string & name, size_t slot)
+	{
+		Slots[name] = slot;
+	}
+
+	ExpressionNodePtr translate(ExpressionAST & expr)
+	{
+		expr.acceptVisitor(*this);
+		return std::move(Expression);
+	}
+
+	bool translate(const std::vector<std::shared_ptr<StatementAST>> & stmts,
+		       StatementList & nodes);
+
+	void visit(AssignmentStatementAST &);
+	void visit(BreakStatementAST &);
+	void visit(ContinueStatementAST &);
+	void visit(ExpressionStatementAST &);
+	void visit(IfStatementAST &);
+	void visit(PassStatementAST &);
+	void visit(PrintStatementAST &);
+	void visit(ReturnStatementAST &);
+	void visit(WhileStatementAST &);
+
+	void visit(BinaryExpressionAST &);
+	void visit(CallExpressionAST &);
+	void visit(NumberExpressionAST &);
+	void visit(UnaryExpressionAST &);
+	void visit(VariableExpressionAST &);
+};
+
+} // End garter namespace
+
+// Translate the statements @stmts, appending the nodes to @nodes
+bool TreeWalkingResolver::translate(const std::vector<std::shared_ptr<StatementAST>> & stmts,
+				    StatementList & nodes)
+{
+	for (auto stmtptr : stmts) {
+		stmtptr->acceptVisitor(*this);
+		if (!StatementSuccessful)
+			return false;
+		if (Statement != nullptr)
+			nodes.push_back(std::move(Statement));
+	}
+	return true;
+}
+
+void TreeWalkingResolver::visit(AssignmentStatementAST & stmt)
+{
+	const std::string & name = stmt.Variable->Name;
+
+	StatementSuccessful = false;
+	if (Backend.Constants.count(name)) {
+		std::cerr << "ERROR: Cannot assign to constant " << name << std::endl;
+		return;
+	}
+
+	if (Function == nullptr) {
+		int32_t *variable = Backend.getGlobalVariable(name);
+		ExpressionNodePtr value = translate(*stmt.Expression);
+		if (value == nullptr)
+			return;
+		Statement.reset(new GlobalAssignmentNode(variable, std::move(value)));
+		StatementSuccessful = true;
+		return;
+	}
+
+	auto it = Slots.find(name);
+	bool declaration = (it == Slots.end());
+	size_t slot;
+	if (declaration) {
+		slot = Function->NumSlots++;
+		Slots[name] = slot;
+	} else {
+		slot = it->second;
+	}
+	ExpressionNodePtr value = translate(*stmt.Expression);
+	if (value == nullptr)
+		return;
+	Statement.reset(new LocalAssignmentNode(slot, declaration, std::move(value)));
+	StatementSuccessful = true;
+}
+
+void TreeWalkingResolver::visit(BreakStatementAST & stmt __attribute__((unused)))
+{
+	if (LoopDepth == 0) {
+		std::cerr << "ERROR: break statement not in loop" << std::endl;
+		StatementSuccessful = false;
+	} else {
+		Statement.reset(new BreakNode());
+		StatementSuccessful = true;
+	}
+}
+
+void TreeWalkingResolver::visit(ContinueStatementAST & stmt __attribute__((unused)))
+{
+	if (LoopDepth == 0) {
+		std::cerr << "ERROR: continue statement not in loop" << std::endl;
+		StatementSuccessful = false;
+	} else {
+		Statement.reset(new ContinueNode());
+		StatementSuccessful = true;
+	}
+}
+
+void TreeWalkingResolver::visit(ExpressionStatementAST & stmt)
+{
+	ExpressionNodePtr expr = translate(*stmt.Expression);
+
+	StatementSuccessful = false;
+	if (expr == nullptr)
+		return;
+	Statement.reset(new ExpressionStatementNode(std::move(expr)));
+	StatementSuccessful = true;
+}
+
+void TreeWalkingResolver::visit(IfStatementAST & stmt)
+{
+	std::unique_ptr<IfNode> node(new IfNode());
+
+	StatementSuccessful = false;
+	for (size_t i = 0; i <= stmt.ElifClauses.size(); i++) {
+		ExpressionAST & cond = (i == 0) ? *stmt.Condition :
+					*stmt.ElifClauses[i - 1]->Condition;
+		const std::vector<std::shared_ptr<StatementAST>> & body =
+			(i == 0) ? stmt.Body : stmt.ElifClauses[i - 1]->Body;
+
+		node->Conditions.push_back(translate(cond));
+		if (node->Conditions.back() == nullptr)
+			return;
+		node->Bodies.emplace_back();
+		if (!translate(body, node->Bodies.back()))
+			return;
+	}
+	if (!translate(stmt.ElseBody, node->ElseBody))
+		return;
+	Statement = std::move(node);
+	StatementSuccessful = true;
+}
+
+// 'pass' statements produce no node.
+void TreeWalkingResolver::visit(PassStatementAST & stmt __attribute__((unused)))
+{
+	StatementSuccessful = true;
+}
+
+void TreeWalkingResolver::visit(PrintStatementAST & stmt)
+{
+	std::vector<ExpressionNodePtr> args;
+
+	StatementSuccessful = false;
+	for (auto exprptr : stmt.Arguments) {
+		args.push_back(translate(*exprptr));
+		if (args.back() == nullptr)
+			return;
+	}
+	Statement.reset(new PrintNode(std::move(args)));
+	StatementSuccessful = true;
+}
+
+void TreeWalkingResolver::visit(ReturnStatementAST & stmt)
+{
+	ExpressionNodePtr value = translate(*stmt.Expression);
+
+	StatementSuccessful = false;
+	if (value == nullptr)
+		return;
+	Statement.reset(new ReturnNode(std::move(value)));
+	StatementSuccessful = true;
+}
+
+void TreeWalkingResolver::visit(WhileStatementAST & stmt)
+{
+	ExpressionNodePtr cond = translate(*stmt.Condition);
+	StatementList body;
+
+	StatementSuccessful = false;
+	if (cond == nullptr)
+		return;
+
+	LoopDepth++;
+	bool ok = translate(stmt.Body, body);
+	LoopDepth--;
+	if (!ok)
+		return;
+
+	Statement.reset(new WhileNode(std::move(cond), std::move(body)));
+	StatementSuccessful = true;
+}
+
+void TreeWalkingResolver::visit(BinaryExpressionAST & expr)
+{
+	ExpressionNodePtr lhs = translate(*expr.LHS);
+	if (lhs == nullptr)
+		return;
+	ExpressionNodePtr rhs = translate(*expr.RHS);
+	if (rhs == nullptr)
+		return;
+
+	if (expr.Op == BinaryExpressionAST::In ||
+	    expr.Op == BinaryExpressionAST::NotIn)
+	{
+		std::cerr << "ERROR: Operator " << expr.getOpStr()
+			  << " is not supported" << std::endl;
+		return;
+	}
+	Expression.reset(new BinaryNode(expr.Op, std::move(lhs), std::move(rhs)));
+}
+
+// Builtin functions, each taking one argument
+static const struct {
+	const char *Name;
+	BuiltinCallNode::Builtin Function;
+} Builtins[] = {
+	{"popcount", BuiltinCallNode::Popcount},
+	{"clz",      BuiltinCallNode::Clz},
+	{"ctz",      BuiltinCallNode::Ctz},
+	{"bswap",    BuiltinCallNode::Bswap},
+};
+
+// If the call expression @expr names a builtin function, return the node for
+// calling it, or nullptr on error.  Otherwise report an unknown function.
+ExpressionNodePtr TreeWalkingResolver::translateBuiltinCall(CallExpressionAST & expr)
+{
+	for (const auto & builtin : Builtins) {
+		if (expr.Callee != builtin.Name)
+			continue;
+
+		if (expr.Arguments.size() != 1) {
+			std::cerr << "ERROR: Wrong number of arguments to "
+				  << expr.Callee << std::endl;
+			return nullptr;
+		}
+		ExpressionNodePtr arg = translate(*expr.Arguments[0]);
+		if (arg == nullptr)
+			return nullptr;
+		return ExpressionNodePtr(new BuiltinCallNode(builtin.Function,
+							     std::move(arg)));
+	}
+
+	std::cerr << "ERROR: Unknown function " << expr.Callee << std::endl;
+	return nullptr;
+}
+
+void TreeWalkingResolver::visit(CallExpressionAST & expr)
+{
+	InterpretedFunction *callee =
+		static_cast<InterpretedFunction*>(Backend.getFunction(expr.Callee));
+
+	// Functions not defined by the program may name a builtin
+	if (callee == nullptr) {
+		Expression = translateBuiltinCall(expr);
+		return;
+	}
+
+	if (callee->Definition->Parameters.size() != expr.Arguments.size()) {
+		std::cerr << "ERROR: Wrong number of arguments to "
+			  << expr.Callee << std::endl;
+		Expression = nullptr;
+		return;
+	}
+
+	std::vector<ExpressionNodePtr> args;
+	for (auto exprptr : expr.Arguments) {
+		args.push_back(translate(*exprptr));
+		if (args.back() == nullptr)
+			return;
+	}
+	Expression.reset(new CallNode(callee, std::move(args)));
+}
+
+void TreeWalkingResolver::visit(NumberExpressionAST & expr)
+{
+	Expression.reset(new NumberNode(expr.Number));
+}
+
+void TreeWalkingResolver::visit(UnaryExpressionAST & expr)
+{
+	ExpressionNodePtr operand = translate(*expr.Expression);
+
+	if (operand == nullptr)
+		return;
+	if (expr.Op == UnaryExpressionAST::Plus)
+		Expression = std::move(operand);
+	else
+		Expression.reset(new UnaryNode(expr.Op, std::move(operand)));
+}
+
+// References to constants become numbers.  Other variables are top-level
+// variables at top level, and local variables in functions.
+void TreeWalkingResolver::visit(VariableExpressionAST & expr)
+{
+	auto const_it = Backend.Constants.find(expr.Name);
+	if (const_it != Backend.Constants.end()) {
+		Expression.reset(new NumberNode(const_it->second));
+		return;
+	}
+
+	if (Function == nullptr) {
+		Expression.reset(new GlobalVariableNode(
+					Backend.getGlobalVariable(expr.Name)));
+		return;
+	}
+
+	auto it = Slots.find(expr.Name);
+	if (it != Slots.end()) {
+		Expression.reset(new LocalVariableNode(it->second));
+	} else {
+		size_t slot = Function->NumSlots++;
+		Slots[expr.Name] = slot;
+		Expression.reset(new LocalVariableDeclarationNode(slot));
+	}
+}
+
+TreeWalkingBackend::TreeWalkingBackend()
+{
+}
+
+TreeWalkingBackend::~TreeWalkingBackend()
+{
+}
+
+bool TreeWalkingBackend::compileProgramToObjectFile(const ProgramAST & program __attribute__((unused)),
+						    const char *out_filename __attribute__((unused)))
+{
+	std::cerr << "ERROR: The tree-walking backend can't compile programs "
+		     "to object files" << std::endl;
+	return false;
+}
+
+InterpreterFunction *
+TreeWalkingBackend::createFunction(std::shared_ptr<FunctionDefinitionAST> definition)
+{
+	return new InterpretedFunction(definition);
+}
+
+bool TreeWalkingBackend::isGlobalVariable(const std::string & name) const
+{
+	return GlobalVariables.count(name);
+}
+
+// Return the storage of the top-level variable @name, creating it (initialized
+// to 0) if it doesn't exist yet.
+int32_t *TreeWalkingBackend::getGlobalVariable(const std::string & name)
+{
+	auto it = GlobalVariables.find(name);
+	if (it != GlobalVariables.end())
+		return it->second;
+
+	GlobalStorage.push_back(0);
+	GlobalVariables[name] = &GlobalStorage.back();
+	return &GlobalStorage.back();
+}
+
+// Translate the body of a function.  On failure, functions translated while it
+// was being translated, which may call it, still refer to it, but its body
+// stays empty.
+bool TreeWalkingBackend::compileFunction(InterpreterFunction & function)
+{
+	InterpretedFunction & func = static_cast<InterpretedFunction &>(function);
+	const FunctionDefinitionAST & def = *func.Definition;
+	TreeWalkingResolver resolver(*this, &func);
+
+	for (size_t i = 0; i < def.Parameters.size(); i++)
+		resolver.addParameter(def.Parameters[i], i);
+
+	if (!resolver.translate(def.Body, func.Body)) {
+		func.Body.clear();
+		return false;
+	}
+	return true;
+}
+
+// Translate top-level statements into @nodes.  On failure, the top-level
+// variables they introduced are forgotten.
+bool TreeWalkingBackend::resolveTopLevelStatements(
+			const std::vector<std::shared_ptr<StatementAST>> & stmts,
+			StatementList & nodes)
+{
+	auto prev_variables = GlobalVariables;
+	TreeWalkingResolver resolver(*this, nullptr);
+
+	if (!resolver.translate(stmts, nodes)) {
+		GlobalVariables = prev_variables;
+		return false;
+	}
+	return true;
+}
+
+bool TreeWalkingBackend::executeStatements(
+			const std::vector<std::shared_ptr<StatementAST>> & stmts)
+{
+	StatementList nodes;
+	int32_t result;
+	if (!resolveTopLevelStatements(stmts, nodes))
+		return false;
+	::executeStatements(nodes, nullptr, result);
+	return true;
+}
@@ -0,0 +1,59 @@
+#ifndef _GARTER_TREE_WALKING_BACKEND_H_
+#define _GARTER_TREE_WALKING_BACKEND_H_
+
+#include <backend/InterpreterBackend.h>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace garter {
+
+struct StatementNode;
+class TreeWalkingResolver;
+
+// Implementation of a garter Backend that executes programs directly instead
+// of compiling them to machine code, so it doesn't use LLVM at all.  This
+// makes starting up and running short programs much cheaper than with
+// LLVMBackend, at the cost of running long computations more slowly.
+//
+// Before a function or statement is first executed, its AST is translated into
+// a tree of nodes in which every variable has been resolved to a slot in the
+// function's frame (or, at top level, to the storage of a global variable) and
+// every call has been resolved to the function called.  Executing the tree
+// then involves no lookups by name.  Errors that LLVMBackend would report while
+// generating IR, such as calls to unknown functions, are reported at this
+// point, before any of the code is run.
+class TreeWalkingBackend : public InterpreterBackend {
+private:
+	// Top-level variables, by name, and their values
+	std::map<std::string, int32_t*> GlobalVariables;
+	std::deque<int32_t> GlobalStorage;
+
+	int32_t *getGlobalVariable(const std::string & name);
+	bool resolveTopLevelStatements(
+			const std::vector<std::shared_ptr<StatementAST>> & stmts,
+			std::vector<std::unique_ptr<StatementNode>> & nodes);
+
+	// Compiling a function or statements means translating them
+	InterpreterFunction *
+	createFunction(std::shared_ptr<FunctionDefinitionAST> definition);
+	bool isGlobalVariable(const std::string & name) const;
+	bool compileFunction(InterpreterFunction & func);
+	bool executeStatements(const std::vector<std::shared_ptr<StatementAST>> & stmts);
+
+	friend class TreeWalkingResolver;
+
+public:
+	TreeWalkingBackend();
+	~TreeWalkingBackend();
+
+	// Not supported: prints an error message and returns false
+	bool compileProgramToObjectFile(const ProgramAST & program,
+					const char *out_filename);
+};
+
+} // End garter namespace
+
+#endif /* _GARTER_TREE_WALKING_BACKEND_H_ */
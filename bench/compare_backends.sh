@@ -0,0 +1,48 @@
+#!/bin/bash
+#
+# Compare the wall time garteri takes to run garter programs with each of its
+# backends.  Each program is run several times with each backend, and the best
+# time is reported in milliseconds.  This includes starting garteri, so short
+# programs show the cost of compiling them and long ones the speed of the code.
+#
+# Usage: bench/compare_backends.sh [-n RUNS] [PROGRAM.ga...]
+#
+
+set -e -u
+
+runs=5
+backends="llvm tree bytecode template"
+
+if [ $# -ge 2 ] && [ "$1" = "-n" ]; then
+	runs=$2
+	shift 2
+fi
+if [ $# -eq 0 ]; then
+	set -- test/garterc_and_garteri_Tests/050_Fib.ga \
+	       test/garterc_and_garteri_Tests/060_Prime.ga \
+	       bench/050_FibLarge.ga \
+	       bench/060_PrimeLarge.ga
+fi
+
+TIMEFORMAT=%R
+
+printf "%-48s" "program (best of ${runs}, ms)"
+for backend in ${backends}; do
+	printf "%10s" "${backend}"
+done
+echo
+
+for src in "$@"; do
+	printf "%-48s" "${src}"
+	for backend in ${backends}; do
+		best=
+		for ((i = 0; i < runs; i++)); do
+			t=$( { time ./garteri -backend=${backend} ${src} \
+					> /dev/null; } 2>&1 )
+			best=$(awk -v t=$t -v best=${best:-$t} \
+				'BEGIN { print (t < best) ? t : best }')
+		done
+		printf "%10.0f" "$(awk -v t=${best} 'BEGIN { print t * 1000 }')"
+	done
+	echo
+done
@@ -0,0 +1,72 @@
+#!/bin/bash
+#
+# Compare the wall time garterc takes to compile a generated program with many
+# functions into an object file, using different numbers of threads (-j).
+# Each function runs a loop calling two others, so that the functions aren't
+# all inlined away.  Each compile is run several times and the best time is
+# reported in milliseconds.
+#
+# Usage: bench/compare_compile_jobs.sh [-n RUNS] [-f FUNCTIONS] [JOBS...]
+#
+
+set -e -u
+
+runs=1
+functions=10000
+
+while [ $# -ge 2 ]; do
+	case "$1" in
+	-n) runs=$2; shift 2 ;;
+	-f) functions=$2; shift 2 ;;
+	*) break ;;
+	esac
+done
+if [ $# -eq 0 ]; then
+	set -- 1 2 4 8
+fi
+
+tmpdir=$(mktemp -d)
+trap 'rm -rf ${tmpdir}' EXIT
+src=${tmpdir}/functions.ga
+
+for ((i = 0; i < functions; i++)); do
+	cat << END
+def f${i}(n):
+	s = 0;
+	i = 0;
+	while i < n:
+		if i % 3 == 0:
+			s = s + f$(( (i + 1) % functions ))(n - 1);
+		elif i % 3 == 1:
+			s = s + f$(( (i + 2) % functions ))(n - 2);
+		else:
+			s = s ^ (i * ${i});
+		endif
+		i = i + 1;
+	endwhile
+	return s;
+enddef
+END
+done > ${src}
+cat >> ${src} << END
+n = 0;
+while n < 3:
+	print f0(n);
+	n = n + 1;
+endwhile
+END
+
+TIMEFORMAT=%R
+
+echo "${functions} functions (best of ${runs}, ms)"
+for jobs in "$@"; do
+	best=
+	for ((i = 0; i < runs; i++)); do
+		t=$( { time ./garterc -j ${jobs} -c ${src} \
+				-o ${tmpdir}/functions.o; } 2>&1 )
+		best=$(awk -v t=$t -v best=${best:-$t} \
+			'BEGIN { print (t < best) ? t : best }')
+	done
+	printf "%-10s%10.0f\n" "-j ${jobs}" \
+		"$(awk -v t=${best} 'BEGIN { print t * 1000 }')"
+done
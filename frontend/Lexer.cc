@@ -2,20 +2,28 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <iostream>
 #include <sstream>
+#include <vector>
 
 using namespace garter;
 
 
+// Errors are written to std::cerr rather than stderr, so that a program
+// compiling several files at once can redirect each file's errors.
 void Lexer::reportError(const char *format, ...)
 {
-	va_list va;
+	va_list va, va2;
 
 	va_start(va, format);
-	fprintf(stderr, "Error near line %lu: ", CurrentLineNumber);
-	vfprintf(stderr, format, va);
-	putc('\n', stderr);
+	va_copy(va2, va);
+	std::vector<char> message(vsnprintf(nullptr, 0, format, va) + 1);
+	vsnprintf(message.data(), message.size(), format, va2);
+	va_end(va2);
 	va_end(va);
+
+	std::cerr << "Error near line " << CurrentLineNumber << ": "
+		  << message.data() << std::endl;
 }
 
 void Lexer::nextChar()
@@ -122,6 +130,10 @@ next_char:
 		nextChar();
 		return std::unique_ptr<Token>(new Token(Token::Comma));
 
+	case '@':
+		nextChar();
+		return std::unique_ptr<Token>(new Token(Token::At));
+
 	case '[':
 		nextChar();
 		return std::unique_ptr<Token>(new Token(Token::LeftSquareBracket));
@@ -173,6 +185,10 @@ next_char:
 		if (CurrentChar == '=') {
 			nextChar();
 			return std::unique_ptr<Token>(new Token(Token::LessThanOrEqualTo));
+		} else if (CurrentChar == '<') {
+			// Left shift
+			nextChar();
+			return std::unique_ptr<Token>(new Token(Token::DoubleLessThan));
 		} else {
 			return std::unique_ptr<Token>(new Token(Token::LessThan));
 		}
@@ -182,10 +198,30 @@ next_char:
 		if (CurrentChar == '=') {
 			nextChar();
 			return std::unique_ptr<Token>(new Token(Token::GreaterThanOrEqualTo));
+		} else if (CurrentChar == '>') {
+			// Right shift
+			nextChar();
+			return std::unique_ptr<Token>(new Token(Token::DoubleGreaterThan));
 		} else {
 			return std::unique_ptr<Token>(new Token(Token::GreaterThan));
 		}
 
+	case '&':
+		nextChar();
+		return std::unique_ptr<Token>(new Token(Token::Ampersand));
+
+	case '|':
+		nextChar();
+		return std::unique_ptr<Token>(new Token(Token::VerticalBar));
+
+	case '^':
+		nextChar();
+		return std::unique_ptr<Token>(new Token(Token::Caret));
+
+	case '~':
+		nextChar();
+		return std::unique_ptr<Token>(new Token(Token::Tilde));
+
 	case '!':
 		nextChar();
 		if (CurrentChar == '=') {
@@ -216,6 +252,7 @@ void Lexer::init()
 {
 	Keywords["and"]      = Token::And;
 	Keywords["break"]    = Token::Break;
+	Keywords["const"]    = Token::Const;
 	Keywords["continue"] = Token::Continue;
 	Keywords["def"]      = Token::Def;
 	Keywords["else"]     = Token::Else;
@@ -20,15 +20,21 @@ public:
 		// Special error token
 		Error = 0,
 
+		Ampersand,
 		And,
 		Asterisk,
+		At,
 		Break,
+		Caret,
 		Colon,
 		Comma,
+		Const,
 		Continue,
 		Def,
 		DoubleAsterisk,
 		DoubleEquals,
+		DoubleGreaterThan,
+		DoubleLessThan,
 		Elif,
 		Else,
 		EndDef,
@@ -62,6 +68,8 @@ public:
 		RightParenthesis,
 		RightSquareBracket,
 		Semicolon,
+		Tilde,
+		VerticalBar,
 		While,
 	};
 
@@ -25,6 +25,16 @@ const char *BinaryExpressionAST::getOpStr() const
 		return "EqualTo";
 	case BinaryExpressionAST::NotEqualTo:
 		return "NotEqualTo";
+	case BinaryExpressionAST::BitwiseOr:
+		return "BitwiseOr";
+	case BinaryExpressionAST::BitwiseXor:
+		return "BitwiseXor";
+	case BinaryExpressionAST::BitwiseAnd:
+		return "BitwiseAnd";
+	case BinaryExpressionAST::LeftShift:
+		return "LeftShift";
+	case BinaryExpressionAST::RightShift:
+		return "RightShift";
 	case BinaryExpressionAST::In:
 		return "In";
 	case BinaryExpressionAST::NotIn:
@@ -54,6 +64,8 @@ const char *UnaryExpressionAST::getOpStr() const
 		return "Plus";
 	case UnaryExpressionAST::Minus:
 		return "Minus";
+	case UnaryExpressionAST::BitwiseNot:
+		return "BitwiseNot";
 	}
 	return "???";
 }
@@ -81,6 +93,29 @@ void FunctionDefinitionAST::print(std::ostream & os) const
 	for (auto stmtptr : Body)
 		os << *stmtptr << ",";
 	os << "]";
+	if (!Attributes.empty()) {
+		os << ",Attributes = ";
+		Attributes.print(os);
+	}
+	os << "}";
+}
+
+void FunctionDefinitionAST::FunctionAttributes::print(std::ostream & os) const
+{
+	os << "FunctionAttributes {";
+	os << "Hot = " << Hot << ",";
+	os << "Cold = " << Cold << ",";
+	os << "Inline = " << Inline << ",";
+	os << "NoInline = " << NoInline << ",";
+	os << "OptLevel = " << OptLevel << ",";
+	os << "}";
+}
+
+void ConstantDefinitionAST::print(std::ostream & os) const
+{
+	os << "ConstantDefinition {";
+	os << "Name = \"" << Name << "\",";
+	os << "Expression = " << *Expression << ",";
 	os << "}";
 }
 
@@ -161,6 +196,22 @@ void WhileStatementAST::print(std::ostream & os) const
 	for (auto stmtptr : Body)
 		os << *stmtptr << ",";
 	os << "]";
+	if (!Hints.empty()) {
+		os << ",Hints = ";
+		Hints.print(os);
+	}
+	os << "}";
+}
+
+void WhileStatementAST::LoopHints::print(std::ostream & os) const
+{
+	os << "LoopHints {";
+	os << "Unroll = " << Unroll << ",";
+	os << "UnrollCount = " << UnrollCount << ",";
+	os << "NoUnroll = " << NoUnroll << ",";
+	os << "Vectorize = " << Vectorize << ",";
+	os << "VectorizeWidth = " << VectorizeWidth << ",";
+	os << "NoVectorize = " << NoVectorize << ",";
 	os << "}";
 }
 
@@ -245,6 +296,19 @@ Parser::currentAdditionOperator()
 	}
 }
 
+BinaryExpressionAST::BinaryOp
+Parser::currentShiftOperator()
+{
+	switch (CurrentToken->getType()) {
+	case Token::DoubleLessThan:
+		return BinaryExpressionAST::LeftShift;
+	case Token::DoubleGreaterThan:
+		return BinaryExpressionAST::RightShift;
+	default:
+		return BinaryExpressionAST::None;
+	}
+}
+
 BinaryExpressionAST::BinaryOp
 Parser::currentComparisonOperator()
 {
@@ -416,6 +480,7 @@ Parser::parsePowerExpression()
  *	  <power_expr>
  *	| - <unary_expr>
  *	| + <unary_expr>
+ *	| ~ <unary_expr>
  */
 std::unique_ptr<ExpressionAST>
 Parser::parseUnaryExpression()
@@ -429,6 +494,9 @@ Parser::parseUnaryExpression()
 	case Token::Plus:
 		op = UnaryExpressionAST::Plus;
 		break;
+	case Token::Tilde:
+		op = UnaryExpressionAST::BitwiseNot;
+		break;
 	default:
 		return parsePowerExpression();
 	}
@@ -507,9 +575,115 @@ Parser::parseAdditionExpression()
 	return add_expr;
 }
 
+/*
+ * <shift_expr> ::=
+ *	<add_expr> (<shift_op> <add_expr>)*
+ *
+ * <shift_op> ::=
+ *	<< | >>
+ */
+std::unique_ptr<ExpressionAST>
+Parser::parseShiftExpression()
+{
+	std::unique_ptr<ExpressionAST> shift_expr;
+	BinaryExpressionAST::BinaryOp op;
+
+	shift_expr = parseAdditionExpression();
+	if (shift_expr == nullptr)
+		return nullptr;
+
+	while ((op = currentShiftOperator()) != BinaryExpressionAST::None) {
+		nextToken();
+
+		std::unique_ptr<ExpressionAST> add_expr = parseAdditionExpression();
+		if (add_expr == nullptr)
+			return nullptr;
+		shift_expr = std::unique_ptr<ExpressionAST>(
+			new BinaryExpressionAST(op,
+						std::move(shift_expr),
+						std::move(add_expr)));
+	}
+	return shift_expr;
+}
+
+/*
+ * <bitand_expr> ::=
+ *	<shift_expr> (& <shift_expr>)*
+ */
+std::unique_ptr<ExpressionAST>
+Parser::parseBitwiseAndExpression()
+{
+	std::unique_ptr<ExpressionAST> bitand_expr = parseShiftExpression();
+
+	if (bitand_expr == nullptr)
+		return nullptr;
+
+	while (CurrentToken->getType() == Token::Ampersand) {
+		nextToken();
+		std::unique_ptr<ExpressionAST> shift_expr = parseShiftExpression();
+		if (shift_expr == nullptr)
+			return nullptr;
+		bitand_expr = std::unique_ptr<ExpressionAST>(
+			new BinaryExpressionAST(BinaryExpressionAST::BitwiseAnd,
+						std::move(bitand_expr),
+						std::move(shift_expr)));
+	}
+	return bitand_expr;
+}
+
+/*
+ * <bitxor_expr> ::=
+ *	<bitand_expr> (^ <bitand_expr>)*
+ */
+std::unique_ptr<ExpressionAST>
+Parser::parseBitwiseXorExpression()
+{
+	std::unique_ptr<ExpressionAST> bitxor_expr = parseBitwiseAndExpression();
+
+	if (bitxor_expr == nullptr)
+		return nullptr;
+
+	while (CurrentToken->getType() == Token::Caret) {
+		nextToken();
+		std::unique_ptr<ExpressionAST> bitand_expr = parseBitwiseAndExpression();
+		if (bitand_expr == nullptr)
+			return nullptr;
+		bitxor_expr = std::unique_ptr<ExpressionAST>(
+			new BinaryExpressionAST(BinaryExpressionAST::BitwiseXor,
+						std::move(bitxor_expr),
+						std::move(bitand_expr)));
+	}
+	return bitxor_expr;
+}
+
+/*
+ * <bitor_expr> ::=
+ *	<bitxor_expr> (| <bitxor_expr>)*
+ */
+std::unique_ptr<ExpressionAST>
+Parser::parseBitwiseOrExpression()
+{
+	std::unique_ptr<ExpressionAST> bitor_expr = parseBitwiseXorExpression();
+
+	if (bitor_expr == nullptr)
+		return nullptr;
+
+	while (CurrentToken->getType() == Token::VerticalBar) {
+		nextToken();
+		std::unique_ptr<ExpressionAST> bitxor_expr = parseBitwiseXorExpression();
+		if (bitxor_expr == nullptr)
+			return nullptr;
+		bitor_expr = std::unique_ptr<ExpressionAST>(
+			new BinaryExpressionAST(BinaryExpressionAST::BitwiseOr,
+						std::move(bitor_expr),
+						std::move(bitxor_expr)));
+	}
+	return bitor_expr;
+}
+
 /*
  * <comp_expr> ::=
- *	<add_expr> (<comp_op> <add_expr>)*
+ *	<bitor_expr> (<comp_op> <bitor_expr>)*
  *
  * <comp_op> ::=
  *	  <
@@ -527,7 +701,7 @@ Parser::parseComparisonExpression()
 	std::unique_ptr<ExpressionAST> comp_expr;
 	BinaryExpressionAST::BinaryOp op;
 
-	comp_expr = parseAdditionExpression();
+	comp_expr = parseBitwiseOrExpression();
 	if (comp_expr == nullptr)
 		return nullptr;
 
@@ -536,13 +710,13 @@ Parser::parseComparisonExpression()
 		if (op == BinaryExpressionAST::NotIn)
 			nextToken();
 
-		std::unique_ptr<ExpressionAST> add_expr = parseAdditionExpression();
-		if (add_expr == nullptr)
+		std::unique_ptr<ExpressionAST> bitor_expr = parseBitwiseOrExpression();
+		if (bitor_expr == nullptr)
 			return nullptr;
 		comp_expr = std::unique_ptr<ExpressionAST>(
 			new BinaryExpressionAST(op,
 						std::move(comp_expr),
-						std::move(add_expr)));
+						std::move(bitor_expr)));
 	}
 	return comp_expr;
 }
@@ -632,16 +806,165 @@ Parser::parseExpression()
 	return or_expr;
 }
 
+/* <annotations> ::=
+ *	(@ <identifier> (\( number \))?)*
+ */
+bool
+Parser::parseAnnotations(std::vector<Annotation> & annotations)
+{
+	while (CurrentToken->getType() == Token::At) {
+		nextToken();
+
+		if (CurrentToken->getType() != Token::Identifier) {
+			TheLexer.reportError("expected identifier (annotation name) after '@'");
+			return false;
+		}
+		std::string name(CurrentToken->getName());
+		nextToken();
+
+		if (CurrentToken->getType() != Token::LeftParenthesis) {
+			annotations.push_back(Annotation(name));
+			continue;
+		}
+		nextToken();
+
+		if (CurrentToken->getType() != Token::Number) {
+			TheLexer.reportError("expected number as argument to '@%s'",
+					     name.c_str());
+			return false;
+		}
+		annotations.push_back(Annotation(name, CurrentToken->getNumber()));
+		nextToken();
+
+		if (CurrentToken->getType() != Token::RightParenthesis) {
+			TheLexer.reportError("expected ')'");
+			return false;
+		}
+		nextToken();
+	}
+	return true;
+}
+
+/* <loop_hints> ::=
+ *	(@unroll | @unroll(number) | @nounroll |
+ *	 @vectorize | @vectorize(number) | @novectorize)*
+ */
+bool
+Parser::parseLoopHints(const std::vector<Annotation> & annotations,
+		       WhileStatementAST::LoopHints & hints)
+{
+	for (const Annotation & annotation : annotations) {
+		const char *name = annotation.Name.c_str();
+		bool takes_argument;
+
+		if (annotation.Name == "unroll") {
+			hints.Unroll = true;
+			hints.UnrollCount = annotation.Argument;
+			takes_argument = true;
+		} else if (annotation.Name == "nounroll") {
+			hints.NoUnroll = true;
+			takes_argument = false;
+		} else if (annotation.Name == "vectorize") {
+			hints.Vectorize = true;
+			hints.VectorizeWidth = annotation.Argument;
+			takes_argument = true;
+		} else if (annotation.Name == "novectorize") {
+			hints.NoVectorize = true;
+			takes_argument = false;
+		} else {
+			TheLexer.reportError("unknown loop annotation '@%s'", name);
+			return false;
+		}
+
+		if (annotation.HasArgument && !takes_argument) {
+			TheLexer.reportError("'@%s' does not take an argument", name);
+			return false;
+		}
+		if (annotation.HasArgument && annotation.Argument <= 0) {
+			TheLexer.reportError("argument to '@%s' must be positive", name);
+			return false;
+		}
+	}
+
+	if (hints.Unroll && hints.NoUnroll) {
+		TheLexer.reportError("conflicting '@unroll' and '@nounroll'");
+		return false;
+	}
+	if (hints.Vectorize && hints.NoVectorize) {
+		TheLexer.reportError("conflicting '@vectorize' and '@novectorize'");
+		return false;
+	}
+	return true;
+}
+
+/* <function_attributes> ::=
+ *	(@hot | @cold | @inline | @noinline | @opt(number))*
+ */
+bool
+Parser::parseFunctionAttributes(const std::vector<Annotation> & annotations,
+				FunctionDefinitionAST::FunctionAttributes & attributes)
+{
+	for (const Annotation & annotation : annotations) {
+		const char *name = annotation.Name.c_str();
+		bool takes_argument = false;
+
+		if (annotation.Name == "hot") {
+			attributes.Hot = true;
+		} else if (annotation.Name == "cold") {
+			attributes.Cold = true;
+		} else if (annotation.Name == "inline") {
+			attributes.Inline = true;
+		} else if (annotation.Name == "noinline") {
+			attributes.NoInline = true;
+		} else if (annotation.Name == "opt") {
+			if (!annotation.HasArgument) {
+				TheLexer.reportError("'@opt' requires an argument");
+				return false;
+			}
+			if (annotation.Argument > 3) {
+				TheLexer.reportError("argument to '@opt' must be "
+						     "between 0 and 3");
+				return false;
+			}
+			attributes.OptLevel = annotation.Argument;
+			takes_argument = true;
+		} else {
+			TheLexer.reportError("unknown function annotation '@%s'", name);
+			return false;
+		}
+
+		if (annotation.HasArgument && !takes_argument) {
+			TheLexer.reportError("'@%s' does not take an argument", name);
+			return false;
+		}
+	}
+
+	if (attributes.Hot && attributes.Cold) {
+		TheLexer.reportError("conflicting '@hot' and '@cold'");
+		return false;
+	}
+	if (attributes.Inline && attributes.NoInline) {
+		TheLexer.reportError("conflicting '@inline' and '@noinline'");
+		return false;
+	}
+	return true;
+}
+
 /* <funcdef> ::=
- *	(extern)? def <identifier> \( (identifier (, identifier)*)? \) : <stmt>+  enddef
+ *	<function_attributes> (extern)? def <identifier>
+ *		\( (identifier (, identifier)*)? \) : <stmt>+  enddef
  */
 std::unique_ptr<FunctionDefinitionAST>
-Parser::parseFunctionDefinition()
+Parser::parseFunctionDefinition(const std::vector<Annotation> & annotations)
 {
 	std::string name;
 	std::vector<std::string> parameters;
 	std::vector<std::shared_ptr<StatementAST>> statements;
 	bool is_extern;
+	FunctionDefinitionAST::FunctionAttributes attributes;
+
+	if (!parseFunctionAttributes(annotations, attributes))
+		return nullptr;
 
 	if (CurrentToken->getType() == Token::Extern) {
 		is_extern = true;
@@ -709,7 +1032,8 @@ Parser::parseFunctionDefinition()
 	} while (CurrentToken->getType() != Token::EndDef);
 
 	return std::unique_ptr<FunctionDefinitionAST>(
-			new FunctionDefinitionAST(name, parameters, statements, is_extern));
+			new FunctionDefinitionAST(name, parameters, statements,
+						  is_extern, attributes));
 }
 
 
@@ -759,6 +1083,41 @@ Parser::parseBreakStatement()
 	return std::unique_ptr<BreakStatementAST>(new BreakStatementAST());
 }
 
+/* <constdef> ::=
+ *	const <identifier> = <expr> ;
+ */
+std::unique_ptr<ConstantDefinitionAST>
+Parser::parseConstantDefinition()
+{
+	assert(CurrentToken->getType() == Token::Const);
+	nextToken();
+
+	if (CurrentToken->getType() != Token::Identifier) {
+		TheLexer.reportError("expected identifier (constant name) after 'const'");
+		return nullptr;
+	}
+	std::string name(CurrentToken->getName());
+	nextToken();
+
+	if (CurrentToken->getType() != Token::Equals) {
+		TheLexer.reportError("expected '='");
+		return nullptr;
+	}
+	nextToken();
+
+	std::unique_ptr<ExpressionAST> expression = parseExpression();
+	if (expression == nullptr)
+		return nullptr;
+
+	if (CurrentToken->getType() != Token::Semicolon) {
+		TheLexer.reportError("expected ';'");
+		return nullptr;
+	}
+
+	return std::unique_ptr<ConstantDefinitionAST>(
+			new ConstantDefinitionAST(name, std::move(expression)));
+}
+
 /* <continue_stmt> ::=
  *	continue ;
  */
@@ -974,7 +1333,7 @@ Parser::parseReturnStatement()
  *	while <expr> : <stmt>+ endwhile
  */
 std::unique_ptr<WhileStatementAST>
-Parser::parseWhileStatement()
+Parser::parseWhileStatement(const WhileStatementAST::LoopHints & hints)
 {
 	assert(CurrentToken->getType() == Token::While);
 
@@ -1000,11 +1359,34 @@ Parser::parseWhileStatement()
 	} while (CurrentToken->getType() != Token::EndWhile);
 
 	return std::unique_ptr<WhileStatementAST>(
-				new WhileStatementAST(std::move(condition), body));
+				new WhileStatementAST(std::move(condition), body,
+						      hints));
+}
+
+/* <annotated_stmt> ::=
+ *	<loop_hints> <while_stmt>
+ *
+ * The annotations have already been parsed.
+ */
+std::unique_ptr<StatementAST>
+Parser::parseAnnotatedStatement(const std::vector<Annotation> & annotations)
+{
+	WhileStatementAST::LoopHints hints;
+
+	if (!parseLoopHints(annotations, hints))
+		return nullptr;
+
+	if (CurrentToken->getType() != Token::While) {
+		TheLexer.reportError("expected 'while' after loop annotations");
+		return nullptr;
+	}
+
+	return parseWhileStatement(hints);
 }
 
 /* <stmt> ::=
- *	<assignment_stmt>
+ *	<annotated_stmt>
+ *	| <assignment_stmt>
  *	| <break_stmt>
  *	| <continue_stmt>
  *	| <expr_stmt>
@@ -1017,7 +1399,13 @@ Parser::parseWhileStatement()
 std::unique_ptr<StatementAST>
 Parser::parseStatement()
 {
+	std::vector<Annotation> annotations;
+
 	switch (CurrentToken->getType()) {
+	case Token::At:
+		if (!parseAnnotations(annotations))
+			return nullptr;
+		return parseAnnotatedStatement(annotations);
 	case Token::Break:
 		return parseBreakStatement();
 	case Token::Continue:
@@ -1046,18 +1434,32 @@ Parser::parseStatement()
 /* <toplevel_item> ::=
  *	<stmt>
  *	| <funcdef>
+ *	| <constdef>
  */
 std::unique_ptr<ASTBase>
 Parser::parseTopLevelItem()
 {
+	std::vector<Annotation> annotations;
+
 	nextToken();
 	switch (CurrentToken->getType()) {
 	case Token::Error:
 	case Token::EndOfFile:
 		return nullptr;
+	case Token::At:
+		// Annotations may precede either a function definition or a
+		// statement.
+		if (!parseAnnotations(annotations))
+			return nullptr;
+		if (CurrentToken->getType() == Token::Def ||
+		    CurrentToken->getType() == Token::Extern)
+			return parseFunctionDefinition(annotations);
+		return parseAnnotatedStatement(annotations);
 	case Token::Def:
 	case Token::Extern:
 		return parseFunctionDefinition();
+	case Token::Const:
+		return parseConstantDefinition();
 	default:
 		return parseStatement();
 	}
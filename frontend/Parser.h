@@ -24,6 +24,26 @@ public:
 
 class StatementAST;
 
+// An annotation of the form "@name" or "@name(number)" preceding a construct
+// in the program.  Annotations are hints to the compiler and do not change the
+// meaning of the program.
+class Annotation {
+public:
+	std::string Name;
+	bool HasArgument;
+	int32_t Argument;
+
+	Annotation(const std::string & name)
+		: Name(name), HasArgument(false), Argument(0)
+	{
+	}
+
+	Annotation(const std::string & name, int32_t argument)
+		: Name(name), HasArgument(true), Argument(argument)
+	{
+	}
+};
+
 // AST representing an entire program
 class ProgramAST : public ASTBase {
 public:
@@ -42,16 +62,67 @@ public:
 // AST representing a function definition
 class FunctionDefinitionAST : public ASTBase {
 public:
+	// Performance attributes given by annotations preceding the function
+	// definition
+	class FunctionAttributes {
+	public:
+		// The function is frequently (@hot) or rarely (@cold) executed
+		bool Hot;
+		bool Cold;
+
+		// Always (@inline) or never (@noinline) inline the function
+		bool Inline;
+		bool NoInline;
+
+		// Optimization level for the function (@opt(0) through
+		// @opt(3)), or -1 to use the default
+		int32_t OptLevel;
+
+		FunctionAttributes()
+			: Hot(false), Cold(false), Inline(false), NoInline(false),
+			  OptLevel(-1)
+		{
+		}
+
+		bool empty() const
+		{
+			return !Hot && !Cold && !Inline && !NoInline && OptLevel < 0;
+		}
+
+		void print(std::ostream & os) const;
+	};
+
 	std::string Name;
 	std::vector<std::string> Parameters;
 	std::vector<std::shared_ptr<StatementAST>> Body;
 	bool IsExtern;
+	FunctionAttributes Attributes;
 
 	FunctionDefinitionAST(const std::string & name,
 			      const std::vector<std::string> & parameters,
 			      const std::vector<std::shared_ptr<StatementAST>> & body,
-			      bool is_extern = false)
-		: Name(name), Parameters(parameters), Body(body), IsExtern(is_extern)
+			      bool is_extern = false,
+			      const FunctionAttributes & attributes = FunctionAttributes())
+		: Name(name), Parameters(parameters), Body(body), IsExtern(is_extern),
+		  Attributes(attributes)
+	{
+	}
+
+	void print(std::ostream & os) const;
+};
+
+class ExpressionAST;
+
+// AST representing a top-level constant definition.  The value of the
+// expression is computed at compile time.
+class ConstantDefinitionAST : public ASTBase {
+public:
+	std::string Name;
+	std::shared_ptr<ExpressionAST> Expression;
+
+	ConstantDefinitionAST(const std::string & name,
+			      std::shared_ptr<ExpressionAST> expression)
+		: Name(name), Expression(expression)
 	{
 	}
 
@@ -215,13 +286,46 @@ public:
 // AST node representing a 'while' statement, including the condition and body.
 class WhileStatementAST : public StatementAST {
 public:
+	// Optimization hints given by annotations preceding the loop
+	class LoopHints {
+	public:
+		// Unroll the loop (@unroll), optionally by the given factor
+		// (@unroll(N)); or don't unroll it at all (@nounroll)
+		bool Unroll;
+		int32_t UnrollCount;
+		bool NoUnroll;
+
+		// Vectorize the loop (@vectorize), optionally with the given
+		// vector width (@vectorize(N)); or don't vectorize it at all
+		// (@novectorize)
+		bool Vectorize;
+		int32_t VectorizeWidth;
+		bool NoVectorize;
+
+		LoopHints()
+			: Unroll(false), UnrollCount(0), NoUnroll(false),
+			  Vectorize(false), VectorizeWidth(0), NoVectorize(false)
+		{
+		}
+
+		bool empty() const
+		{
+			return !Unroll && !NoUnroll && !Vectorize && !NoVectorize;
+		}
+
+		void print(std::ostream & os) const;
+	};
+
 	std::shared_ptr<ExpressionAST> Condition;
 	std::vector<std::shared_ptr<StatementAST>> Body;
+	LoopHints Hints;
 
 	WhileStatementAST(std::shared_ptr<ExpressionAST> condition,
-			  const std::vector<std::shared_ptr<StatementAST>> & body)
+			  const std::vector<std::shared_ptr<StatementAST>> & body,
+			  const LoopHints & hints = LoopHints())
 		: Condition(condition),
-		  Body(body)
+		  Body(body),
+		  Hints(hints)
 	{
 	}
 	void print(std::ostream & os) const;
@@ -265,6 +369,11 @@ public:
 		GreaterThanOrEqualTo,
 		EqualTo,
 		NotEqualTo,
+		BitwiseOr,
+		BitwiseXor,
+		BitwiseAnd,
+		LeftShift,
+		RightShift,
 		Add,
 		Subtract,
 		Multiply,
@@ -322,6 +431,7 @@ public:
 		Not,
 		Minus,
 		Plus,
+		BitwiseNot,
 	};
 
 	enum UnaryOp Op;
@@ -365,6 +475,7 @@ private:
 
 	BinaryExpressionAST::BinaryOp		currentMultiplicationOperator();
 	BinaryExpressionAST::BinaryOp		currentAdditionOperator();
+	BinaryExpressionAST::BinaryOp		currentShiftOperator();
 	BinaryExpressionAST::BinaryOp		currentComparisonOperator();
 	std::unique_ptr<ExpressionAST>          parseNumberExpression();
 	std::unique_ptr<ExpressionAST>          parseIdentifierExpression();
@@ -374,20 +485,39 @@ private:
 	std::unique_ptr<ExpressionAST>          parseUnaryExpression();
 	std::unique_ptr<ExpressionAST>          parseMultiplicationExpression();
 	std::unique_ptr<ExpressionAST>          parseAdditionExpression();
+	std::unique_ptr<ExpressionAST>          parseShiftExpression();
+	std::unique_ptr<ExpressionAST>          parseBitwiseAndExpression();
+	std::unique_ptr<ExpressionAST>          parseBitwiseXorExpression();
+	std::unique_ptr<ExpressionAST>          parseBitwiseOrExpression();
 	std::unique_ptr<ExpressionAST>          parseComparisonExpression();
 	std::unique_ptr<ExpressionAST>          parseNotExpression();
 	std::unique_ptr<ExpressionAST>          parseAndExpression();
 	std::unique_ptr<ExpressionAST>          parseExpression();
+	bool                                    parseAnnotations(
+					std::vector<Annotation> & annotations);
+	bool                                    parseLoopHints(
+					const std::vector<Annotation> & annotations,
+					WhileStatementAST::LoopHints & hints);
+	bool                                    parseFunctionAttributes(
+					const std::vector<Annotation> & annotations,
+					FunctionDefinitionAST::FunctionAttributes & attributes);
 	std::unique_ptr<AssignmentStatementAST> parseAssignmentStatement();
 	std::unique_ptr<BreakStatementAST>      parseBreakStatement();
+	std::unique_ptr<ConstantDefinitionAST>  parseConstantDefinition();
 	std::unique_ptr<ContinueStatementAST>   parseContinueStatement();
 	std::unique_ptr<ExpressionStatementAST> parseExpressionStatement();
-	std::unique_ptr<FunctionDefinitionAST>  parseFunctionDefinition();
+	std::unique_ptr<FunctionDefinitionAST>  parseFunctionDefinition(
+					const std::vector<Annotation> & annotations =
+						std::vector<Annotation>());
 	std::unique_ptr<IfStatementAST>         parseIfStatement();
 	std::unique_ptr<PassStatementAST>       parsePassStatement();
 	std::unique_ptr<PrintStatementAST>      parsePrintStatement();
 	std::unique_ptr<ReturnStatementAST>     parseReturnStatement();
-	std::unique_ptr<WhileStatementAST>      parseWhileStatement();
+	std::unique_ptr<WhileStatementAST>      parseWhileStatement(
+					const WhileStatementAST::LoopHints & hints =
+						WhileStatementAST::LoopHints());
+	std::unique_ptr<StatementAST>           parseAnnotatedStatement(
+					const std::vector<Annotation> & annotations);
 	std::unique_ptr<StatementAST>           parseStatement();
 
 	void nextToken()
@@ -416,9 +546,10 @@ public:
 	// representing it, or nullptr if the input is not a valid program.
 	std::unique_ptr<ProgramAST> parseProgram();
 
-	// Parse the next top-level item (function definition or statement) in
-	// the input program and returns an abstract syntax tree
-	// (FunctionDefinitionAST or StatementAST) representing it, or nullptr
+	// Parse the next top-level item (function definition, constant
+	// definition, or statement) in the input program and returns an
+	// abstract syntax tree (FunctionDefinitionAST, ConstantDefinitionAST,
+	// or StatementAST) representing it, or nullptr
 	// if the input is invalid or if the end of the input was reached.  The
 	// latter two cases can be distinguished by subsequently calling
 	// reachedEndOfFile().
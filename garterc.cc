@@ -2,38 +2,166 @@
 // garterc - An ahead-of-time compiler for the garter language.
 //
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <future>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 
 #include <frontend/Parser.h>
+#include <backend/BuildCache.h>
 #include <backend/LLVMBackend.h>
+#include <garterc_server.h>
 
 #include <llvm/ADT/SmallString.h>
-#include <llvm/ADT/OwningPtr.h>
+#include <llvm/ADT/StringExtras.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FileUtilities.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/Path.h>
 #include <llvm/Support/Program.h>
-#include <llvm/Support/system_error.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/raw_ostream.h>
 
 using namespace garter;
 
 static llvm::SmallString<128> GarterRuntimeDir;
 
+// The runtime library archive, and the linker command for linking programs
+// with it: one argument per line, with the lines "GARTER_INPUTS.o" and
+// "GARTER_OUTPUT" standing for the input files and the output file
+static llvm::SmallString<128> GarterRuntimeLib;
+static std::vector<std::string> LinkArgs;
+
+// Cache of compiled files, if enabled, and hashes of the garterc executable
+// and of the profile file given with -profile-use for the cache keys
+static std::unique_ptr<BuildCache> Cache;
+static std::string CompilerHash;
+static std::string ProfileHash;
+
+// Every option has an explicit default, which the compile server restores
+// before handling each request.
+
+static llvm::cl::list<std::string>
+InputFiles(llvm::cl::Positional, llvm::cl::ZeroOrMore, llvm::cl::desc("<input sources>"));
+
+static llvm::cl::opt<std::string>
+OutputFile("o", llvm::cl::desc("Output filename"), llvm::cl::value_desc("filename"),
+	   llvm::cl::init(""));
+
+static llvm::cl::opt<bool>
+CompileOnly("c", llvm::cl::desc("Compile only (don't link)"), llvm::cl::init(false));
+
+static llvm::cl::opt<bool>
+LLVMIROnly("l", llvm::cl::desc("Generate LLVM IR instead of a native object file (implies no linking)"),
+	   llvm::cl::init(false));
+
+static llvm::cl::opt<bool>
+LTO("lto", llvm::cl::desc("Link-time optimization: compile to LLVM bitcode, and "
+			  "optimize the whole program, including the runtime "
+			  "library, when linking"),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<unsigned>
+OptLevel("O", llvm::cl::Prefix,
+	 llvm::cl::desc("Optimization level (0-3, default 2)"),
+	 llvm::cl::init(2));
+
+static llvm::cl::opt<unsigned>
+SpecializeSizeLimit("specialize-size-limit",
+		    llvm::cl::desc("Don't specialize functions larger than this many instructions"),
+		    llvm::cl::init(200));
+
+static llvm::cl::opt<unsigned>
+SpecializeMaxGrowth("specialize-max-growth",
+		    llvm::cl::desc("Maximum code growth from specializing functions on "
+				   "constant arguments, in percent (0 disables)"),
+		    llvm::cl::init(50));
+
+static llvm::cl::opt<bool>
+ReportSpecializations("report-specializations",
+		      llvm::cl::desc("Report the specialized functions created"),
+		      llvm::cl::init(false));
+
+static llvm::cl::opt<std::string>
+MCPU("mcpu",
+     llvm::cl::desc("CPU to generate code for (default: native, the host's CPU "
+		    "with the features it supports)"),
+     llvm::cl::value_desc("cpu-name"), llvm::cl::init("native"));
+
+static llvm::cl::alias
+MArch("march", llvm::cl::desc("Alias for -mcpu"), llvm::cl::aliasopt(MCPU));
+
 static llvm::cl::list<std::string>
-InputFiles(llvm::cl::Positional, llvm::cl::OneOrMore, llvm::cl::desc("<input sources>"));
+MAttrs("mattr", llvm::cl::CommaSeparated,
+       llvm::cl::desc("Target features to enable (+feature) or disable (-feature)"),
+       llvm::cl::value_desc("+a1,-a2,..."));
+
+static llvm::cl::opt<bool>
+ReportVectorization("report-vectorization",
+		    llvm::cl::desc("Report the loops and code vectorized"),
+		    llvm::cl::init(false));
+
+static llvm::cl::opt<bool>
+ProfileGenerate("profile-generate",
+		llvm::cl::desc("Instrument the program to count how often each "
+			       "function is called and each branch taken, and to "
+			       "add the counts to a profile file on exit "
+			       "($GARTER_PROFILE_FILE, default garter.profile)"),
+		llvm::cl::init(false));
 
 static llvm::cl::opt<std::string>
-OutputFile("o", llvm::cl::desc("Output filename"), llvm::cl::value_desc("filename"));
+ProfileUse("profile-use",
+	   llvm::cl::desc("Optimize for the counts in a profile file written by "
+			  "a program compiled with -profile-generate"),
+	   llvm::cl::value_desc("filename"), llvm::cl::init(""));
+
+static llvm::cl::opt<unsigned>
+Jobs("j", llvm::cl::Prefix,
+     llvm::cl::desc("Number of threads compiling files at once and generating "
+		    "machine code for each file (0 uses one per CPU, default 1)"),
+     llvm::cl::value_desc("N"), llvm::cl::init(1));
 
 static llvm::cl::opt<bool>
-CompileOnly("c", llvm::cl::desc("Compile only (don't link)"));
+ReportCompileTime("report-compile-time",
+		  llvm::cl::desc("Report the time spent in each phase of compilation"),
+		  llvm::cl::init(false));
+
+static llvm::cl::opt<std::string>
+CacheDir("cache-dir",
+	 llvm::cl::desc("Directory in which to cache compiled files (not "
+			"looked up when a report is requested)"),
+	 llvm::cl::value_desc("directory"), llvm::cl::init(""));
+
+static llvm::cl::opt<unsigned>
+CacheSizeLimit("cache-size-limit",
+	       llvm::cl::desc("Maximum size of the cache of compiled files in MiB "
+			      "(default 256)"),
+	       llvm::cl::init(256));
 
 static llvm::cl::opt<bool>
-LLVMIROnly("l", llvm::cl::desc("Generate LLVM IR instead of a native object file (implies no linking)"));
+CacheStats("cache-stats",
+	   llvm::cl::desc("Print statistics about the cache of compiled files"),
+	   llvm::cl::init(false));
+
+static llvm::cl::opt<std::string>
+Server("server",
+       llvm::cl::desc("Run as a compile server listening on the Unix domain "
+		      "socket <path>, for garterc-client.  Up to -j requests are "
+		      "handled at once, each with its own arguments."),
+       llvm::cl::value_desc("path"), llvm::cl::init(""));
 
 std::unique_ptr<ProgramAST>
 parseFile(const char *input_file)
@@ -56,64 +184,315 @@ parseFile(const char *input_file)
 	return program;
 }
 
+// Read LinkArgs from GarterRuntimeDir/link_args, which is written when garterc
+// is built (see runtime/link_args.sh).  LinkArgs is left empty if there's no
+// such file.  This is done once at startup, before any thread that compiles
+// files reads LinkArgs.
+static void
+readLinkArgs()
+{
+	llvm::SmallString<128> path(GarterRuntimeDir);
+	llvm::sys::path::append(path, "link_args");
+	auto file = llvm::MemoryBuffer::getFile(path);
+	if (!file)
+		return;
+
+	llvm::SmallVector<llvm::StringRef, 64> lines;
+	(*file)->getBuffer().split(lines, '\n', -1, false);
+	for (llvm::StringRef line : lines)
+		LinkArgs.push_back(line.str());
+}
+
+// Return the options for compiling with @jobs threads
+static LLVMBackendOptions
+getBackendOptions(unsigned jobs)
+{
+	LLVMBackendOptions options;
+	options.OptLevel = OptLevel;
+	options.SpecializeSizeLimit = SpecializeSizeLimit;
+	options.SpecializeMaxGrowth = SpecializeMaxGrowth;
+	options.ReportSpecializations = ReportSpecializations;
+	options.CompileJobs = jobs;
+	if (!LinkArgs.empty())
+		options.Linker = LinkArgs[0];
+	options.TargetCPU = MCPU;
+	for (const std::string & attr : MAttrs) {
+		if (!options.TargetFeatures.empty())
+			options.TargetFeatures += ",";
+		options.TargetFeatures += attr;
+	}
+	options.ReportVectorization = ReportVectorization;
+	options.ProfileGenerate = ProfileGenerate;
+	options.ProfileUse = ProfileUse;
+	options.ReportCompileTime = ReportCompileTime;
+	return options;
+}
+
+// Return a description of everything besides the source that affects the
+// output of compiling the file @input_file with @jobs threads, for use in cache
+// keys
+static std::string
+getCacheParameters(const char *input_file, unsigned jobs)
+{
+	std::string params;
+	params += "compiler=" + CompilerHash;
+	params += LLVMIROnly ? " ir" : LTO ? " bitcode" : " obj";
+	params += " O" + std::to_string(OptLevel);
+	params += " specialize=" + std::to_string(SpecializeSizeLimit) +
+		  "," + std::to_string(SpecializeMaxGrowth);
+	// Code generated in several partitions is laid out differently
+	params += " partitioned=" + std::to_string(
+			jobs > 1 && canGenerateCodeInParallel(getBackendOptions(jobs)));
+	params += " triple=" + llvm::sys::getDefaultTargetTriple();
+	std::string cpu, features;
+	getTargetCPUAndFeatures(getBackendOptions(jobs), cpu, features);
+	params += " cpu=" + cpu + " features=" + features;
+	// Profiles name functions by their source file
+	if (ProfileGenerate || !ProfileUse.empty()) {
+		params += " source=" + std::string(input_file);
+		params += " profile-generate=" + std::to_string(ProfileGenerate);
+		params += " profile-use=" + ProfileHash;
+	}
+	return params;
+}
+
 static bool
-compileFile(const char *input_file, const char *output_file)
+compileFile(const char *input_file, const char *output_file, unsigned jobs)
 {
+	// With a cache hit, the source file doesn't need to be parsed.  The
+	// reports are printed while compiling, so if one is requested the
+	// file is compiled anyway, and the result stored in the cache.
+	const bool report = ReportSpecializations || ReportVectorization ||
+			    ReportCompileTime;
+	std::string key;
+	if (Cache != nullptr) {
+		auto source = llvm::MemoryBuffer::getFile(input_file);
+		if (source) {
+			key = BuildCache::getKey((*source)->getBuffer(),
+						 getCacheParameters(input_file, jobs));
+			if (!report && Cache->fetch(key, output_file))
+				return true;
+		}
+	}
+
 	std::unique_ptr<ProgramAST> program = parseFile(input_file);
 	if (program == nullptr) {
 		std::cerr << "garterc: Compilation terminated." << std::endl;
 		return false;
 	}
 
-	LLVMBackend backend;
+	LLVMBackendOptions options = getBackendOptions(jobs);
+	options.SourceFileName = input_file;
+	LLVMBackend backend(options);
+	bool ok;
 
 	if (LLVMIROnly)
-		return backend.compileProgramToLLVMIR(*program, output_file);
+		ok = backend.compileProgramToLLVMIR(*program, output_file);
+	else if (LTO)
+		ok = backend.compileProgramToBitcode(*program, output_file);
 	else
-		return backend.compileProgramToObjectFile(*program, output_file);
+		ok = backend.compileProgramToObjectFile(*program, output_file);
+
+	if (ok && !key.empty())
+		Cache->store(key, output_file);
+	return ok;
+}
+
+// Return a hash of the contents of the file @path, or an empty string if it
+// can't be read
+static std::string
+hashFile(const std::string & path)
+{
+	auto file = llvm::MemoryBuffer::getFile(path);
+	if (!file)
+		return "";
+
+	llvm::SHA1 hasher;
+	hasher.update((*file)->getBuffer());
+	return llvm::toHex(hasher.final(), true);
+}
+
+// Return a hash of the contents of the running garterc executable, or an empty
+// string if it can't be read
+static std::string
+hashExecutable(const char *argv0)
+{
+	return hashFile(llvm::sys::fs::getMainExecutable(argv0,
+							 (void *)&hashExecutable));
 }
 
+// Stream buffer that std::cerr is switched to while several files are being
+// compiled at once.  The output of a thread compiling a file is collected in a
+// string for that file, so that it can be printed in the order of the input
+// files instead of interleaved with the output for other files.  Output from
+// other threads goes to the original stream buffer.
+class FileErrorBuffer : public std::streambuf {
+private:
+	std::streambuf *Original;
+	static thread_local std::string *Captured;
+
+protected:
+	int overflow(int c) override
+	{
+		if (c == traits_type::eof())
+			return traits_type::not_eof(c);
+		if (Captured == nullptr)
+			return Original->sputc(c);
+		Captured->push_back(c);
+		return c;
+	}
+
+	std::streamsize xsputn(const char *s, std::streamsize n) override
+	{
+		if (Captured == nullptr)
+			return Original->sputn(s, n);
+		Captured->append(s, n);
+		return n;
+	}
+
+	int sync() override
+	{
+		return Captured == nullptr ? Original->pubsync() : 0;
+	}
+
+public:
+	FileErrorBuffer(std::streambuf *original) : Original(original) { }
+
+	// Collect the output of the calling thread in @captured, or stop
+	// collecting it if @captured is nullptr
+	static void capture(std::string *captured) { Captured = captured; }
+};
+
+thread_local std::string *FileErrorBuffer::Captured = nullptr;
+
+// Compile InputFiles[i] to output_files[i] for each i in @sources.
+//
+// With more than one job and more than one file, the files are compiled
+// concurrently on a pool of up to @jobs threads, and the jobs left over are
+// shared among the files for generating their machine code.  Each file's
+// diagnostics are printed together once it has been compiled, in the order of
+// the input files.  All files are compiled even if some of them fail.
 static bool
-linkObjectFiles(const std::vector<llvm::SmallString<100>> & obj_files,
-		const std::string & output)
+compileFiles(const std::vector<size_t> & sources,
+	     std::vector<llvm::SmallString<100>> & output_files,
+	     unsigned jobs)
 {
-	// Link the provided object files together with any runtime library
-	// objects to create the final executable.
-	//
-	// TODO:  The linking could be done with 'ld' rather than 'gcc' or
-	// 'clang', but it's difficult because with 'ld' all object files must
-	// be named explicitly, even the C runtime startup code for running
-	// main().  Some of these extra object files are provided by glibc and
-	// some are provided by gcc (not even llvm or clang!), so they seem to
-	// be hard to find in all cases...
-
-	std::vector<const char *> argv;
-	argv.push_back("clang");
-	for (auto obj_file : obj_files)
-		argv.push_back(obj_file.c_str());
-
-	llvm::error_code ec;
+	if (jobs == 1 || sources.size() <= 1) {
+		for (size_t i : sources)
+			if (!compileFile(InputFiles[i].c_str(),
+					 output_files[i].c_str(), jobs))
+				return false;
+		return true;
+	}
+
+	const unsigned workers = std::min<size_t>(jobs, sources.size());
+	const unsigned file_jobs = std::max(1U, jobs / workers);
+	std::vector<std::string> errors(sources.size());
+	std::vector<char> succeeded(sources.size());
+	std::vector<std::shared_future<void>> done;
+	std::string failed_files;
+	unsigned failures = 0;
+
+	std::streambuf *original = std::cerr.rdbuf();
+	FileErrorBuffer buffer(original);
+	std::cerr.rdbuf(&buffer);
+	{
+		llvm::ThreadPool pool(llvm::hardware_concurrency(workers));
+
+		for (size_t k = 0; k < sources.size(); k++) {
+			done.push_back(pool.async([&, k]() {
+				const size_t i = sources[k];
+				FileErrorBuffer::capture(&errors[k]);
+				succeeded[k] = compileFile(InputFiles[i].c_str(),
+							   output_files[i].c_str(),
+							   file_jobs);
+				FileErrorBuffer::capture(nullptr);
+			}));
+		}
+		for (size_t k = 0; k < sources.size(); k++) {
+			done[k].wait();
+			std::cerr << errors[k] << std::flush;
+			if (!succeeded[k]) {
+				failed_files += " " + InputFiles[sources[k]];
+				failures++;
+			}
+		}
+	}
+	std::cerr.rdbuf(original);
+
+	if (failures != 0) {
+		std::cerr << "garterc: " << failures << " of " << sources.size()
+			  << " files failed to compile:" << failed_files << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Append the paths of the runtime library's files with the extension @ext
+// (such as ".o") to @files
+static bool
+findRuntimeFiles(const char *ext, std::vector<std::string> & files)
+{
+	std::error_code ec;
 	for (llvm::sys::fs::directory_iterator dir(GarterRuntimeDir.str(), ec), dir_end;
 	     dir != dir_end && !ec; dir.increment(ec))
 	{
-		const std::string & path = dir->path();
-		const llvm::StringRef ext(llvm::sys::path::extension(path));
-		if (ext == ".o")
-			argv.push_back(strdupa(path.c_str()));
+		const std::string path = dir->path();
+		if (llvm::sys::path::extension(path) == ext)
+			files.push_back(path);
 	}
 
 	if (ec) {
 		std::cerr << "ERROR: " << ec.message() << std::endl;
 		return false;
 	}
+	return true;
+}
 
-	argv.push_back("-o");
-	argv.push_back(output.c_str());
-	argv.push_back(nullptr);
-
+static bool
+linkObjectFiles(const std::vector<std::string> & obj_files,
+		const std::string & output)
+{
+	// Link the provided object files together with the runtime library to
+	// create the final executable.
+	//
+	// The linker is run directly, with the C runtime startup code and the
+	// libraries for running main() named explicitly as the C compiler
+	// would name them.  Without the list of them, the C compiler is run
+	// instead to find them, which costs an extra process or two.
+
+	std::vector<llvm::StringRef> argv;
+	std::string program;
+
+	if (LinkArgs.empty()) {
+		auto cc = llvm::sys::findProgramByName("clang");
+		if (!cc) {
+			std::cerr << "ERROR: can't find a linker" << std::endl;
+			return false;
+		}
+		program = *cc;
+		argv.push_back("clang");
+		for (const std::string & obj_file : obj_files)
+			argv.push_back(obj_file);
+		argv.push_back(GarterRuntimeLib);
+		argv.push_back("-o");
+		argv.push_back(output);
+	} else {
+		program = LinkArgs[0];
+		for (const std::string & arg : LinkArgs) {
+			if (arg == "GARTER_INPUTS.o") {
+				for (const std::string & obj_file : obj_files)
+					argv.push_back(obj_file);
+				argv.push_back(GarterRuntimeLib);
+			} else if (arg == "GARTER_OUTPUT") {
+				argv.push_back(output);
+			} else {
+				argv.push_back(arg);
+			}
+		}
+	}
 
-	int ret = llvm::sys::Program::ExecuteAndWait(llvm::sys::Path("/usr/bin/clang"),
-						     argv.data());
+	int ret = llvm::sys::ExecuteAndWait(program, argv);
 	if (ret == -1 || ret == -2)
 		std::cerr << "Failed to run linker" << std::endl;
 	if (ret)
@@ -121,18 +500,63 @@ linkObjectFiles(const std::vector<llvm::SmallString<100>> & obj_files,
 	return true;
 }
 
-int main(int argc, char **argv)
+// Link a program with link-time optimization.  The bitcode files among
+// @input_files are linked together with the bitcode of the runtime library into
+// a single module, which is optimized as a whole and compiled to one object
+// file.  That object file is then linked with the other object files.  Runtime
+// functions that weren't built as bitcode are linked from the runtime library
+// archive, whose other members then aren't needed.
+static bool
+linkWithLTO(const std::vector<std::string> & input_files,
+	    const std::string & output, unsigned jobs)
 {
-	const char *ExecutablePath = realpath(argv[0], nullptr);
-	if (ExecutablePath != nullptr) {
-		GarterRuntimeDir = llvm::StringRef(ExecutablePath);
-		llvm::sys::path::remove_filename(GarterRuntimeDir);
-		llvm::sys::path::append(GarterRuntimeDir, "runtime");
-	} else {
-		GarterRuntimeDir = llvm::StringRef("/usr/lib/garter");
+	std::vector<std::string> bitcode_files;
+	std::vector<std::string> obj_files;
+
+	for (const std::string & file : input_files) {
+		if (llvm::sys::path::extension(file) == ".bc")
+			bitcode_files.push_back(file);
+		else
+			obj_files.push_back(file);
 	}
 
-	llvm::cl::ParseCommandLineOptions(argc, argv, "garter compiler\n");
+	// Object files given on the command line may refer to anything in
+	// the bitcode, but runtime objects don't refer to garter code.
+	const bool internalize = obj_files.empty();
+
+	if (!findRuntimeFiles(".bc", bitcode_files))
+		return false;
+
+	llvm::SmallString<128> lto_obj;
+	std::error_code ec = llvm::sys::fs::createTemporaryFile("garter-lto", "o",
+								lto_obj);
+	if (ec) {
+		std::cerr << "ERROR: " << ec.message() << std::endl;
+		return false;
+	}
+	llvm::FileRemover remover(lto_obj);
+
+	LLVMBackend backend(getBackendOptions(jobs));
+	if (!backend.linkBitcodeFiles(bitcode_files, internalize, lto_obj.c_str()))
+		return false;
+
+	obj_files.push_back(lto_obj.str().str());
+	return linkObjectFiles(obj_files, output);
+}
+
+// Compile and link as the command line options say, and return the exit status
+static int
+runCompiler(const char *argv0)
+{
+	if (InputFiles.empty()) {
+		std::cerr << "ERROR: no input files" << std::endl;
+		return 2;
+	}
+
+	if (OptLevel > 3) {
+		std::cerr << "ERROR: invalid optimization level -O" << OptLevel << std::endl;
+		return 2;
+	}
 
 	bool do_link = !CompileOnly && !LLVMIROnly;
 
@@ -144,12 +568,37 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (ProfileUse.length() > 0) {
+		ProfileHash = hashFile(ProfileUse);
+		if (ProfileHash.empty()) {
+			std::cerr << "ERROR: can't read profile " << ProfileUse
+				  << std::endl;
+			return 2;
+		}
+	}
+
+	if (CacheDir.length() > 0) {
+		CompilerHash = hashExecutable(argv0);
+		if (CompilerHash.empty())
+			std::cerr << "ERROR: can't read the garterc executable; "
+				"not using the cache" << std::endl;
+		else
+			Cache.reset(new BuildCache(CacheDir,
+						   (uint64_t)CacheSizeLimit << 20));
+	}
+
+	unsigned jobs = Jobs;
+	if (jobs == 0)
+		jobs = std::max(1U, std::thread::hardware_concurrency());
+
 	std::vector<llvm::SmallString<100>> output_files(InputFiles.size());
+	std::vector<size_t> sources;
 	for (size_t i = 0; i < InputFiles.size(); i++) {
 		const std::string & input_file = InputFiles[i];
 		const char *extension;
 
-		if (llvm::sys::path::extension(input_file) == ".o") {
+		if (llvm::sys::path::extension(input_file) == ".o" ||
+		    llvm::sys::path::extension(input_file) == ".bc") {
 			output_files[i] = input_file;
 			continue;
 		}
@@ -160,14 +609,27 @@ int main(int argc, char **argv)
 			output_files[i] = input_file;
 			if (LLVMIROnly)
 				extension = ".ll";
+			else if (LTO)
+				extension = ".bc";
 			else
 				extension = ".o";
 			llvm::sys::path::replace_extension(output_files[i], extension);
 		}
-		if (!compileFile(input_file.c_str(), output_files[i].c_str()))
-			return 3;
+		sources.push_back(i);
 	}
 
+	const bool compiled = compileFiles(sources, output_files, jobs);
+
+	if (CacheStats && Cache != nullptr) {
+		std::cerr << "build cache: " << Cache->Hits << " hits, "
+			  << Cache->Misses << " misses, "
+			  << Cache->Stores << " stored, "
+			  << Cache->Evictions << " evicted" << std::endl;
+	}
+
+	if (!compiled)
+		return 3;
+
 	if (do_link) {
 		std::string exe_file;
 
@@ -176,9 +638,185 @@ int main(int argc, char **argv)
 		else
 			exe_file = "a.out";
 
-		if (!linkObjectFiles(output_files, exe_file))
-			return 4;
+		std::vector<std::string> link_files;
+		for (const auto & file : output_files)
+			link_files.push_back(file.str().str());
+
+		if (LTO) {
+			if (!linkWithLTO(link_files, exe_file, jobs))
+				return 4;
+		} else {
+			if (!linkObjectFiles(link_files, exe_file))
+				return 4;
+		}
+	}
+
+	return 0;
+}
+
+// Set when the server is interrupted or terminated.  The listening socket is
+// also shut down, since the signal may arrive just before the server waits for
+// a connection.
+static volatile sig_atomic_t ServerStopping;
+static int ServerSocket = -1;
+
+static void
+stopServer(int)
+{
+	ServerStopping = 1;
+	if (ServerSocket >= 0)
+		shutdown(ServerSocket, SHUT_RDWR);
+}
+
+// Handle the request of the client connected to @conn.  This runs in a process
+// forked from the server for the request, so the request has its own working
+// directory and options, and the client's standard input, output and error.
+static int
+handleRequest(int conn, const char *argv0)
+{
+	std::vector<std::string> request;
+	int fds[3];
+
+	if (!receiveCompileRequest(conn, request, fds))
+		return 1;
+	for (int fd = 0; fd < 3; fd++) {
+		dup2(fds[fd], fd);
+		close(fds[fd]);
+	}
+
+	int status;
+	std::vector<const char *> args;
+	for (size_t i = 1; i < request.size(); i++)
+		args.push_back(request[i].c_str());
+
+	llvm::cl::ResetAllOptionOccurrences();
+	if (chdir(request[0].c_str()) != 0) {
+		std::cerr << "ERROR: can't change to directory " << request[0]
+			  << ": " << strerror(errno) << std::endl;
+		status = 1;
+	} else if (!llvm::cl::ParseCommandLineOptions(args.size(), args.data(),
+						      "garter compiler\n",
+						      &llvm::errs())) {
+		status = 1;
+	} else if (Server.length() > 0) {
+		std::cerr << "ERROR: -server can't be sent to a compile server"
+			  << std::endl;
+		status = 2;
+	} else {
+		status = runCompiler(argv0);
+	}
+
+	std::cout.flush();
+	std::cerr.flush();
+	llvm::outs().flush();
+	llvm::errs().flush();
+	const int32_t reply = status;
+	writeAll(conn, &reply, sizeof(reply));
+	return status;
+}
+
+// Run a compile server listening on the socket Server until it's interrupted or
+// terminated.  LLVM is initialized once, then each request is handled in a
+// forked process, with up to @jobs requests at once.
+static int
+runServer(unsigned jobs, const char *argv0)
+{
+	struct sockaddr_un addr;
+
+	// The socket is bound to a temporary name, then renamed once it's
+	// listening, so clients never see a socket that refuses connections.
+	const std::string path = Server;
+	const std::string tmp_path = path + ".tmp";
+	if (tmp_path.length() >= sizeof(addr.sun_path)) {
+		std::cerr << "ERROR: socket path too long: " << path << std::endl;
+		return 2;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, tmp_path.c_str());
+
+	// Do the work that every request would otherwise repeat
+	std::string cpu, features;
+	getTargetCPUAndFeatures(getBackendOptions(1), cpu, features);
+
+	int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	ServerSocket = sock;
+
+	struct sigaction act;
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = stopServer;
+	sigaction(SIGINT, &act, nullptr);
+	sigaction(SIGTERM, &act, nullptr);
+
+	unlink(tmp_path.c_str());
+	if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(sock, 128) != 0 || rename(tmp_path.c_str(), path.c_str()) != 0) {
+		std::cerr << "ERROR: can't listen on " << path << ": "
+			  << strerror(errno) << std::endl;
+		unlink(tmp_path.c_str());
+		return 1;
+	}
+
+	unsigned running = 0;
+	while (!ServerStopping) {
+		// Reap the finished requests, waiting for one if there are
+		// already @jobs of them
+		while (running > 0 &&
+		       waitpid(-1, nullptr, running >= jobs ? 0 : WNOHANG) > 0)
+			running--;
+
+		int conn = accept4(sock, nullptr, nullptr, SOCK_CLOEXEC);
+		if (conn < 0) {
+			if (!ServerStopping && errno != EINTR &&
+			    errno != ECONNABORTED)
+				std::cerr << "ERROR: accept: " << strerror(errno)
+					  << std::endl;
+			continue;
+		}
+
+		pid_t pid = fork();
+		if (pid == 0) {
+			signal(SIGINT, SIG_DFL);
+			signal(SIGTERM, SIG_DFL);
+			close(sock);
+			_exit(handleRequest(conn, argv0));
+		}
+		if (pid < 0)
+			std::cerr << "ERROR: fork: " << strerror(errno) << std::endl;
+		else
+			running++;
+		close(conn);
 	}
 
+	unlink(path.c_str());
+	close(sock);
+	while (running > 0 && waitpid(-1, nullptr, 0) > 0)
+		running--;
 	return 0;
 }
+
+int main(int argc, char **argv)
+{
+	const char *ExecutablePath = realpath(argv[0], nullptr);
+	if (ExecutablePath != nullptr) {
+		GarterRuntimeDir = llvm::StringRef(ExecutablePath);
+		llvm::sys::path::remove_filename(GarterRuntimeDir);
+		llvm::sys::path::append(GarterRuntimeDir, "runtime");
+	} else {
+		GarterRuntimeDir = llvm::StringRef("/usr/lib/garter");
+	}
+	GarterRuntimeLib = GarterRuntimeDir;
+	llvm::sys::path::append(GarterRuntimeLib, "libgarter.a");
+	readLinkArgs();
+
+	llvm::cl::ParseCommandLineOptions(argc, argv, "garter compiler\n");
+
+	if (Server.length() > 0) {
+		unsigned jobs = Jobs;
+		if (jobs == 0)
+			jobs = std::max(1U, std::thread::hardware_concurrency());
+		return runServer(jobs, argv[0]);
+	}
+
+	return runCompiler(argv[0]);
+}
@@ -0,0 +1,100 @@
+//
+// garterc-client - Compile with a garterc compile server (garterc -server).
+//
+// Usage: garterc-client SOCKET [garterc arguments...]
+//
+// The arguments are handled by the server as garterc would handle them, in the
+// client's working directory, and the client exits with garterc's exit status.
+// Starting a garterc process costs more than compiling a small file, mostly to
+// load and initialize LLVM, so the client isn't linked with LLVM.  If the
+// server can't be reached, garterc is run instead.
+//
+
+#include <iostream>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <garterc_server.h>
+
+using namespace garter;
+
+// Connect to the server listening on @path.  Returns -1 on failure.
+static int
+connectToServer(const char *path)
+{
+	struct sockaddr_un addr;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+		return -1;
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+// Run the garterc next to this program with @argv's garterc arguments
+static int
+runGarterc(char **argv)
+{
+	std::string garterc = "garterc";
+	char *path = realpath("/proc/self/exe", nullptr);
+
+	if (path != nullptr) {
+		garterc = path;
+		garterc.erase(garterc.rfind('/') + 1);
+		garterc += "garterc";
+		free(path);
+	}
+	argv[1] = (char *)"garterc";
+	execv(garterc.c_str(), &argv[1]);
+	std::cerr << "ERROR: can't run " << garterc << ": " << strerror(errno)
+		  << std::endl;
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0]
+			  << " SOCKET [garterc arguments...]" << std::endl;
+		return 2;
+	}
+
+	int sock = connectToServer(argv[1]);
+	if (sock < 0)
+		return runGarterc(argv);
+
+	char cwd[PATH_MAX];
+	if (getcwd(cwd, sizeof(cwd)) == nullptr) {
+		std::cerr << "ERROR: can't get the working directory: "
+			  << strerror(errno) << std::endl;
+		return 1;
+	}
+
+	std::vector<std::string> request = { cwd, "garterc" };
+	for (int i = 2; i < argc; i++)
+		request.push_back(argv[i]);
+
+	int32_t status;
+	if (!sendCompileRequest(sock, request) ||
+	    !readAll(sock, &status, sizeof(status))) {
+		std::cerr << "ERROR: the compile server at " << argv[1]
+			  << " failed to handle the request" << std::endl;
+		return 1;
+	}
+	return status;
+}
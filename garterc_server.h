@@ -0,0 +1,140 @@
+//
+// The protocol between garterc -server and garterc-client.
+//
+// The client connects to the server's Unix domain socket and sends the
+// request: a 32-bit length, then that many bytes holding the client's working
+// directory and its arguments for garterc, each terminated by a null byte.
+// The client's standard input, output and error are passed along with the
+// length, so the server prints diagnostics directly to the client's terminal
+// or log.  When the server is done, it replies with garterc's 32-bit exit
+// status and closes the connection.
+//
+// This doesn't use LLVM, since garterc-client isn't linked with it.
+//
+
+#ifndef _GARTERC_SERVER_H_
+#define _GARTERC_SERVER_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+
+namespace garter {
+
+static inline bool
+writeAll(int fd, const void *buf, size_t size)
+{
+	const char *p = (const char *)buf;
+
+	while (size != 0) {
+		ssize_t ret = write(fd, p, size);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return false;
+		p += ret;
+		size -= ret;
+	}
+	return true;
+}
+
+static inline bool
+readAll(int fd, void *buf, size_t size)
+{
+	char *p = (char *)buf;
+
+	while (size != 0) {
+		ssize_t ret = read(fd, p, size);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return false;
+		p += ret;
+		size -= ret;
+	}
+	return true;
+}
+
+// Send a request made of @strings (the working directory, then the arguments)
+// over @sock, passing along the file descriptors 0, 1 and 2
+static inline bool
+sendCompileRequest(int sock, const std::vector<std::string> & strings)
+{
+	std::string payload;
+	for (const std::string & s : strings) {
+		payload += s;
+		payload.push_back('\0');
+	}
+	uint32_t length = payload.size();
+
+	const int fds[3] = { 0, 1, 2 };
+	char control[CMSG_SPACE(sizeof(fds))];
+	struct iovec iov = { &length, sizeof(length) };
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	ssize_t ret;
+	do {
+		ret = sendmsg(sock, &msg, 0);
+	} while (ret < 0 && errno == EINTR);
+	if (ret != sizeof(length))
+		return false;
+	return writeAll(sock, payload.data(), payload.size());
+}
+
+// Receive a request sent by sendCompileRequest() over @sock into @strings, and
+// the client's file descriptors 0, 1 and 2 into @fds
+static inline bool
+receiveCompileRequest(int sock, std::vector<std::string> & strings, int fds[3])
+{
+	uint32_t length;
+	char control[CMSG_SPACE(3 * sizeof(int))];
+	struct iovec iov = { &length, sizeof(length) };
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	ssize_t ret;
+	do {
+		ret = recvmsg(sock, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+	} while (ret < 0 && errno == EINTR);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (ret != sizeof(length) || cmsg == nullptr ||
+	    cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+	    cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+		return false;
+	memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+
+	std::string payload(length, '\0');
+	if (!readAll(sock, &payload[0], length))
+		return false;
+	for (size_t start = 0; start < payload.size(); ) {
+		size_t end = payload.find('\0', start);
+		if (end == std::string::npos)
+			return false;
+		strings.push_back(payload.substr(start, end - start));
+		start = end + 1;
+	}
+	return strings.size() >= 2;
+}
+
+} // End garter namespace
+
+#endif /* _GARTERC_SERVER_H_ */
@@ -3,35 +3,177 @@
 //
 
 #include <frontend/Parser.h>
+#include <backend/BytecodeBackend.h>
 #include <backend/LLVMBackend.h>
+#include <backend/TemplateJITBackend.h>
+#include <backend/TreeWalkingBackend.h>
 #include <fstream>
 #include <iostream>
 #include <string.h>
 #include <errno.h>
 
+#include <llvm/Support/CommandLine.h>
+
+// Bitcode of the runtime library, terminated by an entry with a null Name.
+// Defined in runtime_bitcode.cc, which is generated at build time.
+extern const garter::EmbeddedBitcode garter_runtime_bitcode[];
+
+static llvm::cl::opt<std::string>
+InputFile(llvm::cl::Positional, llvm::cl::desc("<input source>"));
+
+static llvm::cl::opt<bool>
+Interactive("interactive",
+	    llvm::cl::desc("Execute the input file one top-level item at a time, "
+			   "as is done for standard input"));
+
+enum BackendKind {
+	LLVMBackendKind,
+	TreeWalkingBackendKind,
+	BytecodeBackendKind,
+	TemplateJITBackendKind,
+};
+
+static llvm::cl::opt<BackendKind>
+BackendType("backend", llvm::cl::desc("Backend executing the program:"),
+	    llvm::cl::values(
+		clEnumValN(LLVMBackendKind, "llvm",
+			   "JIT compile the program with LLVM (default)"),
+		clEnumValN(TreeWalkingBackendKind, "tree",
+			   "Interpret the syntax tree of the program"),
+		clEnumValN(BytecodeBackendKind, "bytecode",
+			   "Compile the program to bytecode and interpret it"),
+		clEnumValN(TemplateJITBackendKind, "template",
+			   "Compile the program to x86-64 code from templates, "
+			   "without optimization")),
+	    llvm::cl::init(LLVMBackendKind));
+
+static llvm::cl::opt<unsigned>
+OptLevel("O", llvm::cl::Prefix,
+	 llvm::cl::desc("Optimization level for JIT-compiled code (0-3, default 2)"),
+	 llvm::cl::init(2));
+
+static llvm::cl::opt<bool>
+ReportCompileTime("report-compile-time",
+		  llvm::cl::desc("Report the time spent compiling each statement"));
+
+static llvm::cl::opt<unsigned>
+TierUpThreshold("tier-up-threshold",
+		llvm::cl::desc("Number of calls plus loop iterations after which a "
+			       "function is recompiled at the full optimization "
+			       "level (0 disables tiered compilation)"),
+		llvm::cl::init(1000));
+
+static llvm::cl::opt<unsigned>
+BaselineOptLevel("baseline-opt-level",
+		 llvm::cl::desc("Optimization level at which functions are first "
+				"compiled with tiered compilation"),
+		 llvm::cl::init(0));
+
+static llvm::cl::opt<bool>
+LazyIR("lazy-ir",
+       llvm::cl::desc("Generate the IR for functions only when they are first "
+		      "referenced (default true)"),
+       llvm::cl::init(true));
+
+static llvm::cl::opt<bool>
+InlineRuntime("inline-runtime",
+	      llvm::cl::desc("Let JIT-compiled code inline the runtime library's "
+			     "functions (default true)"),
+	      llvm::cl::init(true));
+
+static llvm::cl::opt<std::string>
+CacheDir("cache-dir",
+	 llvm::cl::desc("Directory in which to cache compiled machine code"),
+	 llvm::cl::value_desc("directory"));
+
+static llvm::cl::opt<unsigned>
+CacheSizeLimit("cache-size-limit",
+	       llvm::cl::desc("Maximum size of the machine code cache in MiB "
+			      "(default 64)"),
+	       llvm::cl::init(64));
+
+static llvm::cl::opt<bool>
+JITStats("jit-stats",
+	 llvm::cl::desc("Print statistics about JIT compilation on exit"));
+
+static llvm::cl::opt<unsigned>
+JITThreads("jit-threads",
+	   llvm::cl::desc("Number of threads for compiling functions in the "
+			  "background (0 compiles functions when first called)"),
+	   llvm::cl::init(0));
+
 int main(int argc, char **argv)
 {
+	llvm::cl::ParseCommandLineOptions(argc, argv, "garter interpreter\n");
+
+	if (OptLevel > 3 || BaselineOptLevel > 3) {
+		std::cerr << "ERROR: optimization levels must be 0-3" << std::endl;
+		return 2;
+	}
+
 	std::istream *is;
 	std::ifstream infile;
-	if (argc > 1) {
-		infile.open(argv[1]);
+	if (InputFile.length() > 0) {
+		infile.open(InputFile);
 		if (infile.fail()) {
-			std::cerr << "Can't open " << argv[1] << ": " << strerror(errno) << std::endl;
+			std::cerr << "Can't open " << InputFile << ": " << strerror(errno) << std::endl;
 			return 1;
 		}
 		is = &infile;
 	} else {
 		is = &std::cin;
 	}
+
+	garter::LLVMBackendOptions options;
+	options.OptLevel = OptLevel;
+	options.JITCompileThreads = JITThreads;
+	options.ReportCompileTime = ReportCompileTime;
+	options.BaselineOptLevel = BaselineOptLevel;
+	options.TierUpThreshold = TierUpThreshold;
+	options.LazyIRGeneration = LazyIR;
+	options.CacheDir = CacheDir;
+	options.CacheSizeLimit = (uint64_t)CacheSizeLimit << 20;
+	if (InlineRuntime) {
+		for (const garter::EmbeddedBitcode *file = garter_runtime_bitcode;
+		     file->Name != nullptr; file++)
+			options.RuntimeBitcode.push_back(*file);
+	}
+
 	garter::Parser parser(*is);
-	garter::LLVMBackend backend;
-	std::unique_ptr<garter::ASTBase> top_level_item;
+	std::unique_ptr<garter::Backend> backend;
+	garter::LLVMBackend *llvm_backend = nullptr;
+	int ret = 0;
 
-	while ((top_level_item = parser.parseTopLevelItem()) != nullptr)
-		backend.executeTopLevelItem(std::move(top_level_item));
+	if (BackendType == TreeWalkingBackendKind) {
+		backend.reset(new garter::TreeWalkingBackend());
+	} else if (BackendType == BytecodeBackendKind) {
+		backend.reset(new garter::BytecodeBackend());
+	} else if (BackendType == TemplateJITBackendKind) {
+		backend.reset(new garter::TemplateJITBackend());
+	} else {
+		llvm_backend = new garter::LLVMBackend(options);
+		backend.reset(llvm_backend);
+	}
+
+	if (is == &infile && !Interactive) {
+		// Compile the whole file as one program, as garterc does
+		std::unique_ptr<garter::ProgramAST> program = parser.parseProgram();
+		if (program == nullptr)
+			ret = 3;
+		else if (!backend->executeProgram(*program))
+			ret = 4;
+	} else {
+		std::unique_ptr<garter::ASTBase> top_level_item;
+
+		while ((top_level_item = parser.parseTopLevelItem()) != nullptr)
+			backend->executeTopLevelItem(std::move(top_level_item));
+
+		if (!parser.reachedEndOfFile())
+			ret = 3;
+	}
 
-	if (!parser.reachedEndOfFile())
-		return 3;
+	if (JITStats && llvm_backend != nullptr)
+		llvm_backend->printJITStatistics(std::cerr);
 
-	return 0;
+	return ret;
 }
@@ -0,0 +1,38 @@
+#!/bin/bash
+#
+# Usage: embed_bitcode.sh BITCODE_FILE...
+#
+# Write to standard output a C++ source file defining
+# garter_runtime_bitcode[], an array holding the contents of the given bitcode
+# files, terminated by an entry with a null Name.  garteri is linked with it so
+# that JIT-compiled code can inline the runtime library.
+#
+
+set -e -u
+
+cat << EOF
+// Generated by ${0##*/} from: $*
+// Do not edit.
+
+#include <backend/LLVMBackend.h>
+EOF
+
+i=0
+for file in "$@"; do
+	echo
+	echo "alignas(4) static const unsigned char bitcode${i}[] = {"
+	od -An -v -tx1 "$file" | sed -e 's/ \([0-9a-f][0-9a-f]\)/0x\1,/g' \
+				     -e 's/^/\t/'
+	echo "};"
+	i=$((i + 1))
+done
+
+echo
+echo "extern const garter::EmbeddedBitcode garter_runtime_bitcode[] = {"
+i=0
+for file in "$@"; do
+	echo "	{ \"${file}\", bitcode${i}, sizeof(bitcode${i}) },"
+	i=$((i + 1))
+done
+echo "	{ nullptr, nullptr, 0 },"
+echo "};"
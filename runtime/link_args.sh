@@ -0,0 +1,44 @@
+#!/bin/bash
+#
+# Usage: link_args.sh C_COMPILER
+#
+# Write to standard output the linker command with which C_COMPILER links a C
+# program, one argument per line, with the program's input files replaced by a
+# line "GARTER_INPUTS.o" and its output file by a line "GARTER_OUTPUT".  garterc
+# runs the linker directly with these arguments, which name the C runtime
+# startup files and libraries, instead of running the compiler driver (which
+# runs the linker through another program) for every program it links.
+#
+
+set -e -u
+
+cc=$1
+
+# The linker command is the last one printed by the driver
+command=$("$cc" -### GARTER_INPUTS.o -o GARTER_OUTPUT 2>&1 | grep '^ ' | tail -n 1)
+if [ -z "$command" ]; then
+	echo "${0##*/}: can't get the link command of $cc" 1>&2
+	exit 1
+fi
+eval "set -- $command"
+
+# gcc runs the linker through collect2
+linker=$("$cc" -print-prog-name=ld)
+linker=$(command -v "$linker")
+echo "$linker"
+shift
+
+# The plugin for gcc's link-time optimization isn't needed
+while [ $# -gt 0 ]; do
+	case "$1" in
+	-plugin)
+		shift
+		;;
+	-plugin-opt=*)
+		;;
+	*)
+		echo "$1"
+		;;
+	esac
+	shift
+done
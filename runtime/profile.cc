@@ -0,0 +1,201 @@
+//
+// Profile counters of programs compiled with garterc -profile-generate.
+//
+// Each instrumented object file registers its counters from a constructor.
+// When the program exits, the counts are added to those already in the profile
+// file, so that the file accumulates the counts of several runs.  The file has
+// one line per function:
+//
+//	<source file>:<function> <count> <count> ...
+//
+// with the function's entry count followed by, for each conditional branch,
+// the number of times it went each way.  The compiler escapes whitespace and
+// '%' in names as "%XX", so names never contain spaces.
+//
+// Like the rest of the runtime library, this is linked without the C++ library,
+// so it doesn't use it.
+//
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Counters of one object file, and the layout describing them: a line
+// "<name> <number of counters>" for each function, in counter order
+struct ProfileModule {
+	const char *Layout;
+	uint64_t *Counters;
+	struct ProfileModule *Next;
+};
+
+// Counts of one function
+struct ProfileRecord {
+	char *Name;
+	size_t NumCounters;
+	uint64_t *Counters;
+};
+
+static struct ProfileModule *registered_modules;
+
+static struct ProfileRecord *records;
+static size_t num_records;
+
+static struct ProfileRecord *find_record(const char *name, size_t name_len)
+{
+	for (size_t i = 0; i < num_records; i++)
+		if (strlen(records[i].Name) == name_len &&
+		    memcmp(records[i].Name, name, name_len) == 0)
+			return &records[i];
+	return NULL;
+}
+
+static struct ProfileRecord *add_record(const char *name, size_t name_len,
+					size_t num_counters)
+{
+	struct ProfileRecord *new_records;
+	struct ProfileRecord *record;
+
+	new_records = (struct ProfileRecord *)
+		realloc(records, (num_records + 1) * sizeof(records[0]));
+	if (new_records == NULL)
+		return NULL;
+	records = new_records;
+
+	record = &records[num_records];
+	record->Name = strndup(name, name_len);
+	record->NumCounters = num_counters;
+	record->Counters = (uint64_t *)calloc(num_counters ? num_counters : 1,
+					      sizeof(uint64_t));
+	if (record->Name == NULL || record->Counters == NULL)
+		return NULL;
+	num_records++;
+	return record;
+}
+
+// Read the records already in the profile file, if it exists
+static void read_profile(const char *filename)
+{
+	FILE *fp = fopen(filename, "r");
+	char *line = NULL;
+	size_t line_size = 0;
+
+	if (fp == NULL)
+		return;
+
+	while (getline(&line, &line_size, fp) > 0) {
+		char *p = line;
+		char *name = strsep(&p, " \n");
+		struct ProfileRecord *record;
+		size_t n = 0;
+
+		if (name == NULL || *name == '\0')
+			continue;
+		for (char *q = p; q != NULL && *q != '\0'; q++)
+			if (*q == ' ')
+				n++;
+
+		record = add_record(name, strlen(name), n + 1);
+		if (record == NULL)
+			break;
+		for (n = 0; p != NULL && *p != '\0' && *p != '\n'; n++) {
+			char *end;
+			uint64_t count = strtoull(p, &end, 10);
+			if (end == p)
+				break;
+			record->Counters[n] = count;
+			p = end;
+			p += strspn(p, " ");
+		}
+		record->NumCounters = n;
+	}
+	free(line);
+	fclose(fp);
+}
+
+// Add the counts of the registered modules to the records.  A function whose
+// number of counters changed since the file was written starts over.
+static void merge_counters(void)
+{
+	for (struct ProfileModule *mod = registered_modules; mod != NULL;
+	     mod = mod->Next) {
+		const char *p = mod->Layout;
+		uint64_t *counters = mod->Counters;
+
+		while (*p != '\0') {
+			const char *name = p;
+			size_t name_len = strcspn(p, " ");
+			size_t num_counters;
+			struct ProfileRecord *record;
+			char *end;
+
+			// A layout this doesn't understand is ignored
+			num_counters = strtoul(p + name_len, &end, 10);
+			if (end == p + name_len || (*end != '\n' && *end != '\0'))
+				return;
+			p = end + strspn(end, "\n");
+
+			record = find_record(name, name_len);
+			if (record != NULL && record->NumCounters != num_counters) {
+				record->NumCounters = num_counters;
+				free(record->Counters);
+				record->Counters = (uint64_t *)
+					calloc(num_counters ? num_counters : 1,
+					       sizeof(uint64_t));
+				if (record->Counters == NULL)
+					return;
+			}
+			if (record == NULL)
+				record = add_record(name, name_len, num_counters);
+			if (record == NULL)
+				return;
+
+			for (size_t i = 0; i < num_counters; i++)
+				record->Counters[i] += counters[i];
+			counters += num_counters;
+		}
+	}
+}
+
+static void write_profile(void)
+{
+	const char *filename = getenv("GARTER_PROFILE_FILE");
+	FILE *fp;
+
+	if (filename == NULL || *filename == '\0')
+		filename = "garter.profile";
+
+	read_profile(filename);
+	merge_counters();
+
+	fp = fopen(filename, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "garter: can't write profile to %s\n", filename);
+		return;
+	}
+	for (size_t i = 0; i < num_records; i++) {
+		fputs(records[i].Name, fp);
+		for (size_t j = 0; j < records[i].NumCounters; j++)
+			fprintf(fp, " %" PRIu64, records[i].Counters[j]);
+		fputc('\n', fp);
+	}
+	if (fclose(fp) != 0)
+		fprintf(stderr, "garter: error writing profile to %s\n", filename);
+}
+
+extern "C"
+void __garter_profile_register(const char *layout, uint64_t *counters)
+{
+	struct ProfileModule *mod =
+		(struct ProfileModule *)malloc(sizeof(struct ProfileModule));
+
+	if (mod == NULL)
+		return;
+	if (registered_modules == NULL)
+		atexit(write_profile);
+	mod->Layout = layout;
+	mod->Counters = counters;
+	mod->Next = registered_modules;
+	registered_modules = mod;
+}
@@ -0,0 +1,122 @@
+// Generated by embed_bitcode.sh from: runtime/exponentiate.bc
+// Do not edit.
+
+#include <backend/LLVMBackend.h>
+
+alignas(4) static const unsigned char bitcode0[] = {
+	0x42,0x43,0xc0,0xde,0x35,0x14,0x00,0x00,0x05,0x00,0x00,0x00,0x62,0x0c,0x30,0x24,
+	0x4a,0x59,0xbe,0x66,0x8d,0xfb,0xb4,0xaf,0x0b,0x51,0x80,0x4c,0x01,0x00,0x00,0x00,
+	0x21,0x0c,0x00,0x00,0x72,0x01,0x00,0x00,0x0b,0x02,0x21,0x00,0x02,0x00,0x00,0x00,
+	0x16,0x00,0x00,0x00,0x07,0x81,0x23,0x91,0x41,0xc8,0x04,0x49,0x06,0x10,0x32,0x39,
+	0x92,0x01,0x84,0x0c,0x25,0x05,0x08,0x19,0x1e,0x04,0x8b,0x62,0x80,0x10,0x45,0x02,
+	0x42,0x92,0x0b,0x42,0x84,0x10,0x32,0x14,0x38,0x08,0x18,0x4b,0x0a,0x32,0x42,0x88,
+	0x48,0x70,0xc4,0x21,0x23,0x44,0x12,0x87,0x8c,0x10,0x41,0x92,0x02,0x64,0xc8,0x08,
+	0xb1,0x14,0x20,0x43,0x46,0x88,0x20,0xc9,0x01,0x32,0x42,0x84,0x18,0x2a,0x28,0x2a,
+	0x90,0x31,0x7c,0xb0,0x5c,0x91,0x20,0xc4,0xc8,0x00,0x00,0x00,0x89,0x20,0x00,0x00,
+	0x0e,0x00,0x00,0x00,0x32,0x22,0x08,0x09,0x20,0x62,0x46,0x00,0x21,0x2b,0x24,0x98,
+	0x10,0x21,0x25,0x24,0x98,0x10,0x19,0x27,0x0c,0x85,0xa4,0x90,0x60,0x42,0x64,0x5c,
+	0x20,0x24,0x64,0x82,0x40,0x99,0x23,0x00,0x03,0x33,0x00,0x00,0x85,0x09,0x80,0x66,
+	0x20,0x80,0x60,0x04,0x60,0x8e,0x20,0x98,0x02,0x00,0x00,0x00,0x13,0x26,0x7c,0xc0,
+	0x03,0x3b,0xf8,0x05,0x3b,0xa0,0x83,0x36,0x80,0x87,0x71,0x68,0x03,0x76,0x48,0x07,
+	0x77,0xa8,0x07,0x7c,0x68,0x83,0x73,0x70,0x87,0x7a,0xd8,0x60,0x0a,0xe5,0xd0,0x06,
+	0xed,0xa0,0x07,0xe5,0xd0,0x06,0xf0,0x20,0x07,0x77,0x00,0x07,0x7a,0x30,0x07,0x72,
+	0xa0,0x07,0x73,0x20,0x07,0x6d,0x00,0x0f,0x72,0x70,0x07,0x71,0xa0,0x07,0x73,0x20,
+	0x07,0x7a,0x30,0x07,0x72,0xd0,0x06,0xf0,0x20,0x07,0x77,0x20,0x07,0x7a,0x60,0x07,
+	0x74,0xa0,0x07,0x76,0x40,0x07,0x6d,0x90,0x0e,0x76,0x40,0x07,0x7a,0x60,0x07,0x74,
+	0xd0,0x06,0xe6,0x80,0x07,0x70,0xa0,0x07,0x71,0x20,0x07,0x78,0xd0,0x06,0xee,0x80,
+	0x07,0x7a,0x10,0x07,0x76,0xa0,0x07,0x73,0x20,0x07,0x7a,0x60,0x07,0x74,0xd0,0x06,
+	0xb3,0x10,0x07,0x72,0x80,0x07,0x1a,0x21,0x0c,0x09,0x0c,0xa9,0x80,0x2a,0x00,0x00,
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xa8,0x80,0x21,0x55,0x45,0x0c,
+	0x00,0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x15,0x20,0xb1,0x41,
+	0xa0,0xa8,0x5d,0x00,0x00,0x40,0x2c,0x06,0x97,0x00,0x00,0x00,0x33,0x08,0x80,0x1c,
+	0xc4,0xe1,0x1c,0x66,0x14,0x01,0x3d,0x88,0x43,0x38,0x84,0xc3,0x8c,0x42,0x80,0x07,
+	0x79,0x78,0x07,0x73,0x98,0x71,0x0c,0xe6,0x00,0x0f,0xed,0x10,0x0e,0xf4,0x80,0x0e,
+	0x33,0x0c,0x42,0x1e,0xc2,0xc1,0x1d,0xce,0xa1,0x1c,0x66,0x30,0x05,0x3d,0x88,0x43,
+	0x38,0x84,0x83,0x1b,0xcc,0x03,0x3d,0xc8,0x43,0x3d,0x8c,0x03,0x3d,0xcc,0x78,0x8c,
+	0x74,0x70,0x07,0x7b,0x08,0x07,0x79,0x48,0x87,0x70,0x70,0x07,0x7a,0x70,0x03,0x76,
+	0x78,0x87,0x70,0x20,0x87,0x19,0xcc,0x11,0x0e,0xec,0x90,0x0e,0xe1,0x30,0x0f,0x6e,
+	0x30,0x0f,0xe3,0xf0,0x0e,0xf0,0x50,0x0e,0x33,0x10,0xc4,0x1d,0xde,0x21,0x1c,0xd8,
+	0x21,0x1d,0xc2,0x61,0x1e,0x66,0x30,0x89,0x3b,0xbc,0x83,0x3b,0xd0,0x43,0x39,0xb4,
+	0x03,0x3c,0xbc,0x83,0x3c,0x84,0x03,0x3b,0xcc,0xf0,0x14,0x76,0x60,0x07,0x7b,0x68,
+	0x07,0x37,0x68,0x87,0x72,0x68,0x07,0x37,0x80,0x87,0x70,0x90,0x87,0x70,0x60,0x07,
+	0x76,0x28,0x07,0x76,0xf8,0x05,0x76,0x78,0x87,0x77,0x80,0x87,0x5f,0x08,0x87,0x71,
+	0x18,0x87,0x72,0x98,0x87,0x79,0x98,0x81,0x2c,0xee,0xf0,0x0e,0xee,0xe0,0x0e,0xf5,
+	0xc0,0x0e,0xec,0x30,0x03,0x62,0xc8,0xa1,0x1c,0xe4,0xa1,0x1c,0xcc,0xa1,0x1c,0xe4,
+	0xa1,0x1c,0xdc,0x61,0x1c,0xca,0x21,0x1c,0xc4,0x81,0x1d,0xca,0x61,0x06,0xd6,0x90,
+	0x43,0x39,0xc8,0x43,0x39,0x98,0x43,0x39,0xc8,0x43,0x39,0xb8,0xc3,0x38,0x94,0x43,
+	0x38,0x88,0x03,0x3b,0x94,0xc3,0x2f,0xbc,0x83,0x3c,0xfc,0x82,0x3b,0xd4,0x03,0x3b,
+	0xb0,0xc3,0x0c,0xc7,0x69,0x87,0x70,0x58,0x87,0x72,0x70,0x83,0x74,0x68,0x07,0x78,
+	0x60,0x87,0x74,0x18,0x87,0x74,0xa0,0x87,0x19,0xce,0x53,0x0f,0xee,0x00,0x0f,0xf2,
+	0x50,0x0e,0xe4,0x90,0x0e,0xe3,0x40,0x0f,0xe1,0x20,0x0e,0xec,0x50,0x0e,0x33,0x20,
+	0x28,0x1d,0xdc,0xc1,0x1e,0xc2,0x41,0x1e,0xd2,0x21,0x1c,0xdc,0x81,0x1e,0xdc,0xe0,
+	0x1c,0xe4,0xe1,0x1d,0xea,0x01,0x1e,0x66,0x18,0x51,0x38,0xb0,0x43,0x3a,0x9c,0x83,
+	0x3b,0xcc,0x50,0x24,0x76,0x60,0x07,0x7b,0x68,0x07,0x37,0x60,0x87,0x77,0x78,0x07,
+	0x78,0x98,0x51,0x4c,0xf4,0x90,0x0f,0xf0,0x50,0x0e,0x33,0x1e,0x6a,0x1e,0xca,0x61,
+	0x1c,0xe8,0x21,0x1d,0xde,0xc1,0x1d,0x7e,0x01,0x1e,0xe4,0xa1,0x1c,0xcc,0x21,0x1d,
+	0xf0,0x61,0x06,0x54,0x85,0x83,0x38,0xcc,0xc3,0x3b,0xb0,0x43,0x3d,0xd0,0x43,0x39,
+	0xfc,0xc2,0x3c,0xe4,0x43,0x3b,0x88,0xc3,0x3b,0xb0,0xc3,0x8c,0xc5,0x0a,0x87,0x79,
+	0x98,0x87,0x77,0x18,0x87,0x74,0x08,0x07,0x7a,0x28,0x07,0x72,0x98,0x81,0x5c,0xe3,
+	0x10,0x0e,0xec,0xc0,0x0e,0xe5,0x50,0x0e,0xf3,0x30,0x23,0xc1,0xd2,0x41,0x1e,0xe4,
+	0xe1,0x17,0xd8,0xe1,0x1d,0xde,0x01,0x1e,0x66,0x48,0x19,0x3b,0xb0,0x83,0x3d,0xb4,
+	0x83,0x1b,0x84,0xc3,0x38,0x8c,0x43,0x39,0xcc,0xc3,0x3c,0xb8,0xc1,0x39,0xc8,0xc3,
+	0x3b,0xd4,0x03,0x3c,0xcc,0x48,0xb4,0x71,0x08,0x07,0x76,0x60,0x07,0x71,0x08,0x87,
+	0x71,0x58,0x87,0x19,0xdb,0xc6,0x0e,0xec,0x60,0x0f,0xed,0xe0,0x06,0xf0,0x20,0x0f,
+	0xe5,0x30,0x0f,0xe5,0x20,0x0f,0xf6,0x50,0x0e,0x6e,0x10,0x0e,0xe3,0x30,0x0e,0xe5,
+	0x30,0x0f,0xf3,0xe0,0x06,0xe9,0xe0,0x0e,0xe4,0x50,0x0e,0xf8,0x30,0x23,0xe2,0xec,
+	0x61,0x1c,0xc2,0x81,0x1d,0xd8,0xe1,0x17,0xec,0x21,0x1d,0xe6,0x21,0x1d,0xc4,0x21,
+	0x1d,0xd8,0x21,0x1d,0xe8,0x21,0x1f,0x66,0x20,0x9d,0x3b,0xbc,0x43,0x3d,0xb8,0x03,
+	0x39,0x94,0x83,0x39,0xcc,0x58,0xbc,0x70,0x70,0x07,0x77,0x78,0x07,0x7a,0x08,0x07,
+	0x7a,0x48,0x87,0x77,0x70,0x07,0x00,0x00,0xa9,0x18,0x00,0x00,0x21,0x00,0x00,0x00,
+	0x0b,0x0a,0x72,0x28,0x87,0x77,0x80,0x07,0x7a,0x58,0x70,0x98,0x43,0x3d,0xb8,0xc3,
+	0x38,0xb0,0x43,0x39,0xd0,0xc3,0x82,0xe6,0x1c,0xc6,0xa1,0x0d,0xe8,0x41,0x1e,0xc2,
+	0xc1,0x1d,0xe6,0x21,0x1d,0xe8,0x21,0x1d,0xde,0xc1,0x1d,0x16,0x34,0xe3,0x60,0x0e,
+	0xe7,0x50,0x0f,0xe1,0x20,0x0f,0xe4,0x40,0x0f,0xe1,0x20,0x0f,0xe7,0x50,0x0e,0xf4,
+	0xb0,0x80,0x81,0x07,0x79,0x28,0x87,0x70,0x60,0x07,0x76,0x78,0x87,0x71,0x08,0x07,
+	0x7a,0x28,0x07,0x72,0x58,0x70,0x9c,0xc3,0x38,0xb4,0x01,0x3b,0xa4,0x83,0x3d,0x94,
+	0xc3,0x02,0x6b,0x1c,0xd8,0x21,0x1c,0xdc,0xe1,0x1c,0xdc,0x20,0x1c,0xe4,0x61,0x1c,
+	0xdc,0x20,0x1c,0xe8,0x81,0x1e,0xc2,0x61,0x1c,0xd0,0xa1,0x1c,0xc8,0x61,0x1c,0xc2,
+	0x81,0x1d,0xd8,0x01,0xd1,0x10,0x00,0x00,0x06,0x00,0x00,0x00,0x07,0xcc,0x3c,0xa4,
+	0x83,0x3b,0x9c,0x03,0x3b,0x94,0x03,0x3d,0xa0,0x83,0x3c,0x94,0x43,0x38,0x90,0xc3,
+	0x01,0x00,0x00,0x00,0x61,0x20,0x00,0x00,0x48,0x00,0x00,0x00,0x13,0x04,0x55,0x2c,
+	0x10,0x00,0x00,0x00,0x03,0x00,0x00,0x00,0x04,0x23,0x00,0x25,0x50,0x04,0x84,0x23,
+	0x00,0x35,0x00,0x00,0x33,0x11,0x00,0x50,0x8c,0xc2,0xb0,0x01,0x11,0x20,0x03,0x30,
+	0x13,0x01,0x00,0xc5,0x28,0x0c,0x1b,0x10,0x01,0x32,0x00,0x14,0xc0,0x18,0x6e,0x08,
+	0x10,0x34,0xc8,0x00,0x62,0xb8,0x41,0x09,0xc0,0x60,0x96,0x81,0x28,0x82,0x99,0x08,
+	0x00,0x28,0x46,0x61,0xd8,0x80,0x08,0x98,0x01,0x18,0x36,0x20,0x82,0x65,0x00,0x66,
+	0x09,0x90,0x65,0x66,0x09,0x82,0x59,0x02,0x63,0x96,0xc0,0x18,0xa8,0x40,0x24,0x02,
+	0x2a,0x66,0x19,0x84,0x21,0x98,0x25,0x08,0xe8,0x80,0x31,0xdc,0x10,0x38,0x66,0x90,
+	0x01,0xc4,0x70,0x03,0x14,0x80,0xc1,0x2c,0xc3,0xc2,0x04,0xb4,0xc0,0xb8,0x00,0xb2,
+	0xe1,0x86,0x40,0x02,0x83,0x0c,0x20,0x86,0x1b,0xaa,0x00,0x0c,0x66,0x19,0x22,0x29,
+	0xa0,0x05,0xc6,0x06,0xb3,0x04,0xcd,0x2c,0x41,0x33,0x50,0x81,0xa0,0xc1,0x62,0x06,
+	0xcc,0x2c,0x43,0xa2,0x04,0x34,0xc1,0x20,0x0a,0x06,0x55,0x30,0x4e,0x08,0x64,0xd8,
+	0x80,0xb8,0x82,0x01,0x20,0x0b,0x06,0x5d,0x30,0x2e,0xe0,0x68,0xd8,0x80,0xc8,0x82,
+	0x01,0x98,0x25,0x40,0x88,0x82,0x41,0x15,0x0c,0xe2,0x60,0x9c,0x10,0xc8,0xb0,0x01,
+	0x81,0x05,0x03,0x30,0x4b,0xe0,0xcc,0x12,0x38,0xb3,0x04,0xd3,0x2c,0xc1,0x34,0x50,
+	0x81,0x80,0x42,0xe4,0x07,0xd2,0x2c,0xc3,0x03,0x05,0x4b,0x06,0xe1,0x40,0x00,0x00,
+	0x09,0x00,0x00,0x00,0x36,0x80,0x10,0xd7,0xe3,0x34,0x44,0x33,0x99,0x42,0x42,0x5c,
+	0x8f,0xd3,0x10,0xcd,0x64,0x9b,0x00,0x11,0x00,0x12,0x61,0x09,0x45,0x00,0x48,0x44,
+	0x6d,0x0f,0x46,0x44,0x48,0xd4,0x32,0x01,0x00,0x00,0x00,0x00,0x61,0x20,0x00,0x00,
+	0x05,0x00,0x00,0x00,0x13,0x04,0x41,0x2c,0x10,0x00,0x00,0x00,0x01,0x00,0x00,0x00,
+	0x04,0x23,0x00,0x00,0x1b,0x00,0x00,0x00,0x71,0x20,0x00,0x00,0x03,0x00,0x00,0x00,
+	0x32,0x0e,0x10,0x22,0x84,0x00,0xa5,0x02,0x18,0xf0,0x2e,0x00,0x00,0x00,0x00,0x00,
+	0x65,0x0c,0x00,0x00,0x25,0x00,0x00,0x00,0x12,0x03,0x94,0x28,0x01,0x00,0x00,0x00,
+	0x03,0x00,0x00,0x00,0x19,0x00,0x00,0x00,0x06,0x00,0x00,0x00,0x4c,0x00,0x00,0x00,
+	0x01,0x00,0x00,0x00,0x58,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x58,0x00,0x00,0x00,
+	0x02,0x00,0x00,0x00,0x88,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x1f,0x00,0x00,0x00,
+	0x13,0x00,0x00,0x00,0x15,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x15,0x00,0x00,0x00,
+	0x00,0x00,0x00,0x00,0x88,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+	0x02,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x15,0x00,0x00,0x00,
+	0x00,0x00,0x00,0x00,0x15,0x00,0x00,0x00,0xff,0xff,0xff,0xff,0x00,0x24,0x00,0x00,
+	0x15,0x00,0x00,0x00,0x04,0x00,0x00,0x00,0x15,0x00,0x00,0x00,0x04,0x00,0x00,0x00,
+	0xff,0xff,0xff,0xff,0x10,0x24,0x00,0x00,0x00,0x00,0x00,0x00,0x5d,0x0c,0x00,0x00,
+	0x10,0x00,0x00,0x00,0x12,0x03,0x94,0x72,0x00,0x00,0x00,0x00,0x5f,0x5f,0x67,0x61,
+	0x72,0x74,0x65,0x72,0x5f,0x65,0x78,0x70,0x6f,0x6e,0x65,0x6e,0x74,0x69,0x61,0x74,
+	0x65,0x6d,0x61,0x69,0x6e,0x31,0x34,0x2e,0x30,0x2e,0x36,0x78,0x38,0x36,0x5f,0x36,
+	0x34,0x2d,0x70,0x63,0x2d,0x6c,0x69,0x6e,0x75,0x78,0x2d,0x67,0x6e,0x75,0x00,0x00,
+	0x00,0x00,0x00,0x00,
+};
+
+extern const garter::EmbeddedBitcode garter_runtime_bitcode[] = {
+	{ "runtime/exponentiate.bc", bitcode0, sizeof(bitcode0) },
+	{ nullptr, nullptr, 0 },
+};
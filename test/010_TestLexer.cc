@@ -114,6 +114,14 @@ static const struct LexerTestCase {
 			ExpectedToken(Token::While),
 		},
 	},
+	{
+		.Input = "const constant",
+		.ExpectedOutput =
+		{
+			ExpectedToken(Token::Const),
+			ExpectedToken("constant"),
+		},
+	},
 	{
 		.Input = "-10**2 + 3/b",
 		.ExpectedOutput =
@@ -140,6 +148,33 @@ static const struct LexerTestCase {
 			ExpectedToken(Token::NotEqualTo),
 		},
 	},
+	{
+		.Input = "& | ^ ~ << >> <<= >>=",
+		.ExpectedOutput =
+		{
+			ExpectedToken(Token::Ampersand),
+			ExpectedToken(Token::VerticalBar),
+			ExpectedToken(Token::Caret),
+			ExpectedToken(Token::Tilde),
+			ExpectedToken(Token::DoubleLessThan),
+			ExpectedToken(Token::DoubleGreaterThan),
+			ExpectedToken(Token::DoubleLessThan),
+			ExpectedToken(Token::Equals),
+			ExpectedToken(Token::DoubleGreaterThan),
+		},
+	},
+	{
+		.Input = "@unroll(4) while",
+		.ExpectedOutput =
+		{
+			ExpectedToken(Token::At),
+			ExpectedToken("unroll"),
+			ExpectedToken(Token::LeftParenthesis),
+			ExpectedToken(4),
+			ExpectedToken(Token::RightParenthesis),
+			ExpectedToken(Token::While),
+		},
+	},
 	{
 		.Input = "!",
 		.ExpectedOutput =
@@ -42,25 +42,23 @@ static bool ASTStringsEqual(const char * & str1, const char * & str2)
 static void doParserTest(const std::string & src_file_path,
 			 const std::string & tree_file_path)
 {
-	llvm::error_code ec;
-	llvm::OwningPtr<llvm::MemoryBuffer> src_buffer;
-	llvm::OwningPtr<llvm::MemoryBuffer> tree_buffer;
-
 	std::cout << "Testing " << src_file_path << std::endl;
 
-	ec = llvm::MemoryBuffer::getFile(src_file_path, src_buffer);
-	if (ec) {
-		std::cerr << "TestParser ERROR: " << ec.message() << std::endl;
+	auto src_buffer = llvm::MemoryBuffer::getFile(src_file_path);
+	if (!src_buffer) {
+		std::cerr << "TestParser ERROR: "
+			  << src_buffer.getError().message() << std::endl;
 		exit(-1);
 	}
 
-	ec = llvm::MemoryBuffer::getFile(tree_file_path, tree_buffer);
-	if (ec) {
-		std::cerr << "TestParser ERROR: " << ec.message() << std::endl;
+	auto tree_buffer = llvm::MemoryBuffer::getFile(tree_file_path);
+	if (!tree_buffer) {
+		std::cerr << "TestParser ERROR: "
+			  << tree_buffer.getError().message() << std::endl;
 		exit(-1);
 	}
 
-	Parser parser(src_buffer->getBufferStart());
+	Parser parser((*src_buffer)->getBufferStart());
 
 	std::unique_ptr<ProgramAST> ast(parser.parseProgram());
 
@@ -73,7 +71,7 @@ static void doParserTest(const std::string & src_file_path,
 	std::ostringstream os;
 	os << *ast;
 
-	const char *cstr1 = tree_buffer->getBufferStart();
+	const char *cstr1 = (*tree_buffer)->getBufferStart();
 	std::string os_contents(os.str());
 	const char *cstr2 = os_contents.c_str();
 	if (!ASTStringsEqual(cstr1, cstr2)) {
@@ -81,7 +79,7 @@ static void doParserTest(const std::string & src_file_path,
 			<< src_file_path << "\": Got\n\n";
 		std::cerr << os.str() << "\n\n";
 		std::cerr << "but expected:\n";
-		std::cerr << tree_buffer->getBufferStart() << "\n\n";
+		std::cerr << (*tree_buffer)->getBufferStart() << "\n\n";
 		std::cerr << "Differences:\n";
 		std::string str1(cstr1, std::min(80UL, strlen(cstr1)));
 		std::string str2(cstr2, std::min(80UL, strlen(cstr2)));
@@ -93,7 +91,7 @@ static void doParserTest(const std::string & src_file_path,
 
 int main()
 {
-	llvm::error_code ec;
+	std::error_code ec;
 	const char *dirpath = "test/ParserTests";
 
 	std::vector<std::string> src_file_paths;
@@ -101,7 +99,7 @@ int main()
 	for (llvm::sys::fs::directory_iterator dir(dirpath, ec), dir_end;
 	     dir != dir_end && !ec; dir.increment(ec))
 	{
-		const std::string & path = dir->path();
+		const std::string path = dir->path();
 		const llvm::StringRef ext(llvm::sys::path::extension(path));
 		if (ext == ".ga")
 			src_file_paths.push_back(path);
@@ -0,0 +1,119 @@
+#include <frontend/Parser.h>
+#include <backend/LLVMBackend.h>
+#include <iostream>
+#include <stdlib.h>
+
+using namespace garter;
+
+static const char *program =
+	"def answer():\n"
+	"	return 42;\n"
+	"enddef\n"
+	"def gcd(a, b):\n"
+	"	while b != 0:\n"
+	"		t = b;\n"
+	"		b = a % b;\n"
+	"		a = t;\n"
+	"	endwhile\n"
+	"	return a;\n"
+	"enddef\n"
+	"def sum8(a, b, c, d, e, f, g, h):\n"
+	"	return a + b + c + d + e + f + g + h;\n"
+	"enddef\n"
+	"def sum9(a, b, c, d, e, f, g, h, i):\n"
+	"	return a + b + c + d + e + f + g + h + i;\n"
+	"enddef\n";
+
+static void check(bool ok, const char *what)
+{
+	if (!ok) {
+		std::cerr << "TestEmbedding ERROR: " << what << std::endl;
+		exit(1);
+	}
+}
+
+static void testEmbedding(const LLVMBackendOptions & options)
+{
+	Parser parser(program);
+	LLVMBackend backend(options);
+	std::unique_ptr<ASTBase> top_level_item;
+
+	while ((top_level_item = parser.parseTopLevelItem()) != nullptr)
+		check(backend.executeTopLevelItem(std::move(top_level_item)),
+		      "failed to execute top-level item");
+	check(parser.reachedEndOfFile(), "failed to parse program");
+
+	// Typed pointers
+	NativeFunction<0> answer = backend.getNativeFunction<0>("answer");
+	check(answer != nullptr, "answer() not found");
+	check(answer() == 42, "answer() returned wrong value");
+
+	NativeFunction<2> gcd = backend.getNativeFunction<2>("gcd");
+	check(gcd != nullptr, "gcd() not found");
+	int32_t total = 0;
+	for (int32_t i = 1; i <= 10000; i++)
+		total += gcd(i, 360);
+	check(total == 104818, "gcd() returned wrong values");
+
+	check(backend.getNativeFunction<1>("gcd") == nullptr,
+	      "gcd() found with wrong arity");
+	check(backend.getNativeFunction<0>("nonexistent") == nullptr,
+	      "nonexistent function found");
+
+	// Trampolines
+	int32_t result;
+	check(backend.callFunction("gcd", {84, 36}, result) && result == 12,
+	      "callFunction(gcd) failed");
+	check(backend.callFunction("sum8", {1, 2, 3, 4, 5, 6, 7, 8}, result) &&
+	      result == 36, "callFunction(sum8) failed");
+	check(!backend.callFunction("sum9", {1, 2, 3, 4, 5, 6, 7, 8, 9}, result),
+	      "callFunction() accepted too many arguments");
+	check(!backend.callFunction("gcd", {1}, result),
+	      "callFunction() accepted wrong number of arguments");
+}
+
+// The code of statements is freed after they run, so running more statements
+// doesn't use more JIT memory.
+static void testStatementMemory()
+{
+	std::string program = "@noinline\ndef twice(a):\n\treturn a * 2;\nenddef\n";
+	for (int i = 0; i < 100; i++)
+		program += "x = x + twice(i);\ni = i + 1;\n";
+	Parser parser(program.c_str());
+	LLVMBackend backend;
+	std::unique_ptr<ASTBase> top_level_item;
+	JITMemoryUsage first_usage = { 0, 0 };
+	int n = 0;
+
+	while ((top_level_item = parser.parseTopLevelItem()) != nullptr) {
+		check(backend.executeTopLevelItem(std::move(top_level_item)),
+		      "failed to execute top-level item");
+		JITMemoryUsage usage = backend.getJITMemoryUsage();
+		if (++n == 2) {
+			first_usage = usage;
+			check(usage.CodeBytes > 0, "no JIT code memory reported");
+		} else if (n > 2) {
+			check(usage.CodeBytes == first_usage.CodeBytes &&
+			      usage.DataBytes == first_usage.DataBytes,
+			      "JIT memory grew while running statements");
+		}
+	}
+	check(parser.reachedEndOfFile(), "failed to parse program");
+}
+
+int main()
+{
+	LLVMBackendOptions options;
+	testEmbedding(options);
+
+	// IR for functions generated when their address is first requested
+	options.LazyIRGeneration = true;
+	testEmbedding(options);
+
+	testStatementMemory();
+
+	printf("=======================================\n");
+	printf("  TestEmbedding:  All tests passed!\n");
+	printf("=======================================\n");
+	return 0;
+}
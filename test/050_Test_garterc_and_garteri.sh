@@ -2,16 +2,305 @@
 
 set -e -u
 
+# Run garteri with the given arguments, checking that it applied the hints of
+# all loops it compiled
+run_garteri() {
+	./garteri "$@" 2> ${base}.err || { cat ${base}.err >&2; return 1; }
+	cat ${base}.err >&2
+	if grep -q "loop not" ${base}.err; then
+		echo "garteri couldn't apply the loop hints" >&2
+		return 1
+	fi
+}
+
 for src in test/garterc_and_garteri_Tests/*.ga; do
 	echo "Testing ${src}"
 	base=${src%.*}
 	./garterc ${src} -o ${base}.exe
 	${base}.exe > ${base}.out
 	cmp ${base}.out ${base}.expected_out
-	./garteri ${src} > ${base}.out
+	for level in 0 3; do
+		./garterc -O${level} ${src} -o ${base}.exe
+		${base}.exe > ${base}.out
+		cmp ${base}.out ${base}.expected_out
+	done
+	./garterc -j 4 ${src} -o ${base}.exe
+	${base}.exe > ${base}.out
+	cmp ${base}.out ${base}.expected_out
+	./garterc -lto ${src} -o ${base}.exe
+	${base}.exe > ${base}.out
+	cmp ${base}.out ${base}.expected_out
+	run_garteri ${src} > ${base}.out
+	cmp ${base}.out ${base}.expected_out
+	run_garteri < ${src} > ${base}.out
+	cmp ${base}.out ${base}.expected_out
+	run_garteri -inline-runtime=false ${src} > ${base}.out
+	cmp ${base}.out ${base}.expected_out
+	run_garteri -backend=tree ${src} > ${base}.out
+	cmp ${base}.out ${base}.expected_out
+	run_garteri -backend=tree < ${src} > ${base}.out
+	cmp ${base}.out ${base}.expected_out
+	run_garteri -backend=bytecode ${src} > ${base}.out
+	cmp ${base}.out ${base}.expected_out
+	run_garteri -backend=bytecode < ${src} > ${base}.out
 	cmp ${base}.out ${base}.expected_out
+	run_garteri -backend=template ${src} > ${base}.out
+	cmp ${base}.out ${base}.expected_out
+	run_garteri -backend=template < ${src} > ${base}.out
+	cmp ${base}.out ${base}.expected_out
+done
+
+echo "Testing calls to a function that failed to compile"
+tmp_dir=$(mktemp -d)
+cat > ${tmp_dir}/failed.ga << EOF
+def f():
+	x = h();
+	return nosuch(1);
+enddef
+def h():
+	return f() + 7;
+enddef
+print f();
+print h();
+EOF
+for backend in tree bytecode template; do
+	status=0
+	./garteri -backend=${backend} ${tmp_dir}/failed.ga \
+		> ${tmp_dir}/out 2> ${tmp_dir}/errors || status=$?
+	[ ${status} -ne 0 ]
+	[ ! -s ${tmp_dir}/out ]
+	grep -q "^ERROR: h calls f, which failed to compile" ${tmp_dir}/errors
+	./garteri -backend=${backend} < ${tmp_dir}/failed.ga \
+		> ${tmp_dir}/out 2> ${tmp_dir}/errors
+	[ ! -s ${tmp_dir}/out ]
+	grep -q "^ERROR: Unknown function h" ${tmp_dir}/errors
+done
+rm -r ${tmp_dir}
+
+echo "Testing compiling all programs at once"
+srcs=(test/garterc_and_garteri_Tests/*.ga)
+./garterc -c "${srcs[@]}"
+for src in "${srcs[@]}"; do
+	mv ${src%.*}.o ${src%.*}.serial.o
+done
+./garterc -j 4 -c "${srcs[@]}"
+for src in "${srcs[@]}"; do
+	cmp ${src%.*}.o ${src%.*}.serial.o
+done
+
+echo "Testing generating code on several threads without objcopy"
+src=test/garterc_and_garteri_Tests/055_FunctionAttributes.ga
+base=${src%.*}
+env PATH=/nonexistent ./garterc -j 4 -c ${src} -o ${base}.o
+cmp ${base}.o ${base}.serial.o
+env PATH=/nonexistent ./garterc -j 4 ${src} -o ${base}.exe
+${base}.exe > ${base}.out
+cmp ${base}.out ${base}.expected_out
+
+echo "Testing loop hints"
+src=test/garterc_and_garteri_Tests/036_LoopHints.ga
+base=${src%.*}
+ir=$(mktemp)
+./garterc -O0 -l ${src} -o ${ir}
+# Print the contents of metadata node $1
+node_contents() {
+	sed -n "s/^$1 = !{\(.*\)}$/\1/p" ${ir}
+}
+# The hints of each loop, from the metadata of the branches back to its header.
+# The hints for the vectorized loop are listed in place of their nodes.
+for id in $(sed -n 's/^  br .*, !llvm\.loop \(![0-9]*\)$/\1/p' ${ir} | uniq); do
+	for node in $(sed -n "s/^${id} = distinct !{${id}, \(.*\)}$/\1/p" ${ir} |
+		      tr -d ,); do
+		hint=$(node_contents ${node})
+		for ref in $(grep -o '![0-9][0-9]*' <<< "${hint}"); do
+			hint=$(sed "s/${ref}\b/$(node_contents ${ref})/" <<< "${hint}")
+		done
+		echo "${hint}"
+	done | paste -s -d ';'
+done | diff - <(cat << EOF
+!"llvm.loop.vectorize.enable", i1 true;!"llvm.loop.vectorize.followup_vectorized", !"llvm.loop.isvectorized", !"llvm.loop.unroll.count", i32 4
+!"llvm.loop.unroll.disable"
+!"llvm.loop.vectorize.enable", i1 true;!"llvm.loop.vectorize.width", i32 4
+EOF
+)
+./garterc -report-vectorization ${src} -o ${base}.exe 2>&1 |
+	grep -q "^vectorized loop in sum_mod: "
+if ./garterc ${src} -o ${base}.exe 2>&1 | grep -q "loop not"; then
+	echo "garterc couldn't apply the loop hints"
+	exit 1
+fi
+rm ${ir}
+
+echo "Testing function attributes"
+src=test/garterc_and_garteri_Tests/055_FunctionAttributes.ga
+ir=$(mktemp)
+# Print the attributes of the function $2 in the LLVM IR file $1
+function_attributes() {
+	local group=$(sed -n "s/^define .* @$2(.*) [^#]*\(#[0-9][0-9]*\).*{$/\1/p" $1)
+	sed -n "s/^attributes ${group} = { \(.*\) }$/\1/p" $1
+}
+# Print the body of the function $2 in the LLVM IR file $1
+function_body() {
+	sed -n "/^define .* @$2(/,/^}/p" $1
+}
+./garterc -O1 -l ${src} -o ${ir}
+function_attributes ${ir} check_failed | grep -qw cold
+function_attributes ${ir} check_failed | grep -qw noinline
+grep -q '^define .* @check_failed(.* section ".text.unlikely" {$' ${ir}
+function_attributes ${ir} square | grep -qw alwaysinline
+function_attributes ${ir} sum_squares | grep -qw hot
+function_attributes ${ir} sum_squares | grep -qw noinline
+function_attributes ${ir} sum_squares | grep -q '"garter-opt-level"="3"'
+grep -q '^define .* @sum_squares(.* section ".text.hot" {$' ${ir}
+function_attributes ${ir} slow_fib | grep -qw optnone
+function_attributes ${ir} slow_fib | grep -qw noinline
+# square is inlined into sum_squares, which is optimized separately at -O3
+if function_body ${ir} sum_squares | grep -q "call"; then
+	echo "garterc didn't inline square into sum_squares"
+	exit 1
+fi
+function_body ${ir} main | grep -q "call i32 @sum_squares("
+function_body ${ir} slow_fib | grep -q "alloca"
+# At -O3, sum_squares asks for the default level, so it can be inlined
+./garterc -O3 -l ${src} -o ${ir}
+if function_body ${ir} main | grep -q "call .*@sum_squares("; then
+	echo "garterc didn't inline sum_squares into main"
+	exit 1
+fi
+rm ${ir}
+
+echo "Testing target CPU options and auto-vectorization"
+src=test/garterc_and_garteri_Tests/037_Vectorize.ga
+base=${src%.*}
+./garterc -report-vectorization ${src} -o ${base}.exe 2>&1 |
+	grep -q "^vectorized loop in "
+${base}.exe > ${base}.out
+cmp ${base}.out ${base}.expected_out
+./garterc -march=x86-64 -mattr=-sse4.1 ${src} -o ${base}.exe
+${base}.exe > ${base}.out
+cmp ${base}.out ${base}.expected_out
+if ./garterc -mcpu=no-such-cpu ${src} -o ${base}.exe 2> /dev/null; then
+	echo "garterc accepted an unknown CPU"
+	exit 1
+fi
+
+echo "Testing function specialization"
+src=test/garterc_and_garteri_Tests/057_Specialize.ga
+base=${src%.*}
+report=$(mktemp)
+./garterc -report-specializations -specialize-max-growth=1000 ${src} \
+	-o ${base}.exe 2> ${report}
+${base}.exe > ${base}.out
+cmp ${base}.out ${base}.expected_out
+for mode in 0 1 2; do
+	grep -q "^specialized accumulate\.spec[.0-9]* (mode = ${mode})$" ${report}
+	grep -q "^specialized combine\.spec[.0-9]* (mode = ${mode})$" ${report}
+done
+if grep "^specialized " ${report} | grep -qv "(mode = [0-9]*)$"; then
+	echo "garterc specialized on parameters that don't decide branches"
+	exit 1
+fi
+rm ${report}
+
+echo "Testing profile-guided optimization"
+src=test/garterc_and_garteri_Tests/060_Prime.ga
+base=${src%.*}
+profile=$(mktemp)
+rm ${profile}
+./garterc -profile-generate ${src} -o ${base}.exe
+GARTER_PROFILE_FILE=${profile} ${base}.exe > ${base}.out
+cmp ${base}.out ${base}.expected_out
+GARTER_PROFILE_FILE=${profile} ${base}.exe > ${base}.out
+grep -q "^${src}:main 2 " ${profile}  # counts of both runs
+./garterc -profile-use=${profile} ${src} -o ${base}.exe
+${base}.exe > ${base}.out
+cmp ${base}.out ${base}.expected_out
+ir=$(mktemp)
+./garterc -O0 -profile-use=${profile} -l ${src} -o ${ir}
+grep -q '^define .* @main() .*!prof ![0-9]* {$' ${ir}
+grep -q '^![0-9]* = !{!"function_entry_count", i64 2}$' ${ir}
+grep -q '^  br i1 .*, !prof ![0-9]*$' ${ir}
+grep -q '^![0-9]* = !{!"branch_weights", i32 [0-9]*, i32 [0-9]*}$' ${ir}
+grep -q '^![0-9]* = !{i32 1, !"ProfileSummary", ![0-9]*}$' ${ir}
+grep -q '^!llvm.module.flags = ' ${ir}
+rm ${profile}
+# Spaces in the names of source files are escaped in profiles
+tmp_dir=$(mktemp -d)
+cp ${src} "${tmp_dir}/a prime.ga"
+./garterc -profile-generate "${tmp_dir}/a prime.ga" -o ${base}.exe
+GARTER_PROFILE_FILE=${profile} ${base}.exe > ${base}.out
+grep -q "^${tmp_dir}/a%20prime.ga:main 1 " ${profile}
+./garterc -O0 -profile-use=${profile} -l "${tmp_dir}/a prime.ga" -o ${ir}
+grep -q '^![0-9]* = !{!"function_entry_count", i64 1}$' ${ir}
+rm -r ${profile} ${ir} ${tmp_dir}
+
+echo "Testing the build cache"
+cache_dir=$(mktemp -d)
+./garterc -cache-dir=${cache_dir} -c "${srcs[@]}"
+./garterc -cache-dir=${cache_dir} -cache-stats -c "${srcs[@]}" 2>&1 |
+	grep -q "^build cache: ${#srcs[@]} hits, 0 misses"
+for src in "${srcs[@]}"; do
+	cmp ${src%.*}.o ${src%.*}.serial.o
+done
+src=test/garterc_and_garteri_Tests/057_Specialize.ga
+./garterc -cache-dir=${cache_dir} -report-specializations -report-compile-time \
+	-c ${src} 2>&1 | grep -q "^program: "
+./garterc -cache-dir=${cache_dir} -report-specializations -c ${src} 2>&1 |
+	grep -q "specializations created"
+cmp ${src%.*}.o ${src%.*}.serial.o
+rm -r ${cache_dir}
+
+echo "Testing garteri's object cache"
+cache_dir=$(mktemp -d)
+stats=$(mktemp)
+for src in "${srcs[@]}"; do
+	base=${src%.*}
+	./garteri -cache-dir=${cache_dir} ${src} > ${base}.out
+	cmp ${base}.out ${base}.expected_out
+	./garteri -cache-dir=${cache_dir} -jit-stats ${src} > ${base}.out \
+		2> ${stats}
+	cmp ${base}.out ${base}.expected_out
+	grep -q "object cache: [1-9][0-9]* hits, 0 misses, 0 stored" ${stats}
+done
+rm -r ${cache_dir}
+cache_dir=$(mktemp -d)
+src=test/garterc_and_garteri_Tests/060_Prime.ga
+base=${src%.*}
+for i in 1 2; do
+	./garteri -cache-dir=${cache_dir} -cache-size-limit=0 -jit-stats ${src} \
+		> ${base}.out 2> ${stats}
+	cmp ${base}.out ${base}.expected_out
+	grep -q "object cache: 0 hits, [1-9][0-9]* misses, [1-9][0-9]* stored, [1-9][0-9]* evicted" ${stats}
+done
+rm -r ${cache_dir} ${stats}
+
+echo "Testing the compile server"
+server_dir=$(mktemp -d)
+./garterc -server=${server_dir}/socket &
+server_pid=$!
+while [ ! -S ${server_dir}/socket ]; do
+	sleep 0.1
+done
+for src in "${srcs[@]}"; do
+	base=${src%.*}
+	./garterc-client ${server_dir}/socket ${src} -o ${base}.exe
+	${base}.exe > ${base}.out
+	cmp ${base}.out ${base}.expected_out
+done
+./garterc-client ${server_dir}/socket -c "${srcs[@]}"
+for src in "${srcs[@]}"; do
+	cmp ${src%.*}.o ${src%.*}.serial.o
 done
-rm test/garterc_and_garteri_Tests/*.{exe,out,o}
+status=0
+./garterc-client ${server_dir}/socket ${server_dir}/nonexistent.ga \
+	2> ${server_dir}/errors || status=$?
+[ ${status} -eq 3 ]
+grep -q "^ERROR: Can't open" ${server_dir}/errors
+kill ${server_pid}
+wait ${server_pid}
+[ ! -e ${server_dir}/socket ]
+rm -r ${server_dir}
+rm test/garterc_and_garteri_Tests/*.{exe,out,err,o,bc}
 
 cat << EOF
 ==========================================================